@@ -0,0 +1,64 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "AmountOutputsIndex.hpp"
+#include <algorithm>
+#include "common/Invariant.hpp"
+
+using namespace cn;
+
+const AmountOutputsIndex::Items *AmountOutputsIndex::find(Amount amount) const {
+	auto ait = m_amounts.find(amount);
+	return ait == m_amounts.end() || !ait->second.complete ? nullptr : &ait->second.items;
+}
+
+size_t AmountOutputsIndex::get_loaded_count(Amount amount) const {
+	auto ait = m_amounts.find(amount);
+	return ait == m_amounts.end() ? 0 : ait->second.items.size();
+}
+
+void AmountOutputsIndex::load_chunk(Amount amount, const Items &items, bool complete) {
+	auto &my = m_amounts[amount];
+	invariant(!my.complete, "AmountOutputsIndex::load_chunk amount already loaded");
+	invariant(items.empty() || my.items.empty() || my.items.back().global_index < items.front().global_index,
+	    "AmountOutputsIndex::load_chunk global index must grow");
+	my.items.insert(my.items.end(), items.begin(), items.end());
+	my.complete = complete;
+	m_item_count += items.size();
+}
+
+void AmountOutputsIndex::push(Amount amount, const Item &item) {
+	auto ait = m_amounts.find(amount);
+	if (ait == m_amounts.end() || !ait->second.complete)
+		return;  // will be read by next chunk
+	invariant(ait->second.items.empty() || ait->second.items.back().global_index < item.global_index,
+	    "AmountOutputsIndex::push global index must grow");
+	ait->second.items.push_back(item);
+	m_item_count += 1;
+}
+
+void AmountOutputsIndex::pop(Amount amount, uint64_t global_index) {
+	auto ait = m_amounts.find(amount);
+	if (ait == m_amounts.end())
+		return;
+	auto &items = ait->second.items;
+	if (!ait->second.complete && (items.empty() || items.back().global_index != global_index))
+		return;  // not loaded yet
+	invariant(!items.empty() && items.back().global_index == global_index, "AmountOutputsIndex::pop wrong element");
+	items.pop_back();
+	m_item_count -= 1;
+}
+
+void AmountOutputsIndex::set_spent(Amount amount, uint64_t global_index, uint8_t spent) {
+	auto ait = m_amounts.find(amount);
+	if (ait == m_amounts.end())
+		return;
+	auto &items = ait->second.items;
+	// Global indexes grow with stack indexes
+	auto iit = std::lower_bound(items.begin(), items.end(), global_index,
+	    [](const Item &item, uint64_t gi) { return item.global_index < gi; });
+	if (!ait->second.complete && iit == items.end())
+		return;  // not loaded yet
+	invariant(iit != items.end() && iit->global_index == global_index, "AmountOutputsIndex::set_spent not found");
+	iit->spent = spent;
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "CryptoNote.hpp"
+
+namespace cn {
+
+// Copy of output fields get_random_outputs filters on, per amount in stack index order, so that
+// sampling runs without DB reads. Public key is read by global index for selected outputs only.
+// Amounts are loaded in chunks on requests, after that kept in sync by push/pop/set_spent.
+// While amount is partially loaded, outputs above loaded prefix are left to next chunks
+class AmountOutputsIndex {
+public:
+	struct Item {
+		uint64_t global_index                      = 0;
+		BlockOrTimestamp unlock_block_or_timestamp = 0;
+		Height height                              = 0;
+		uint8_t spent                              = 0;
+	};
+	typedef std::vector<Item> Items;
+
+	const Items *find(Amount amount) const;  // nullptr if amount not loaded completely
+	size_t get_loaded_count(Amount amount) const;
+	void load_chunk(Amount amount, const Items &items, bool complete);
+
+	void push(Amount amount, const Item &item);
+	void pop(Amount amount, uint64_t global_index);
+	void set_spent(Amount amount, uint64_t global_index, uint8_t spent);
+
+	size_t get_amount_count() const { return m_amounts.size(); }
+	size_t get_item_count() const { return m_item_count; }
+	size_t get_memory_size() const { return m_item_count * sizeof(Item); }
+
+private:
+	struct Entry {
+		Items items;
+		bool complete = false;
+	};
+	std::unordered_map<Amount, Entry> m_amounts;
+	size_t m_item_count = 0;
+};
+
+}  // namespace cn
@@ -49,21 +49,24 @@ Block::Block(const RawBlock &rb) {
 	}
 }
 
-PreparedBlock::PreparedBlock(BinaryArray &&ba, const Currency &currency, crypto::CryptoNightContext *context)
+PreparedBlock::PreparedBlock(BinaryArray &&ba, const Currency &currency, crypto::CryptoNightContext *context,
+    const ParallelFor &parallel_for)
     : block_data(std::move(ba)) {
 	seria::from_binary(raw_block, block_data);
-	prepare(currency, context);
+	prepare(currency, context, parallel_for);
 }
 
-PreparedBlock::PreparedBlock(RawBlock &&rba, const Currency &currency, crypto::CryptoNightContext *context)
+PreparedBlock::PreparedBlock(RawBlock &&rba, const Currency &currency, crypto::CryptoNightContext *context,
+    const ParallelFor &parallel_for)
     : raw_block(rba) {
 	block_data = seria::to_binary(raw_block);
-	prepare(currency, context);
+	prepare(currency, context, parallel_for);
 }
 
-void PreparedBlock::prepare(const Currency &currency, crypto::CryptoNightContext *context) {
-	block = Block{raw_block};
-	invariant(block.transactions.size() == raw_block.transactions.size(), "");
+void PreparedBlock::prepare(
+    const Currency &currency, crypto::CryptoNightContext *context, const ParallelFor &parallel_for) {
+	BlockTemplate &bheader = block.header;
+	seria::from_binary(bheader, raw_block.block);
 	base_transaction_hash = get_transaction_hash(block.header.base_transaction);
 	body_proxy            = get_body_proxy_from_template(base_transaction_hash, block.header.transaction_hashes);
 	bid                   = cn::get_block_hash(block.header, body_proxy);
@@ -73,12 +76,7 @@ void PreparedBlock::prepare(const Currency &currency, crypto::CryptoNightContext
 	block_header_size = seria::binary_size(static_cast<BlockHeader>(block.header));
 	if (block.header.transaction_hashes.size() != raw_block.transactions.size())
 		throw ConsensusError{"Wrong transcation count in block template"};
-	// Transactions are in block
-	for (size_t i = 0; i != block.transactions.size(); ++i) {
-		Hash tid = get_transaction_hash(block.transactions.at(i));
-		if (tid != block.header.transaction_hashes.at(i))
-			throw ConsensusError{"Transaction from block template absent in block"};
-	}
+	// Cheap header checks go first, so that malformed blocks do not cost us PoW
 	if (block.header.is_merge_mined()) {
 		extra::MergeMiningTag mm_tag;
 		if (!extra::get_merge_mining_tag(block.header.root_block.coinbase_transaction.extra, &mm_tag))
@@ -107,10 +105,28 @@ void PreparedBlock::prepare(const Currency &currency, crypto::CryptoNightContext
 		    "Coinbase transaction input count wrong,", block.header.base_transaction.inputs.size(), "should be 1"));
 	if (block.header.base_transaction.inputs.at(0).type() != typeid(InputCoinbase))
 		throw ConsensusError("Coinbase transaction input type wrong");
-	if (context) {
-		auto ba  = currency.get_block_pow_hashing_data(block.header, body_proxy);
-		pow_hash = context->cn_slow_hash(ba.data(), ba.size());
-	}
+	// PoW depends only on header, so it is calculated together with parsing and hashing of transactions.
+	// It is the slowest subtask, so goes first
+	const size_t pow_count     = context ? 1 : 0;
+	const size_t subtask_count = pow_count + raw_block.transactions.size();
+	block.transactions.resize(raw_block.transactions.size());
+	auto subtask = [&](size_t i) {
+		if (i < pow_count) {
+			auto ba  = currency.get_block_pow_hashing_data(block.header, body_proxy);
+			pow_hash = context->cn_slow_hash(ba.data(), ba.size());
+			return;
+		}
+		i -= pow_count;
+		seria::from_binary(block.transactions.at(i), raw_block.transactions.at(i));
+		// Transactions are in block
+		if (get_transaction_hash(block.transactions.at(i)) != block.header.transaction_hashes.at(i))
+			throw ConsensusError{"Transaction from block template absent in block"};
+	};
+	if (parallel_for)
+		parallel_for(subtask_count, subtask);
+	else
+		for (size_t i = 0; i != subtask_count; ++i)
+			subtask(i);
 }
 
 BlockChain::BlockChain(logging::ILogger &log, const Config &config, const Currency &currency, bool read_only)
@@ -119,7 +135,8 @@ BlockChain::BlockChain(logging::ILogger &log, const Config &config, const Curren
     , m_archive(read_only || !config.is_archive, config.get_data_folder() + "/archive")
     , m_log(log, "BlockChainState")
     , m_config(config)
-    , m_currency(currency) {
+    , m_currency(currency)
+    , m_header_cache(config.max_header_cache_size) {
 	invariant(CheckpointDifficulty{}.size() == currency.get_checkpoint_keys_count(), "");
 	std::string version;
 	if (!m_db.get("$version", version)) {
@@ -140,8 +157,10 @@ BlockChain::BlockChain(logging::ILogger &log, const Config &config, const Curren
 		seria::from_binary(m_tip_bid, cur2.get_value_array());
 		api::BlockHeader tip_header = read_header(m_tip_bid);
 		m_tip_cumulative_difficulty = tip_header.cumulative_difficulty;
-		m_header_tip_window.push_back(tip_header);
+		m_header_tip_window.push_back(cache_header(m_tip_bid, tip_header));
 	}
+	if (!read_only && m_config.use_chain_index_file)
+		open_chain_index();
 	BinaryArray cha;
 	if (m_db.get("internal_import_chain", cha)) {
 		seria::from_binary(m_internal_import_chain, cha);
@@ -159,17 +178,47 @@ BlockChain::BlockChain(logging::ILogger &log, const Config &config, const Curren
 	//	m_db.debug_print_index_size(CD_TIPS_PREFIX);
 }
 
+void BlockChain::open_chain_index() {
+	// Index opens with records matching DB as of last commit, records pushed after commit can be ahead of DB
+	auto index = std::make_unique<ChainIndex>(m_config.get_data_folder() + "/blockchain_index");
+	if (index->size() > m_tip_height + 1)
+		index->truncate(m_tip_height + 1);
+	// Cheap check against index file left from another copy of DB
+	if (index->size() != 0 && index->get_bid(index->size() - 1) != read_chain(index->size() - 1)) {
+		m_log(logging::WARNING) << "Main chain index does not match database, rebuilding";
+		index->truncate(0);
+	}
+	if (index->size() != m_tip_height + 1)
+		m_log(logging::INFO) << "Building main chain index from height=" << index->size() << " to " << m_tip_height;
+	for (Height ha = index->size(); ha != m_tip_height + 1; ++ha) {
+		if (ha % 100000 == 0)
+			m_log(logging::INFO) << "Building main chain index height=" << ha;
+		index->push(read_header(read_chain(ha), ha));
+	}
+	index->flush();
+	index->set_committed();  // DB has no uncommitted blocks yet
+	m_chain_index = std::move(index);
+}
+
 void BlockChain::db_commit() {
 	m_log(logging::INFO) << "BlockChain::db_commit started... tip_height=" << m_tip_height
-	                     << " m_header_cache.size=" << m_header_cache.size();
+	                     << " m_header_cache.size=" << m_header_cache.size()
+	                     << " m_header_cache.cost=" << m_header_cache.get_total_cost();
+	check_pending_signatures();  // We never commit blocks with signatures not checked
+	if (m_chain_index)
+		m_chain_index->flush();  // so that index is never behind DB
+	before_db_commit();
 	m_db.commit_db_txn();
-	m_header_cache.clear();  // Most simple cache policy ever
+	if (m_chain_index)
+		m_chain_index->set_committed();
 	m_archive.db_commit();
 	m_log(logging::INFO) << "BlockChain::db_commit finished...";
 }
 
-bool BlockChain::add_block(
-    const PreparedBlock &pb, api::BlockHeader *info, bool just_mined, const std::string &source_address) {
+bool BlockChain::add_block(const PreparedBlock &pb, api::BlockHeader *info, bool just_mined,
+    const std::string &source_address, bool defer_signature_checks) {
+	if (!defer_signature_checks)
+		check_pending_signatures();  // Block from other source must be applied to fully checked chain
 	*info            = api::BlockHeader();
 	bool have_header = get_header(pb.bid, info);
 	bool have_block  = has_block(pb.bid);
@@ -221,10 +270,19 @@ bool BlockChain::add_block(
 		if (compare(bid_check_cd, info->cumulative_difficulty, just_mined, tip_check_cd,
 		        get_tip_cumulative_difficulty()) > 0) {
 			if (get_tip_bid() == pb.block.header.previous_block_hash) {  // most common case optimization
-				redo_block(pb.bid, pb.block_data, pb.raw_block, pb.block, *info, pb.base_transaction_hash);
+				m_signature_window = defer_signature_checks ? m_config.signature_check_window : 0;
+				try {
+					redo_block(pb.bid, pb.block_data, pb.raw_block, pb.block, *info, pb.base_transaction_hash);
+				} catch (const std::exception &) {
+					m_signature_window = 0;
+					throw;
+				}
+				m_signature_window = 0;
 				push_chain(*info);
 				if (m_config.paranoid_checks)
 					debug_check_transaction_invariants(pb.raw_block, pb.block, *info, pb.base_transaction_hash);
+				if (defer_signature_checks && !check_pending_signatures(m_config.signature_check_window))
+					throw ConsensusError("Bad signature in one of recently added blocks");
 			} else
 				reorganize_blocks(pb.bid, pb, *info);
 		}
@@ -236,8 +294,12 @@ bool BlockChain::add_block(
 		std::exit(api::BYTECOIND_DATABASE_ERROR);
 	}
 	if (get_tip_height() % m_config.db_commit_every_n_blocks ==
-	    m_config.db_commit_every_n_blocks - 1)  // no commit on genesis
+	    m_config.db_commit_every_n_blocks - 1) {  // no commit on genesis
+		// db_commit would roll back bad block silently, caller must know to ban its source
+		if (defer_signature_checks && !check_pending_signatures())
+			throw ConsensusError("Bad signature in one of recently added blocks");
 		db_commit();
+	}
 	return info->hash == get_tip_bid();
 }
 
@@ -273,70 +335,126 @@ bool BlockChain::reorganize_blocks(const Hash &switch_to_chain,
 		if (!has_block(chha))
 			return false;  // Full new chain not yet downloaded
 	}
-	std::map<Hash, std::pair<Transaction, BinaryArray>> undone_transactions;
+	if (!check_pending_signatures())
+		return false;  // Tip changed, we will reorganize when next block arrives
+	const auto start = std::chrono::steady_clock::now();
+	UndoneTransactions undone_transactions;
 	size_t undone_transactions_binary_size = 0;
-	bool undone_blocks                     = false;
+	bool undone_blocks                     = !chain1.empty();
+	undo_blocks(common, &undone_transactions, &undone_transactions_binary_size);
+	// Now redo all blocks we have in storage, will ask for the rest of blocks
+	// We catch consensus error from redo_block
+	// when invalid block on longest subchain, we should make no attempt to download the rest
+	// we will forever stuck on this block until longer chain appears, that does not include it
+	bool result = true;
+	try {
+		if (chain2.size() > 1) {
+			// Workers check signatures of all blocks instead of waiting at the end of each one. DB is not
+			// committed until we return, so if any signature is bad, we undo whole branch and redo it block
+			// by block, keeping blocks before bad one, as without deferring
+			std::exception_ptr redo_error;
+			start_deferred_signature_checks();
+			try {
+				redo_blocks(chain2, recent_pb, recent_info, &undone_transactions);
+			} catch (const ConsensusError &) {
+				redo_error = std::current_exception();
+			} catch (...) {
+				finish_deferred_signature_checks();  // or every later redo_block would defer its checks
+				throw;
+			}
+			if (!finish_deferred_signature_checks()) {
+				m_log(logging::WARNING) << "Bad signature in new branch, redoing it block by block";
+				undone_blocks = true;
+				undo_blocks(common, &undone_transactions, &undone_transactions_binary_size);
+				redo_blocks(chain2, recent_pb, recent_info, &undone_transactions);
+			} else if (redo_error)
+				std::rethrow_exception(redo_error);
+		} else
+			redo_blocks(chain2, recent_pb, recent_info, &undone_transactions);
+	} catch (const ConsensusError &) {
+		// The only exception which is safe here
+		result = false;
+	}
+	on_reorganization(undone_transactions, undone_blocks);
+	m_reorganization_count += 1;
+	m_last_reorganization_depth    = static_cast<Height>(chain1.size());
+	m_max_reorganization_depth     = std::max(m_max_reorganization_depth, m_last_reorganization_depth);
+	m_last_reorganization_duration = static_cast<uint32_t>(
+	    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	m_log(logging::INFO) << "Reorganization undone " << chain1.size() << " blocks, redone upto " << chain2.size()
+	                     << " blocks, new tip height=" << get_tip_height() << " in " << m_last_reorganization_duration
+	                     << " ms";
+	return result;
+}
+
+bool BlockChain::check_pending_signatures(size_t max_pending) {
+	Hash bad_bid;
+	if (wait_signature_checks(max_pending, &bad_bid))
+		return true;
+	const api::BlockHeader bad_info = read_header(bad_bid);
+	UndoneTransactions undone_transactions;
+	size_t undone_transactions_binary_size = 0;
+	undo_blocks(bad_info.previous_block_hash, &undone_transactions, &undone_transactions_binary_size);
+	on_reorganization(undone_transactions, true);
+	m_log(logging::WARNING) << "Block height=" << bad_info.height << " bid=" << bad_bid
+	                        << " has bad signature, rolled back to height=" << get_tip_height();
+	return false;
+}
+
+void BlockChain::undo_blocks(
+    const Hash &common, UndoneTransactions *undone_transactions, size_t *undone_transactions_size) {
 	while (get_tip_bid() != common) {
 		RawBlock raw_block;
 		invariant(get_block(get_tip_bid(), &raw_block),
 		    "Block to undo not found or failed to convert" + common::pod_to_hex(get_tip_bid()));
 		Block block(raw_block);
-		undone_blocks = true;
 		undo_block(get_tip_bid(), raw_block, block, m_tip_height);
-		if (undone_transactions_binary_size < m_config.max_undo_transactions_size)
+		if (*undone_transactions_size < m_config.max_undo_transactions_size)
 			for (size_t tx_index = 0; tx_index != block.transactions.size(); ++tx_index) {
 				Hash tid = block.header.transaction_hashes.at(tx_index);
-				undone_transactions_binary_size += raw_block.transactions.at(tx_index).size();
-				undone_transactions.insert(
+				*undone_transactions_size += raw_block.transactions.at(tx_index).size();
+				undone_transactions->insert(
 				    std::make_pair(tid, std::make_pair(std::move(block.transactions.at(tx_index)),
 				                            std::move(raw_block.transactions.at(tx_index)))));
 			}
 		pop_chain(block.header.previous_block_hash);
 		tip_changed();
 	}
-	// Now redo all blocks we have in storage, will ask for the rest of blocks
-	// We catch consensus error from redo_block
-	// when invalid block on longest subchain, we should make no attempt to download the rest
-	// we will forever stuck on this block until longer chain appears, that does not include it
-	try {
-		while (!chain2.empty()) {
-			Hash chha = chain2.back();
-			chain2.pop_back();
-			if (chha == recent_pb.bid) {
-				invariant(recent_pb.block.header.previous_block_hash == get_tip_bid(),
-				    "Unexpected block prev, invariant dead");
-				redo_block(recent_pb.bid, recent_pb.block_data, recent_pb.raw_block, recent_pb.block, recent_info,
-				    recent_pb.base_transaction_hash);
-				push_chain(recent_info);
-				for (auto &&tid : recent_pb.block.header.transaction_hashes)
-					undone_transactions.erase(tid);
-				if (m_config.paranoid_checks)
-					debug_check_transaction_invariants(
-					    recent_pb.raw_block, recent_pb.block, recent_info, recent_pb.base_transaction_hash);
-			} else {
-				BinaryArray block_data;
-				RawBlock raw_block;
-				invariant(get_block(chha, &block_data, &raw_block), "");
-				Block block(raw_block);
-				invariant(block.header.previous_block_hash == get_tip_bid(), "Unexpected block prev, invariant dead");
-				api::BlockHeader info      = read_header(chha);
-				Hash base_transaction_hash = get_transaction_hash(block.header.base_transaction);
-
-				redo_block(chha, block_data, raw_block, block, info, base_transaction_hash);
-				push_chain(info);
-				for (auto &&tid : block.header.transaction_hashes)
-					undone_transactions.erase(tid);
-				if (m_config.paranoid_checks)
-					debug_check_transaction_invariants(raw_block, block, info, base_transaction_hash);
-			}
+}
+
+void BlockChain::redo_blocks(std::vector<Hash> chain, const PreparedBlock &recent_pb,
+    const api::BlockHeader &recent_info, UndoneTransactions *undone_transactions) {
+	while (!chain.empty()) {
+		Hash chha = chain.back();
+		chain.pop_back();
+		if (chha == recent_pb.bid) {
+			invariant(
+			    recent_pb.block.header.previous_block_hash == get_tip_bid(), "Unexpected block prev, invariant dead");
+			redo_block(recent_pb.bid, recent_pb.block_data, recent_pb.raw_block, recent_pb.block, recent_info,
+			    recent_pb.base_transaction_hash);
+			push_chain(recent_info);
+			for (auto &&tid : recent_pb.block.header.transaction_hashes)
+				undone_transactions->erase(tid);
+			if (m_config.paranoid_checks)
+				debug_check_transaction_invariants(
+				    recent_pb.raw_block, recent_pb.block, recent_info, recent_pb.base_transaction_hash);
+		} else {
+			BinaryArray block_data;
+			RawBlock raw_block;
+			invariant(get_block(chha, &block_data, &raw_block), "");
+			Block block(raw_block);
+			invariant(block.header.previous_block_hash == get_tip_bid(), "Unexpected block prev, invariant dead");
+			api::BlockHeader info      = read_header(chha);
+			Hash base_transaction_hash = get_transaction_hash(block.header.base_transaction);
+
+			redo_block(chha, block_data, raw_block, block, info, base_transaction_hash);
+			push_chain(info);
+			for (auto &&tid : block.header.transaction_hashes)
+				undone_transactions->erase(tid);
+			if (m_config.paranoid_checks)
+				debug_check_transaction_invariants(raw_block, block, info, base_transaction_hash);
 		}
-	} catch (const ConsensusError &) {
-		// The only exception which is safe here
-		on_reorganization(undone_transactions, undone_blocks);
-		return false;
 	}
-	on_reorganization(undone_transactions, undone_blocks);
-	return true;
 }
 
 Hash BlockChain::get_common_block(
@@ -386,16 +504,19 @@ std::vector<Hash> BlockChain::get_sparse_chain(Height max_jump) const {
 std::vector<HardCheckpoint> BlockChain::get_sparse_chain(Hash start, Hash end, Height max_jump) const {
 	std::vector<HardCheckpoint> tip_path;
 
-	api::BlockHeader header_end;
-	if (!get_header(end, &header_end) || !in_chain(header_end.height, header_end.hash))
+	// We remember only heights, pointers from read_header_fast can be invalidated by next call
+	const api::BlockHeader *header = read_header_fast(end, 0);
+	if (!header || !in_chain(header->height, end))
 		return tip_path;
-	api::BlockHeader header_start;
-	if (!get_header(start, &header_start) || !in_chain(header_start.height, header_start.hash))
+	const Height end_height = header->height;
+	header                  = read_header_fast(start, 0);
+	if (!header || !in_chain(header->height, start))
 		return tip_path;
-	Height jump  = 1;
-	Height delta = 0;
-	while (header_end.height >= delta + header_start.height) {
-		tip_path.push_back(HardCheckpoint{header_end.height - delta, read_chain(header_end.height - delta)});
+	const Height start_height = header->height;
+	Height jump               = 1;
+	Height delta              = 0;
+	while (end_height >= delta + start_height) {
+		tip_path.push_back(HardCheckpoint{end_height - delta, read_chain(end_height - delta)});
 		if (tip_path.size() >= 10) {
 			jump *= 2;
 			if (tip_path.back().height > m_currency.last_hard_checkpoint().height && jump > max_jump)
@@ -404,11 +525,13 @@ std::vector<HardCheckpoint> BlockChain::get_sparse_chain(Hash start, Hash end, H
 		delta += jump;
 	}
 	if (tip_path.back().hash != start)
-		tip_path.push_back(HardCheckpoint{header_start.height, header_start.hash});
+		tip_path.push_back(HardCheckpoint{start_height, start});
 	return tip_path;
 }
 
 Height BlockChain::get_timestamp_lower_bound_height(Timestamp ts) const {
+	if (m_chain_index)  // Can return lower height than DB index, never higher
+		return m_chain_index->get_timestamp_lower_bound_height(ts);
 	auto middle    = common::write_varint_sqlite4(ts);
 	DB::Cursor cur = m_db.begin(TIMESTAMP_BLOCK_PREFIX, middle);
 	if (cur.end())
@@ -460,21 +583,21 @@ void ser_members(APITransactionPos &v, ISeria &s) {
 
 bool BlockChain::has_transaction(const Hash &tid) const {
 	DB::Value value;
-	auto txkey = TRANSACTION_PREFIX + DB::to_binary_key(tid.data, sizeof(tid.data));
+	auto txkey = DB::Key(TRANSACTION_PREFIX).append(tid.data, sizeof(tid.data));
 	return m_db.get(txkey, value);
 }
 
 bool BlockChain::get_transaction(
     const Hash &tid, BinaryArray *binary_tx, Height *block_height, Hash *block_hash, size_t *index_in_block) const {
-	auto txkey = TRANSACTION_PREFIX + DB::to_binary_key(tid.data, sizeof(tid.data));
-	BinaryArray ba;
+	auto txkey = DB::Key(TRANSACTION_PREFIX).append(tid.data, sizeof(tid.data));
+	DB::Value ba;
 	if (!m_db.get(txkey, ba))
 		return false;
 	APITransactionPos tpos;
 	seria::from_binary(tpos, ba);
 	Hash bid = read_chain(tpos.height);
 	DB::Value block_val;
-	auto key = BLOCK_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_SUFFIX;
+	auto key = DB::Key(BLOCK_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_SUFFIX);
 	invariant(m_db.get(key, block_val), "block must be there if transaction is there");
 	invariant(tpos.offset + tpos.size <= block_val.size(), "Transaction offset corrupted");
 	*block_hash     = bid;
@@ -487,13 +610,12 @@ bool BlockChain::get_transaction(
 void BlockChain::redo_block(const Hash &bhash, const BinaryArray &block_data, const RawBlock &raw_block,
     const Block &block, const api::BlockHeader &info, const Hash &base_transaction_hash) {
 	redo_block(bhash, block, info);
-	auto tikey = TIMESTAMP_BLOCK_PREFIX + common::write_varint_sqlite4(info.timestamp) +
-	             common::write_varint_sqlite4(info.height);
+	auto tikey = DB::Key(TIMESTAMP_BLOCK_PREFIX).append_varint(info.timestamp).append_varint(info.height);
 	m_db.put(tikey, std::string{}, true);
 
 	APITransactionPos tpos;
 	tpos.height = info.height;
-	auto bkey  = TRANSACTION_PREFIX + DB::to_binary_key(base_transaction_hash.data, sizeof(base_transaction_hash.data));
+	auto bkey  = DB::Key(TRANSACTION_PREFIX).append(base_transaction_hash.data, sizeof(base_transaction_hash.data));
 	tpos.index = 0;
 	BinaryArray coinbase_ba = seria::to_binary(block.header.base_transaction);
 	auto ptr                = common::slow_memmem(block_data.data() + tpos.offset + tpos.size,
@@ -505,7 +627,7 @@ void BlockChain::redo_block(const Hash &bhash, const BinaryArray &block_data, co
 	for (size_t tx_index = 0; tx_index != block.transactions.size(); ++tx_index) {
 		Hash tid              = block.header.transaction_hashes.at(tx_index);
 		tpos.index            = tx_index + 1;
-		bkey                  = TRANSACTION_PREFIX + DB::to_binary_key(tid.data, sizeof(tid.data));
+		bkey                  = DB::Key(TRANSACTION_PREFIX).append(tid.data, sizeof(tid.data));
 		const auto &binary_tx = raw_block.transactions.at(tx_index);
 		ptr                   = common::slow_memmem(block_data.data() + tpos.offset + tpos.size,
             block_data.size() - tpos.offset - tpos.size, binary_tx.data(), binary_tx.size());
@@ -520,28 +642,27 @@ void BlockChain::undo_block(const Hash &bhash, const RawBlock &, const Block &bl
 	//		m_tip_segment.pop_back();
 	undo_block(bhash, block, height);
 
-	auto tikey = TIMESTAMP_BLOCK_PREFIX + common::write_varint_sqlite4(block.header.timestamp) +
-	             common::write_varint_sqlite4(height);
+	auto tikey = DB::Key(TIMESTAMP_BLOCK_PREFIX).append_varint(block.header.timestamp).append_varint(height);
 	m_db.del(tikey, true);
 
 	Hash tid  = get_transaction_hash(block.header.base_transaction);
-	auto bkey = TRANSACTION_PREFIX + DB::to_binary_key(tid.data, sizeof(tid.data));
+	auto bkey = DB::Key(TRANSACTION_PREFIX).append(tid.data, sizeof(tid.data));
 	m_db.del(bkey, true);
 	for (size_t tx_index = 0; tx_index != block.transactions.size(); ++tx_index) {
 		tid  = block.header.transaction_hashes.at(tx_index);
-		bkey = TRANSACTION_PREFIX + DB::to_binary_key(tid.data, sizeof(tid.data));
+		bkey = DB::Key(TRANSACTION_PREFIX).append(tid.data, sizeof(tid.data));
 		m_db.del(bkey, true);
 	}
 }
 
 void BlockChain::store_block(const Hash &bid, const BinaryArray &block_data) {
-	auto key = BLOCK_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_SUFFIX;
+	auto key = DB::Key(BLOCK_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_SUFFIX);
 	m_db.put(key, block_data, true);
 }
 
 bool BlockChain::get_block(const Hash &bid, BinaryArray *block_data, RawBlock *raw_block) const {
 	BinaryArray rb;
-	auto key = BLOCK_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_SUFFIX;
+	auto key = DB::Key(BLOCK_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_SUFFIX);
 	if (!m_db.get(key, rb))
 		return false;
 	if (raw_block)
@@ -555,43 +676,42 @@ bool BlockChain::get_block(const Hash &bid, RawBlock *raw_block) const { return
 
 bool BlockChain::has_block(const Hash &bid) const {
 	platform::DB::Value ms;
-	auto key = BLOCK_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_SUFFIX;
+	auto key = DB::Key(BLOCK_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_SUFFIX);
 	if (!m_db.get(key, ms))
 		return false;
 	return true;
 }
 
 void BlockChain::store_header(const Hash &bid, const api::BlockHeader &header) {
-	auto key       = HEADER_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + HEADER_SUFFIX;
+	auto key       = DB::Key(HEADER_PREFIX).append(bid.data, sizeof(bid.data)).append(HEADER_SUFFIX);
 	BinaryArray ba = seria::to_binary(header);
 	m_db.put(key, ba, true);
 }
 
+BlockChain::HeaderPtr BlockChain::cache_header(const Hash &bid, const api::BlockHeader &header) const {
+	// Rough estimate, includes shared_ptr control block and cache bookkeeping
+	const size_t cost = sizeof(api::BlockHeader) + header.binary_nonce.size() + 128;
+	return *m_header_cache.insert(bid, std::make_shared<const api::BlockHeader>(header), cost);
+}
+
 const api::BlockHeader *BlockChain::read_header_fast(const Hash &bid, Height hint) const {
 	if (get_tip_height() != Height(-1) && hint <= get_tip_height() &&
 	    hint >= get_tip_height() - m_header_tip_window.size() + 1) {
 		const auto &candidate = m_header_tip_window.at(m_header_tip_window.size() - 1 - (get_tip_height() - hint));
-		if (candidate.hash == bid) {
-			return &candidate;  // fastest lookup is in tip window
+		if (candidate->hash == bid) {
+			return candidate.get();  // fastest lookup is in tip window
 		}
 	}
-	auto cit = m_header_cache.find(bid);
-	if (cit != m_header_cache.end()) {
-		return &cit->second;
-	}
-	Hash bbid = bid;  // next lines can modify bid, because it can be reference to header inside cache
-	if (m_header_cache.size() > m_currency.largest_window() * 20) {
-		m_log(logging::TRACE) << "BlockChain header cache reached max size and cleared";
-		m_header_cache.clear();  // very simple policy
-	}
-	BinaryArray rb;
-	auto key = HEADER_PREFIX + DB::to_binary_key(bbid.data, sizeof(bbid.data)) + HEADER_SUFFIX;
+	if (const HeaderPtr *cached = m_header_cache.find(bid))
+		return cached->get();
+	Hash bbid = bid;  // next lines can evict header bid is referencing from cache
+	DB::Value rb;
+	auto key = DB::Key(HEADER_PREFIX).append(bbid.data, sizeof(bbid.data)).append(HEADER_SUFFIX);
 	if (!m_db.get(key, rb))
 		return nullptr;
 	api::BlockHeader header;
 	seria::from_binary(header, rb);
-	cit = m_header_cache.insert(std::make_pair(bbid, std::move(header))).first;
-	return &cit->second;
+	return cache_header(bbid, header).get();
 }
 
 bool BlockChain::get_header(const Hash &bid, api::BlockHeader *header, Height hint) const {
@@ -602,7 +722,7 @@ bool BlockChain::get_header(const Hash &bid, api::BlockHeader *header, Height hi
 }
 
 bool BlockChain::get_header_data(const Hash &bid, BinaryArray *block_data, Height hint) const {
-	auto key = HEADER_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + HEADER_SUFFIX;
+	auto key = DB::Key(HEADER_PREFIX).append(bid.data, sizeof(bid.data)).append(HEADER_SUFFIX);
 	return m_db.get(key, *block_data);
 }
 
@@ -613,18 +733,28 @@ api::BlockHeader BlockChain::read_header(const Hash &bid, Height hint) const {
 }
 
 const api::BlockHeader &BlockChain::get_tip() const {
-	invariant(!m_header_tip_window.empty() && m_tip_bid == m_header_tip_window.back().hash, "tip window corrupted");
-	return m_header_tip_window.back();
+	invariant(!m_header_tip_window.empty() && m_tip_bid == m_header_tip_window.back()->hash, "tip window corrupted");
+	return *m_header_tip_window.back();
 }
 
 void BlockChain::for_each_reversed_tip_segment(const api::BlockHeader &prev_info, Height window, bool add_genesis,
-    std::function<void(const api::BlockHeader &header)> &&fun) const {
+    std::function<void(const ChainRecord &header)> &&fun) const {
 	if (prev_info.height == Height(-1))
 		return;
 	const api::BlockHeader *header = &prev_info;
 	size_t count                   = 0;
 	while (count < window && header->height != 0) {
-		fun(*header);
+		if (m_chain_index && header->height < m_chain_index->size() &&
+		    m_chain_index->get_bid(header->height) == header->hash) {
+			// Rest of segment is in main chain
+			Height ha = header->height;
+			for (; count < window && ha != 0; ha -= 1, count += 1)
+				fun(m_chain_index->get(ha));
+			if (count < window && add_genesis)
+				fun(m_chain_index->get(0));
+			return;
+		}
+		fun(ChainRecord(*header));
 		count += 1;
 		header = read_header_fast(header->previous_block_hash, header->height - 1);
 		invariant(header, "");
@@ -632,7 +762,7 @@ void BlockChain::for_each_reversed_tip_segment(const api::BlockHeader &prev_info
 	if (count < window && add_genesis) {
 		invariant(
 		    header->height == 0, "Invariant dead - window size not reached, but genesis not found in get_tip_segment");
-		fun(*header);
+		fun(ChainRecord(*header));
 	}
 }
 
@@ -649,10 +779,12 @@ void BlockChain::for_each_reversed_tip_segment(const api::BlockHeader &prev_info
 void BlockChain::push_chain(const api::BlockHeader &header) {
 	m_tip_height += 1;
 	BinaryArray ba = seria::to_binary(header.hash);
-	m_db.put(TIP_CHAIN_PREFIX + common::write_varint_sqlite4(m_tip_height), ba, true);
+	m_db.put(DB::Key(TIP_CHAIN_PREFIX).append_varint(m_tip_height), ba, true);
 	m_tip_bid                   = header.hash;
 	m_tip_cumulative_difficulty = header.cumulative_difficulty;
-	m_header_tip_window.push_back(header);
+	if (m_chain_index)
+		m_chain_index->push(header);
+	m_header_tip_window.push_back(cache_header(header.hash, header));
 	while (m_header_tip_window.size() > m_currency.largest_window() * 2)
 		m_header_tip_window.pop_front();
 	tip_changed();
@@ -661,22 +793,30 @@ void BlockChain::push_chain(const api::BlockHeader &header) {
 void BlockChain::pop_chain(const Hash &new_tip_bid) {
 	invariant(m_tip_height != 0 && !m_header_tip_window.empty(), "pop_chain tip_height == 0");
 	m_header_tip_window.pop_back();
-	m_db.del(TIP_CHAIN_PREFIX + common::write_varint_sqlite4(m_tip_height), true);
+	if (m_chain_index)
+		m_chain_index->pop();
+	m_db.del(DB::Key(TIP_CHAIN_PREFIX).append_varint(m_tip_height), true);
 	m_tip_height -= 1;
 	m_tip_bid = new_tip_bid;
 	invariant(read_chain(m_tip_height) == m_tip_bid,
 	    "After undo tip does not match get_chain " + common::pod_to_hex(m_tip_bid));
 	if (m_header_tip_window.empty()) {
 		api::BlockHeader tip_header = read_header(m_tip_bid);
-		m_header_tip_window.push_back(tip_header);
+		m_header_tip_window.push_back(cache_header(m_tip_bid, tip_header));
 	}
 	m_tip_cumulative_difficulty = get_tip().cumulative_difficulty;
 }
 
 // After upgrading to future versions, remove version from index key
 bool BlockChain::get_chain(Height height, Hash *bid) const {
-	BinaryArray ba;
-	if (!m_db.get(TIP_CHAIN_PREFIX + common::write_varint_sqlite4(height), ba))
+	if (m_chain_index) {
+		if (height >= m_chain_index->size())
+			return false;
+		*bid = m_chain_index->get_bid(height);
+		return true;
+	}
+	DB::Value ba;
+	if (!m_db.get(DB::Key(TIP_CHAIN_PREFIX).append_varint(height), ba))
 		return false;
 	seria::from_binary(*bid, ba);
 	return true;
@@ -698,9 +838,8 @@ Hash BlockChain::read_chain(Height height) const {
 }
 
 void BlockChain::check_children_counter(CumulativeDifficulty cd, const Hash &bid, int value) {
-	auto key    = CHILDREN_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data));
-	auto cd_key = CD_TIPS_PREFIX + common::write_varint_sqlite4(cd.hi) + common::write_varint_sqlite4(cd.lo) +
-	              DB::to_binary_key(bid.data, sizeof(bid.data));
+	auto key    = DB::Key(CHILDREN_PREFIX).append(bid.data, sizeof(bid.data));
+	auto cd_key = DB::Key(CD_TIPS_PREFIX).append_varint(cd.hi).append_varint(cd.lo).append(bid.data, sizeof(bid.data));
 	int counter = 1;  // default is 1 when not stored in db
 	BinaryArray rb;
 	if (m_db.get(key, rb))
@@ -711,9 +850,8 @@ void BlockChain::check_children_counter(CumulativeDifficulty cd, const Hash &bid
 }
 
 void BlockChain::modify_children_counter(CumulativeDifficulty cd, const Hash &bid, int delta) {
-	auto key    = CHILDREN_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data));
-	auto cd_key = CD_TIPS_PREFIX + common::write_varint_sqlite4(cd.hi) + common::write_varint_sqlite4(cd.lo) +
-	              DB::to_binary_key(bid.data, sizeof(bid.data));
+	auto key    = DB::Key(CHILDREN_PREFIX).append(bid.data, sizeof(bid.data));
+	auto cd_key = DB::Key(CD_TIPS_PREFIX).append_varint(cd.hi).append_varint(cd.lo).append(bid.data, sizeof(bid.data));
 	size_t counter = 1;  // default is 1 when not stored in db
 	BinaryArray rb;
 	if (m_db.get(key, rb))
@@ -789,9 +927,9 @@ bool BlockChain::prune_branch(CumulativeDifficulty cd, Hash bid) {
 		api::BlockHeader pa = read_header(me.previous_block_hash);
 		modify_children_counter(pa.cumulative_difficulty, me.previous_block_hash, -1);
 	}
-	auto key = BLOCK_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_SUFFIX;
+	auto key = DB::Key(BLOCK_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_SUFFIX);
 	m_db.del(key, true);
-	auto key2 = HEADER_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + HEADER_SUFFIX;
+	auto key2 = DB::Key(HEADER_PREFIX).append(bid.data, sizeof(bid.data)).append(HEADER_SUFFIX);
 	m_db.del(key2, true);
 	//	m_header_tip_window.clear();
 	//	api::BlockHeader tip_header = read_header(m_tip_bid);
@@ -1017,7 +1155,9 @@ void BlockChain::test_undo_everything(Height new_tip_height) {
 	}
 	invariant(m_header_tip_window.size() == 1 && m_tip_height == 0, "");
 	m_header_tip_window.clear();
-	m_db.del(TIP_CHAIN_PREFIX + common::write_varint_sqlite4(m_tip_height), true);
+	if (m_chain_index)
+		m_chain_index->pop();
+	m_db.del(DB::Key(TIP_CHAIN_PREFIX).append_varint(m_tip_height), true);
 	m_tip_height -= 1;
 	m_tip_bid                   = Hash{};
 	m_tip_cumulative_difficulty = 0;
@@ -1056,8 +1196,8 @@ bool BlockChain::add_checkpoint(const SignedCheckpoint &checkpoint, const std::s
 		return false;  // Height is ignored when disabling key_id
 	PublicKey public_key =
 	    m_currency.get_checkpoint_public_key(checkpoint.key_id);  // returns empty key if out of range
-	auto key_latest               = CHECKPOINT_PREFIX_LATEST + common::write_varint_sqlite4(checkpoint.key_id);
-	auto key_stable               = CHECKPOINT_PREFIX_STABLE + common::write_varint_sqlite4(checkpoint.key_id);
+	auto key_latest               = DB::Key(CHECKPOINT_PREFIX_LATEST).append_varint(checkpoint.key_id);
+	auto key_stable               = DB::Key(CHECKPOINT_PREFIX_STABLE).append_varint(checkpoint.key_id);
 	BinaryArray binary_checkpoint = seria::to_binary(checkpoint);
 	BinaryArray ba;
 	if (m_db.get(key_latest, ba)) {
@@ -1162,7 +1302,7 @@ bool BlockChain::add_blod(const api::BlockHeader &header) {
 	// We inherit from parent and rebuild only if we pass through one of checlpoints
 	for (auto &&ch : get_latest_checkpoints())
 		if (ch.is_enabled() && header.hash == ch.hash) {  // disabled are made stable in add_checkpoint
-			auto key_stable = CHECKPOINT_PREFIX_STABLE + common::write_varint_sqlite4(ch.key_id);
+			auto key_stable = DB::Key(CHECKPOINT_PREFIX_STABLE).append_varint(ch.key_id);
 			m_db.put(key_stable, seria::to_binary(ch), false);
 		}
 	for (auto &&ch : get_stable_checkpoints())
@@ -1250,7 +1390,17 @@ void BlockChain::build_blods() {
 }
 
 void BlockChain::fill_statistics(api::cnd::GetStatistics::Response &res) const {
-	res.checkpoints = get_latest_checkpoints();
+	res.checkpoints            = get_latest_checkpoints();
+	res.header_cache_count     = m_header_cache.size();
+	res.header_cache_size      = m_header_cache.get_total_cost();
+	res.header_cache_hits      = m_header_cache.get_hits();
+	res.header_cache_misses    = m_header_cache.get_misses();
+	res.header_cache_evictions = m_header_cache.get_evictions();
+
+	res.reorganization_count         = m_reorganization_count;
+	res.last_reorganization_depth    = m_last_reorganization_depth;
+	res.max_reorganization_depth     = m_max_reorganization_depth;
+	res.last_reorganization_duration = m_last_reorganization_duration;
 
 	if (!m_currency.wish_to_upgrade())
 		return;
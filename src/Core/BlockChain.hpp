@@ -5,9 +5,13 @@
 
 #include <bitset>
 #include <deque>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include "Archive.hpp"
+#include "ChainIndex.hpp"
 #include "CryptoNote.hpp"
+#include "common/LruCache.hpp"
 #include "logging/LoggerMessage.hpp"
 #include "platform/DB.hpp"
 #include "rpc_api.hpp"
@@ -47,6 +51,9 @@ public:
 	    : ConsensusError(str), key_image(key_image), conflict_height(conflict_height) {}
 };
 
+// Calls body(i) for every i in [0, count), possibly concurrently and in any order. Rethrows exception from body
+typedef std::function<void(size_t count, const std::function<void(size_t)> &body)> ParallelFor;
+
 struct PreparedBlock {
 	BinaryArray block_data;
 	RawBlock raw_block;
@@ -59,11 +66,14 @@ struct PreparedBlock {
 	size_t parent_block_size = 0;
 	Hash pow_hash;  // only if passed context != nullptr
 
-	explicit PreparedBlock(BinaryArray &&ba, const Currency &currency, crypto::CryptoNightContext *context);
-	explicit PreparedBlock(RawBlock &&rba, const Currency &currency, crypto::CryptoNightContext *context);
+	// Transactions are parsed and hashed in parallel with PoW via parallel_for, if passed
+	explicit PreparedBlock(BinaryArray &&ba, const Currency &currency, crypto::CryptoNightContext *context,
+	    const ParallelFor &parallel_for = ParallelFor{});
+	explicit PreparedBlock(RawBlock &&rba, const Currency &currency, crypto::CryptoNightContext *context,
+	    const ParallelFor &parallel_for = ParallelFor{});
 	// we get raw blocks from p2p
 private:
-	void prepare(const Currency &currency, crypto::CryptoNightContext *context);
+	void prepare(const Currency &currency, crypto::CryptoNightContext *context, const ParallelFor &parallel_for);
 };
 
 class BlockChain {
@@ -82,7 +92,7 @@ public:
 	const api::BlockHeader &get_tip() const;
 
 	void for_each_reversed_tip_segment(const api::BlockHeader &prev_info, Height window, bool add_genesis,
-	    std::function<void(const api::BlockHeader &header)> &&fun) const;
+	    std::function<void(const ChainRecord &header)> &&fun) const;
 
 	bool get_chain(Height height, Hash *bid) const;
 	bool in_chain(Height height, Hash bid) const;
@@ -97,7 +107,14 @@ public:
 	bool has_transaction(const Hash &tid) const;
 	// Modify blockchain state. bytecoin header does not contain enough info for consensus calcs, so we cannot have
 	// header chain without block chain
-	bool add_block(const PreparedBlock &pb, api::BlockHeader *info, bool just_mined, const std::string &source_address);
+	// With defer_signature_checks, ring signatures of last Config::signature_check_window blocks added on tip
+	// can be still checked on return, then check_pending_signatures() must be called before tip is used.
+	// Checks are also drained before DB commit, bad signature found then is thrown as ConsensusError
+	bool add_block(const PreparedBlock &pb, api::BlockHeader *info, bool just_mined, const std::string &source_address,
+	    bool defer_signature_checks = false);
+	// Waits until at most max_pending blocks are left unchecked. If any has bad signature, chain is rolled back
+	// to its parent and false is returned
+	bool check_pending_signatures(size_t max_pending = 0);
 
 	// Facilitate sync and download
 	std::vector<Hash> get_sparse_chain(Height max_jump = std::numeric_limits<Height>::max()) const;
@@ -145,6 +162,13 @@ protected:
 	    const Hash &base_transaction_hash) const;
 	void undo_block(const Hash &bhash, const RawBlock &raw_block, const Block &block, Height height);
 	virtual void tip_changed() {}  // Quick hack to allow BlockChainState to update next block params
+	virtual void before_db_commit() {}  // Lets BlockChainState save state kept outside DB
+	// During reorganization signatures of the whole new branch are checked together after it is redone
+	virtual void start_deferred_signature_checks() {}
+	virtual bool finish_deferred_signature_checks() { return true; }  // false if any check failed
+	// Signature window - redo_block leaves its checks running, wait_signature_checks waits for oldest of them
+	size_t m_signature_window = 0;
+	virtual bool wait_signature_checks(size_t max_pending, Hash *bad_bid) { return true; }
 	virtual void on_reorganization(
 	    const std::map<Hash, std::pair<Transaction, BinaryArray>> &undone_transactions, bool undone_blocks) = 0;
 
@@ -167,10 +191,16 @@ private:
 	void push_chain(const api::BlockHeader &header);
 	void pop_chain(const Hash &new_tip_bid);
 	Hash read_chain(Height height) const;
-
-	mutable std::unordered_map<Hash, api::BlockHeader> m_header_cache;
-	std::deque<api::BlockHeader> m_header_tip_window;
+	std::unique_ptr<ChainIndex> m_chain_index;  // nullptr if disabled, then main chain is read from DB
+	void open_chain_index();
+
+	// Headers are shared between tip window and cache, so pointer returned from read_header_fast
+	// stays valid while header is in either of them
+	typedef std::shared_ptr<const api::BlockHeader> HeaderPtr;
+	mutable common::LruCache<Hash, HeaderPtr> m_header_cache;  // cost is approximate memory usage
+	std::deque<HeaderPtr> m_header_tip_window;
 	// We cache recent headers for quick calculation in block windows
+	HeaderPtr cache_header(const Hash &bid, const api::BlockHeader &header) const;
 	const api::BlockHeader *read_header_fast(const Hash &bid, Height hint) const;
 	api::BlockHeader read_header(const Hash &bid, Height hint = 0) const;
 
@@ -181,6 +211,14 @@ private:
 
 	bool reorganize_blocks(
 	    const Hash &switch_to_chain, const PreparedBlock &recent_pb, const api::BlockHeader &recent_info);
+	typedef std::map<Hash, std::pair<Transaction, BinaryArray>> UndoneTransactions;
+	void undo_blocks(const Hash &common, UndoneTransactions *undone_transactions, size_t *undone_transactions_size);
+	void redo_blocks(std::vector<Hash> chain, const PreparedBlock &recent_pb, const api::BlockHeader &recent_info,
+	    UndoneTransactions *undone_transactions);  // throws ConsensusError
+	size_t m_reorganization_count           = 0;
+	Height m_last_reorganization_depth      = 0;  // Blocks undone
+	Height m_max_reorganization_depth       = 0;
+	uint32_t m_last_reorganization_duration = 0;  // ms
 
 	void check_children_counter(CumulativeDifficulty cd, const Hash &bid, int value);
 	void modify_children_counter(CumulativeDifficulty cd, const Hash &bid, int delta);
@@ -24,6 +24,11 @@ static const std::string BLOCK_STACK_INDICES_SUFFIX = "g";
 
 static const std::string DIN_PREFIX = "D";
 
+// tip_bid, next global output index, next nz input index, then (amount, next stack index) pairs, as varints
+static const std::string NEXT_INDEXES_KEY = "$next_indexes";
+
+static const size_t OUTPUTS_INDEX_CHUNK = 10000;  // read by each get_random_outputs until amount is in index
+
 const int chain_reaction = 2;
 
 using namespace cn;
@@ -43,54 +48,79 @@ void ser_members(IBlockChainState::OutputIndexData &v, ISeria &s) {
 }
 }  // namespace seria
 
-BlockChainState::PoolTransaction::PoolTransaction(const Transaction &tx, const BinaryArray &binary_tx, Amount fee,
-    Timestamp timestamp, const Hash &newest_referenced_block)
-    : tx(tx)
-    , binary_tx(binary_tx)
-    , amount(get_tx_sum_outputs(tx))
-    , fee(fee)
-    , timestamp(timestamp)
-    , newest_referenced_block(newest_referenced_block) {}
+void BlockChainState::DeltaState::reserve(size_t keyimages, size_t outputs) {
+	m_keyimages.reserve(keyimages);
+	m_ordered_global_amounts.reserve(outputs);
+}
 
 void BlockChainState::DeltaState::store_keyimage(const KeyImage &key_image, Height height) {
-	invariant(m_keyimages.insert(std::make_pair(key_image, height)).second, common::pod_to_hex(key_image));
+	if (!m_keyimages.empty() && !(m_keyimages.back().first < key_image))
+		m_keyimages_sorted = false;
+	m_keyimages.push_back(std::make_pair(key_image, height));
 }
 
 void BlockChainState::DeltaState::delete_keyimage(const KeyImage &key_image) {
-	invariant(m_keyimages.erase(key_image) == 1, common::pod_to_hex(key_image));
+	auto kit = std::find_if(m_keyimages.begin(), m_keyimages.end(),
+	    [&](const std::pair<KeyImage, Height> &ki) { return ki.first == key_image; });
+	invariant(kit != m_keyimages.end(), common::pod_to_hex(key_image));
+	m_keyimages.erase(kit);
 }
 
 bool BlockChainState::DeltaState::read_keyimage(const KeyImage &key_image, Height *height) const {
-	auto kit = m_keyimages.find(key_image);
+	// Not on hot path, fill_ring_check_args reads parent state
+	auto kit = std::find_if(m_keyimages.begin(), m_keyimages.end(),
+	    [&](const std::pair<KeyImage, Height> &ki) { return ki.first == key_image; });
 	if (kit == m_keyimages.end())
 		return m_parent_state->read_keyimage(key_image, height);
 	*height = m_block_height;
 	return true;
 }
 
+const std::vector<std::pair<KeyImage, Height>> &BlockChainState::DeltaState::get_keyimages() {
+	if (!m_keyimages_sorted) {
+		std::sort(m_keyimages.begin(), m_keyimages.end(),
+		    [](const std::pair<KeyImage, Height> &a, const std::pair<KeyImage, Height> &b) {
+			    return a.first < b.first;
+		    });
+		m_keyimages_sorted = true;
+		auto dit           = std::adjacent_find(m_keyimages.begin(), m_keyimages.end(),
+            [](const std::pair<KeyImage, Height> &a, const std::pair<KeyImage, Height> &b) {
+                return a.first == b.first;
+            });
+		invariant(dit == m_keyimages.end(), common::pod_to_hex(dit->first));
+	}
+	return m_keyimages;
+}
+
 size_t BlockChainState::DeltaState::push_amount_output(
     Amount amount, BlockOrTimestamp unlock_time, Height block_height, const PublicKey &pk, bool is_amethyst) {
+	auto pg = m_parent_state->next_stack_index_for_amount(amount);
 	m_ordered_global_amounts.push_back(OutputIndexData{amount, unlock_time, pk, 0, 0, is_amethyst, {}});
-	auto pg  = m_parent_state->next_stack_index_for_amount(amount);
-	auto &ga = m_global_amounts[amount];
-	ga.push_back(std::make_tuple(unlock_time, pk, is_amethyst));
-	return pg + ga.size() - 1;
+	auto cit = std::find_if(m_amount_counts.begin(), m_amount_counts.end(),
+	    [&](const std::pair<Amount, size_t> &ac) { return ac.first == amount; });
+	if (cit == m_amount_counts.end())
+		cit = m_amount_counts.insert(m_amount_counts.end(), std::make_pair(amount, size_t(0)));
+	cit->second += 1;
+	return pg + cit->second - 1;
 }
 
 void BlockChainState::DeltaState::pop_amount_output(Amount amount, BlockOrTimestamp unlock_time, const PublicKey &pk) {
-	std::vector<std::tuple<Amount, PublicKey, bool>> &el = m_global_amounts[amount];
-	invariant(!el.empty(), "DeltaState::pop_amount_output underflow");
+	auto cit = std::find_if(m_amount_counts.begin(), m_amount_counts.end(),
+	    [&](const std::pair<Amount, size_t> &ac) { return ac.first == amount; });
+	invariant(cit != m_amount_counts.end() && cit->second != 0, "DeltaState::pop_amount_output underflow");
 	invariant(!m_ordered_global_amounts.empty(), "DeltaState::pop_amount_output hidden underflow");
-	invariant(std::get<0>(el.back()) == unlock_time && std::get<1>(el.back()) == pk,
+	const auto &last = m_ordered_global_amounts.back();
+	invariant(last.amount == amount && last.unlock_block_or_timestamp == unlock_time && last.public_key == pk,
 	    "DeltaState::pop_amount_output wrong element");
-	el.pop_back();
+	cit->second -= 1;
 	m_ordered_global_amounts.pop_back();
 }
 
 size_t BlockChainState::DeltaState::next_stack_index_for_amount(Amount amount) const {
 	auto pg  = m_parent_state->next_stack_index_for_amount(amount);
-	auto git = m_global_amounts.find(amount);
-	return (git == m_global_amounts.end()) ? pg : git->second.size() + pg;
+	auto cit = std::find_if(m_amount_counts.begin(), m_amount_counts.end(),
+	    [&](const std::pair<Amount, size_t> &ac) { return ac.first == amount; });
+	return (cit == m_amount_counts.end()) ? pg : cit->second + pg;
 }
 
 // We do not allow reading outputs added in the context of this delta state
@@ -99,10 +129,10 @@ bool BlockChainState::DeltaState::read_amount_output(Amount amount, size_t stack
 	return m_parent_state->read_amount_output(amount, stack_index, unp);
 }
 
-void BlockChainState::DeltaState::apply(IBlockChainState *parent_state) const {
-	for (auto &&ki : m_keyimages)
+void BlockChainState::DeltaState::apply(IBlockChainState *parent_state) {
+	for (auto &&ki : get_keyimages())  // sorted, so DB keys are written in order
 		parent_state->store_keyimage(ki.first, ki.second);
-	for (auto &&amp : m_ordered_global_amounts)
+	for (auto &&amp : m_ordered_global_amounts)  // order defines global and stack indexes
 		parent_state->push_amount_output(
 		    amp.amount, amp.unlock_block_or_timestamp, m_block_height, amp.public_key, amp.is_amethyst);
 }
@@ -110,7 +140,9 @@ void BlockChainState::DeltaState::apply(IBlockChainState *parent_state) const {
 void BlockChainState::DeltaState::clear(Height new_block_height) {
 	m_block_height = new_block_height;
 	m_keyimages.clear();
-	m_global_amounts.clear();
+	m_keyimages_sorted = true;
+	m_amount_counts.clear();
+	m_ordered_global_amounts.clear();
 }
 
 // returns reward for coinbase transaction or fee for non-coinbase one
@@ -186,6 +218,10 @@ static Amount validate_tx_semantic(const Currency &currency, uint8_t block_major
 BlockChainState::BlockChainState(logging::ILogger &log, const Config &config, const Currency &currency, bool read_only)
     : BlockChain(log, config, currency, read_only)
     , m_max_pool_size(config.max_pool_size)
+    , m_tx_pool(config.compact_tx_pool)
+    , m_output_key_cache(
+          config.output_key_cache_size != 0 ? std::make_unique<OutputKeyCache>(config.output_key_cache_size) : nullptr)
+    , m_ring_checker(m_output_key_cache.get())
     , m_log_redo_block_timestamp(std::chrono::steady_clock::now()) {
 	std::string version;
 	m_db.get("$version", version);
@@ -213,13 +249,25 @@ BlockChainState::BlockChainState(logging::ILogger &log, const Config &config, co
 	BlockChainState::tip_changed();
 	m_log(logging::INFO) << "height=" << get_tip_height() << " bid=" << get_tip_bid()
 	                     << " cumulative_difficulty=" << get_tip_cumulative_difficulty();
+	if (!read_only && m_config.use_keyimage_filter)
+		open_keyimage_filter();
 	build_blods();
 	DB::Cursor cur2 = m_db.rbegin(DIN_PREFIX);
-	m_next_nz_input_index =
+	const size_t next_nz_input_index =
 	    cur2.end() ? 0 : common::integer_cast<size_t>(common::read_varint_sqlite4(cur2.get_suffix())) + 1;
 	DB::Cursor cur3 = m_db.rbegin(OUTPUT_PREFIX);
-	m_next_global_key_output_index =
+	const size_t next_global_key_output_index =
 	    cur3.end() ? 0 : common::integer_cast<size_t>(common::read_varint_sqlite4(cur3.get_suffix())) + 1;
+	// Two seeks above are cheap sanity check of snapshot, which replaces one seek per amount
+	if (load_next_indexes() && m_next_nz_input_index == next_nz_input_index &&
+	    m_next_global_key_output_index == next_global_key_output_index) {
+		m_log(logging::INFO) << "Loaded next indexes snapshot, amounts=" << m_next_stack_index.size();
+	} else {
+		m_next_stack_index.clear();
+		m_next_nz_input_index          = next_nz_input_index;
+		m_next_global_key_output_index = next_global_key_output_index;
+	}
+	m_next_indexes_loaded = true;
 	//	m_db.debug_print_index_size(KEYIMAGE_PREFIX);
 	//	m_db.debug_print_index_size(AMOUNT_OUTPUT_PREFIX);
 	//	m_db.debug_print_index_size(OUTPUT_PREFIX);
@@ -314,21 +362,8 @@ void BlockChainState::check_consensus(
 	const Amount miner_reward = validate_tx_semantic(
 	    m_currency, block.header.major_version, true, block.header.base_transaction, check_keys, subgroup_check);
 	size_t key_outputs_count = get_tx_key_outputs_count(block.header.base_transaction);
-	{
-		std::vector<Timestamp> timestamps;
-		std::vector<CumulativeDifficulty> difficulties;
-        const Height blocks_count = m_currency.difficulty_windows(); //m_currency.difficulty_windows_plus_lag();
-		timestamps.reserve(blocks_count);
-		difficulties.reserve(blocks_count);
-		for_each_reversed_tip_segment(prev_info, blocks_count, false, [&](const api::BlockHeader &header) {
-			timestamps.push_back(header.timestamp);
-			difficulties.push_back(header.cumulative_difficulty);
-		});
-		std::reverse(timestamps.begin(), timestamps.end());
-		std::reverse(difficulties.begin(), difficulties.end());
-		info->difficulty = m_currency.next_effective_difficulty(block.header.major_version, timestamps, difficulties);
-		info->cumulative_difficulty = prev_info.cumulative_difficulty + info->difficulty;
-	}
+	info->difficulty            = calculate_next_difficulty(prev_info, block.header.major_version);
+	info->cumulative_difficulty = prev_info.cumulative_difficulty + info->difficulty;
 
 	info->transactions_fee = 0;
 	for (auto &&tx : pb.block.transactions) {
@@ -380,11 +415,39 @@ void BlockChainState::check_consensus(
 }
 void BlockChainState::fill_statistics(api::cnd::GetStatistics::Response &res) const {
 	BlockChain::fill_statistics(res);
-	res.transaction_pool_count               = m_memory_state_tx.size();
-	res.transaction_pool_size                = m_memory_state_total_size;
+	res.transaction_pool_count               = m_tx_pool.size();
+	res.transaction_pool_size                = m_tx_pool.get_total_size();
 	res.transaction_pool_max_size            = m_max_pool_size;
 	res.transaction_pool_lowest_fee_per_byte = minimum_pool_fee_per_byte(false);
 	res.node_database_size                   = m_db.test_get_approximate_size();
+	if (m_keyimage_filter) {
+		res.keyimage_filter_count = m_keyimage_filter->size();
+		res.keyimage_filter_size  = m_keyimage_filter->get_memory_size();
+	}
+	res.keyimage_filter_lookups         = m_keyimage_filter_lookups.load(std::memory_order_relaxed);
+	res.keyimage_filter_skipped         = m_keyimage_filter_skipped.load(std::memory_order_relaxed);
+	res.keyimage_filter_false_positives = m_keyimage_filter_false_positives.load(std::memory_order_relaxed);
+	if (m_output_key_cache) {
+		res.output_key_cache_count  = m_output_key_cache->size();
+		res.output_key_cache_size   = m_output_key_cache->get_total_cost();
+		res.output_key_cache_hits   = m_output_key_cache->get_hits();
+		res.output_key_cache_misses = m_output_key_cache->get_misses();
+	}
+}
+
+Difficulty BlockChainState::calculate_next_difficulty(const api::BlockHeader &prev_info, uint8_t major_version) const {
+	std::vector<Timestamp> timestamps;
+	std::vector<CumulativeDifficulty> difficulties;
+	const Height blocks_count = m_currency.difficulty_windows();  // m_currency.difficulty_windows_plus_lag();
+	timestamps.reserve(blocks_count);
+	difficulties.reserve(blocks_count);
+	for_each_reversed_tip_segment(prev_info, blocks_count, false, [&](const ChainRecord &header) {
+		timestamps.push_back(header.timestamp);
+		difficulties.push_back(header.cumulative_difficulty);
+	});
+	std::reverse(timestamps.begin(), timestamps.end());
+	std::reverse(difficulties.begin(), difficulties.end());
+	return m_currency.next_effective_difficulty(major_version, timestamps, difficulties);
 }
 
 Timestamp BlockChainState::calculate_next_median_timestamp(const api::BlockHeader &prev_info) const {
@@ -392,7 +455,7 @@ Timestamp BlockChainState::calculate_next_median_timestamp(const api::BlockHeade
 	auto timestamp_check_window = m_currency.timestamp_check_window(prev_info.major_version);
 	timestamps.reserve(timestamp_check_window);
 	for_each_reversed_tip_segment(prev_info, timestamp_check_window, false,
-	    [&](const api::BlockHeader &header) { timestamps.push_back(header.timestamp); });
+	    [&](const ChainRecord &header) { timestamps.push_back(header.timestamp); });
 	if (timestamps.size() >= timestamp_check_window)
 		return common::median_value(&timestamps);  // sorts timestamps
 	return 0;
@@ -402,7 +465,7 @@ size_t BlockChainState::calculate_next_median_size(const api::BlockHeader &prev_
 	std::vector<size_t> last_transactions_sizes;
 	last_transactions_sizes.reserve(m_currency.median_block_size_window);
 	for_each_reversed_tip_segment(prev_info, m_currency.median_block_size_window, true,
-	    [&](const api::BlockHeader &header) { last_transactions_sizes.push_back(header.transactions_size); });
+	    [&](const ChainRecord &header) { last_transactions_sizes.push_back(header.transactions_size); });
 	return common::median_value(&last_transactions_sizes);
 }
 
@@ -410,7 +473,7 @@ size_t BlockChainState::calculate_next_median_block_capacity_vote(const api::Blo
 	std::vector<size_t> last_blocks_sizes;
 	last_blocks_sizes.reserve(m_currency.block_capacity_vote_window);
 	for_each_reversed_tip_segment(
-	    prev_info, m_currency.block_capacity_vote_window, true, [&](const api::BlockHeader &header) {
+	    prev_info, m_currency.block_capacity_vote_window, true, [&](const ChainRecord &header) {
 		    if (header.major_version >= m_currency.amethyst_block_version)
 			    last_blocks_sizes.push_back(header.block_capacity_vote);
 	    });
@@ -423,38 +486,87 @@ void BlockChainState::tip_changed() {
 	m_next_median_timestamp           = calculate_next_median_timestamp(get_tip());
 	m_next_median_size                = calculate_next_median_size(get_tip());
 	m_next_median_block_capacity_vote = calculate_next_median_block_capacity_vote(get_tip());
+	m_mining_template                 = MiningTemplateCache{};  // Pool can change without version increment
+}
+
+const BlockChainState::MiningTemplateCache &BlockChainState::get_mining_template(
+    const Hash &parent_bid, size_t extra_nonce_size) const {
+	MiningTemplateCache &mt = m_mining_template;
+	if (mt.parent_bid != parent_bid) {
+		MiningTemplateCache fresh;
+		if (!get_header(parent_bid, &fresh.parent_info))
+			throw std::runtime_error("Attempt to mine from block we do not have");
+		const Height height      = fresh.parent_info.height + 1;
+		uint8_t major_version_cm = 0;
+		if (!fill_next_block_versions(fresh.parent_info, &fresh.major_version, &major_version_cm))
+			throw std::runtime_error(
+			    "Mining of block in chain not passing through last hard checkpoint is not possible (will not be accepted by network anyway)");
+		fresh.difficulty            = calculate_next_difficulty(fresh.parent_info, fresh.major_version);
+		fresh.next_median_timestamp = calculate_next_median_timestamp(fresh.parent_info);
+		if (fresh.major_version >= m_currency.amethyst_block_version) {
+			fresh.max_consensus_txs_size = calculate_next_median_block_capacity_vote(fresh.parent_info);
+		} else {
+			const size_t next_median_size         = calculate_next_median_size(fresh.parent_info);
+			const size_t next_minimum_size_median = m_currency.get_minimum_size_median(fresh.major_version);
+			fresh.effective_size_median           = std::max(next_median_size, next_minimum_size_median);
+			fresh.max_consensus_txs_size =
+			    std::min(m_currency.max_block_transactions_cumulative_size(height), 2 * fresh.effective_size_median);
+		}
+		fresh.parent_bid = parent_bid;
+		mt               = std::move(fresh);
+	}
+	const size_t max_txs_size = mt.max_consensus_txs_size - m_currency.miner_tx_blob_reserved_size - extra_nonce_size;
+	if (mt.tx_pool_version == m_tx_pool_version && mt.max_txs_size == max_txs_size)
+		return mt;
+	const Height height    = mt.parent_info.height + 1;
+	const bool is_amethyst = mt.major_version >= m_currency.amethyst_block_version;
+
+	clear_mining_transactions();  // We periodically forget transactions for old blocks we gave as templates
+	//	DeltaState memory_state(height, b->timestamp, next_median_timestamp, this);
+
+	// Effective median size will not grow anyway, so no reason to fill more than it
+	TransactionPool::Selection selection =
+	    m_tx_pool.select_knapsack(is_amethyst ? max_txs_size : std::min(max_txs_size, mt.effective_size_median));
+	for (const auto &tid : selection.tids) {
+		m_mining_transactions.erase(tid);  // We want ot update height to most recent
+		m_mining_transactions.insert(std::make_pair(tid, std::make_pair(m_tx_pool.at(tid).binary_tx, height)));
+		m_log(logging::TRACE) << "Transaction " << tid << " included to block template";
+	}
+	mt.transaction_hashes = std::move(selection.tids);
+	mt.txs_size           = selection.size;
+	mt.txs_fee            = selection.fee;
+	mt.block_capacity_vote = 0;
+	if (is_amethyst) {
+		// Vote for larger blocks if pool is full of expensive transactions
+		Amount desired_fee_per_byte = 100;
+		const auto &fee_index       = m_tx_pool.get_fee_index();
+		for (auto fit = fee_index.rbegin(); fit != fee_index.rend(); ++fit) {
+			if (fit->first < desired_fee_per_byte)
+				break;
+			mt.block_capacity_vote += m_tx_pool.at(fit->second).binary_tx.size();
+		}
+		mt.block_capacity_vote += m_currency.block_capacity_vote_min / 2;  // A bit of space for cheaper transactions
+		mt.block_capacity_vote = std::max(mt.block_capacity_vote, m_currency.block_capacity_vote_min);
+		mt.block_capacity_vote = std::min(mt.block_capacity_vote, m_currency.block_capacity_vote_max);
+	}
+	mt.tx_pool_version = m_tx_pool_version;
+	mt.max_txs_size    = max_txs_size;
+	return mt;
 }
 
 void BlockChainState::create_mining_block_template(const Hash &parent_bid, const AccountAddress &adr,
     const BinaryArray &extra_nonce, const Hash &miner_secret, BlockTemplate *b, Difficulty *difficulty, Height *height,
     size_t *reserved_back_offset) const {
-	api::BlockHeader parent_info;
-	if (!get_header(parent_bid, &parent_info))
-		throw std::runtime_error("Attempt to mine from block we do not have");
-	*height                  = parent_info.height + 1;
-	*b                       = BlockTemplate{};
-	b->minor_version         = m_currency.upgrade_vote_minor;
-	uint8_t major_version_cm = 0;
-	if (!fill_next_block_versions(parent_info, &b->major_version, &major_version_cm))
-		throw std::runtime_error(
-		    "Mining of block in chain not passing through last hard checkpoint is not possible (will not be accepted by network anyway)");
-	const bool is_amethyst = b->major_version >= m_currency.amethyst_block_version;
+	const MiningTemplateCache &mt = get_mining_template(parent_bid, extra_nonce.size());
+
+	const api::BlockHeader &parent_info = mt.parent_info;
+	*height                             = parent_info.height + 1;
+	*difficulty                         = mt.difficulty;
+	*b                                  = BlockTemplate{};
+	b->minor_version                    = m_currency.upgrade_vote_minor;
+	b->major_version                    = mt.major_version;
+	const bool is_amethyst              = b->major_version >= m_currency.amethyst_block_version;
 
-	clear_mining_transactions();  // We periodically forget transactions for old blocks we gave as templates
-	{
-		std::vector<Timestamp> timestamps;
-		std::vector<CumulativeDifficulty> difficulties;
-        const Height blocks_count = m_currency.difficulty_windows(); // m_currency.difficulty_windows_plus_lag();
-		timestamps.reserve(blocks_count);
-		difficulties.reserve(blocks_count);
-		for_each_reversed_tip_segment(parent_info, blocks_count, false, [&](const api::BlockHeader &header) {
-			timestamps.push_back(header.timestamp);
-			difficulties.push_back(header.cumulative_difficulty);
-		});
-		std::reverse(timestamps.begin(), timestamps.end());
-		std::reverse(difficulties.begin(), difficulties.end());
-		*difficulty = m_currency.next_effective_difficulty(b->major_version, timestamps, difficulties);
-	}
 	b->nonce.resize(4);
 	if (b->is_merge_mined()) {
 		// Code similar to set_root_extra_to_solo_mining_tag, but with empty MM tag
@@ -466,76 +578,25 @@ void BlockChainState::create_mining_block_template(const Hash &parent_bid, const
 		extra::add_merge_mining_tag(b->root_block.coinbase_transaction.extra, extra::MergeMiningTag{});
 	}
 
-	b->previous_block_hash                = parent_bid;
-	const Timestamp next_median_timestamp = calculate_next_median_timestamp(parent_info);
-	auto now                              = platform::now_unix_timestamp();
+	b->previous_block_hash = parent_bid;
+	auto now               = platform::now_unix_timestamp();
 	if (*height < 100)  // Tweak for testnet so first 100 blocks are mined quickly
 		now -= (100 - *height) * m_currency.difficulty_target;
-	b->root_block.timestamp = std::max(now, next_median_timestamp);
+	b->root_block.timestamp = std::max(now, mt.next_median_timestamp);
 	b->timestamp            = b->root_block.timestamp;
 
-	size_t max_txs_size          = 0;
-	size_t effective_size_median = 0;
-
-	if (is_amethyst) {
-		const size_t next_median_block_capacity_vote = calculate_next_median_block_capacity_vote(parent_info);
-		max_txs_size = next_median_block_capacity_vote - m_currency.miner_tx_blob_reserved_size - extra_nonce.size();
-	} else {
-		const size_t next_median_size         = calculate_next_median_size(parent_info);
-		const size_t next_minimum_size_median = m_currency.get_minimum_size_median(b->major_version);
-		effective_size_median                 = std::max(next_median_size, next_minimum_size_median);
-		const auto max_consensus_transactions_size =
-		    std::min(m_currency.max_block_transactions_cumulative_size(*height), 2 * effective_size_median);
-		max_txs_size = max_consensus_transactions_size - m_currency.miner_tx_blob_reserved_size - extra_nonce.size();
-	}
-
-	std::vector<Hash> pool_hashes;
-	for (auto &&msf : m_memory_state_fee_tx)
-		pool_hashes.push_back(msf.second);
-	size_t txs_size = 0;
-	Amount txs_fee  = 0;
-	//	DeltaState memory_state(*height, b->timestamp, next_median_timestamp, this);
-
-	for (; !pool_hashes.empty(); pool_hashes.pop_back()) {
-		auto tit = m_memory_state_tx.find(pool_hashes.back());
-		if (tit == m_memory_state_tx.end()) {
-			m_log(logging::ERROR) << "Transaction " << pool_hashes.back() << " is in pool index, but not in pool";
-			continue;
-		}
-		const size_t tx_size = tit->second.binary_tx.size();
-		const Amount tx_fee  = tit->second.fee;
-		if (txs_size + tx_size > max_txs_size)
-			continue;
-		if (!is_amethyst && txs_size + tx_size > effective_size_median)
-			continue;  // Effective median size will not grow anyway
-		txs_size += tx_size;
-		txs_fee += tx_fee;
-		b->transaction_hashes.emplace_back(tit->first);
-		m_mining_transactions.erase(tit->first);  // We want ot update height to most recent
-		m_mining_transactions.insert(std::make_pair(tit->first, std::make_pair(tit->second.binary_tx, *height)));
-		m_log(logging::TRACE) << "Transaction " << tit->first << " included to block template";
-	}
+	const size_t effective_size_median = mt.effective_size_median;
+	const size_t txs_size              = mt.txs_size;
+	const Amount txs_fee               = mt.txs_fee;
+	b->transaction_hashes              = mt.transaction_hashes;
 	if (crypto::rand<unsigned>() % 2 == 1)
 		std::reverse(b->transaction_hashes.begin(), b->transaction_hashes.end());
 
 	if (is_amethyst) {
-		// Vote for larger blocks if pool is full of expensive transactions
-		Amount desired_fee_per_byte = 100;
-		size_t block_capacity_vote  = 0;
-		for (auto fit = m_memory_state_fee_tx.rbegin(); fit != m_memory_state_fee_tx.rend(); ++fit) {
-			if (fit->first < desired_fee_per_byte)
-				break;
-			auto tit = m_memory_state_tx.find(fit->second);
-			invariant(tit != m_memory_state_tx.end(), "Memory pool corrupted");
-			block_capacity_vote += tit->second.binary_tx.size();
-		}
-		block_capacity_vote += m_currency.block_capacity_vote_min / 2;  // A bit of space for cheaper transactions
-		block_capacity_vote = std::max(block_capacity_vote, m_currency.block_capacity_vote_min);
-		block_capacity_vote = std::min(block_capacity_vote, m_currency.block_capacity_vote_max);
 		Amount block_reward =
 		    txs_fee + m_currency.get_base_block_reward(b->major_version, *height, parent_info.already_generated_coins);
 		b->base_transaction = m_currency.construct_miner_tx(miner_secret, b->major_version, *height, block_reward, adr);
-		extra::add_block_capacity_vote(b->base_transaction.extra, block_capacity_vote);
+		extra::add_block_capacity_vote(b->base_transaction.extra, mt.block_capacity_vote);
 		if (!extra_nonce.empty())
 			extra::add_nonce(b->base_transaction.extra, extra_nonce);
 		*reserved_back_offset =
@@ -602,10 +663,10 @@ bool BlockChainState::add_mined_block(
 	raw_block->transactions.reserve(block_template.transaction_hashes.size());
 	raw_block->transactions.clear();
 	for (const auto &tx_hash : block_template.transaction_hashes) {
-		auto tit                     = m_memory_state_tx.find(tx_hash);
-		const BinaryArray *binary_tx = nullptr;
-		if (tit != m_memory_state_tx.end())
-			binary_tx = &(tit->second.binary_tx);
+		const TransactionPool::Record *record = m_tx_pool.find(tx_hash);
+		const BinaryArray *binary_tx          = nullptr;
+		if (record)
+			binary_tx = &(record->binary_tx);
 		else {
 			auto tit2 = m_mining_transactions.find(tx_hash);
 			if (tit2 == m_mining_transactions.end()) {
@@ -622,6 +683,28 @@ bool BlockChainState::add_mined_block(
 	return add_block(pb, info, true, "json_rpc");
 }
 
+bool BlockChainState::check_header_for_relay(PreparedBlock *pb) const {
+	const auto &header                = pb->block.header;
+	const api::BlockHeader &prev_info = get_tip();
+	if (header.previous_block_hash != prev_info.hash)
+		return false;  // Side chain blocks are relayed only after add_block
+	if (m_currency.is_in_hard_checkpoint_zone(prev_info.height + 1))
+		return false;
+	if (header.timestamp > platform::now_unix_timestamp() + m_currency.block_future_time_limit ||
+	    header.timestamp < m_next_median_timestamp)
+		return false;
+	uint8_t should_be_major_mm = 0, should_be_major_cm = 0;
+	if (!fill_next_block_versions(prev_info, &should_be_major_mm, &should_be_major_cm))
+		return false;
+	if (header.major_version != should_be_major_mm && header.major_version != should_be_major_cm)
+		return false;
+	if (pb->pow_hash == Hash{}) {
+		auto ba      = m_currency.get_block_pow_hashing_data(header, pb->body_proxy);
+		pb->pow_hash = m_hash_crypto_context.cn_slow_hash(ba.data(), ba.size());
+	}
+	return check_hash(pb->pow_hash, calculate_next_difficulty(prev_info, header.major_version));
+}
+
 void BlockChainState::clear_mining_transactions() const {
 	for (auto tit = m_mining_transactions.begin(); tit != m_mining_transactions.end();)
 		if (get_tip_height() > tit->second.second + 10)  // Remember used txs for some number of blocks
@@ -631,17 +714,17 @@ void BlockChainState::clear_mining_transactions() const {
 }
 
 Amount BlockChainState::minimum_pool_fee_per_byte(bool zero_if_not_full, Hash *minimal_tid) const {
-	if (m_memory_state_fee_tx.empty()) {
+	if (m_tx_pool.empty()) {
 		if (minimal_tid)
 			*minimal_tid = Hash{};
 		return 0;
 	}
-	if (zero_if_not_full && m_memory_state_total_size < m_max_pool_size) {
+	if (zero_if_not_full && m_tx_pool.get_total_size() < m_max_pool_size) {
 		if (minimal_tid)
 			*minimal_tid = Hash{};
 		return 0;
 	}
-	auto be = m_memory_state_fee_tx.begin();
+	auto be = m_tx_pool.get_fee_index().begin();
 	if (minimal_tid)
 		*minimal_tid = be->second;
 	return be->first;
@@ -651,14 +734,13 @@ void BlockChainState::on_reorganization(
     const std::map<Hash, std::pair<Transaction, BinaryArray>> &undone_transactions, bool undone_blocks) {
 	// TODO - remove/add only those transactions that could have their referenced output keys changed
 	if (undone_blocks) {
-		PoolTransMap old_memory_state_tx;
-		std::swap(old_memory_state_tx, m_memory_state_tx);
-		m_memory_state_ki_tx.clear();
-		m_memory_state_fee_tx.clear();
-		m_memory_state_total_size = 0;
-		for (auto &&msf : old_memory_state_tx) {
+		TransactionPool old_tx_pool(m_tx_pool.is_compact());
+		std::swap(old_tx_pool, m_tx_pool);
+		const auto &fee_index = old_tx_pool.get_fee_index();
+		for (auto fit = fee_index.rbegin(); fit != fee_index.rend(); ++fit) {  // Most expensive first
+			const TransactionPool::Record &record = old_tx_pool.at(fit->second);
 			try {
-				add_transaction(msf.first, msf.second.tx, msf.second.binary_tx, true, std::string{});
+				add_transaction(record.tid, record.get_tx(), record.binary_tx, true, std::string{});
 			} catch (const std::exception &) {  // Just skip now invalid transactions
 			}
 		}
@@ -675,58 +757,95 @@ void BlockChainState::on_reorganization(
 std::vector<TransactionDesc> BlockChainState::sync_pool(
     const std::pair<Amount, Hash> &from, const std::pair<Amount, Hash> &to, size_t max_count) const {
 	std::vector<TransactionDesc> result;
-	auto sit = m_memory_state_fee_tx.lower_bound(from);
-	if (sit != m_memory_state_fee_tx.end()) {
+	const auto &fee_index = m_tx_pool.get_fee_index();
+	auto sit              = fee_index.lower_bound(from);
+	if (sit != fee_index.end()) {
 		if (*sit != from)
 			++sit;
 	}
-	while (sit != m_memory_state_fee_tx.begin()) {
+	while (sit != fee_index.begin()) {
 		--sit;
 		if (result.size() > max_count || *sit <= to)
 			break;
+		const TransactionPool::Record &record = m_tx_pool.at(sit->second);
 		TransactionDesc desc;
-		desc.hash = sit->second;
-		auto tit  = m_memory_state_tx.find(desc.hash);
-		invariant(tit != m_memory_state_tx.end(), "");
-		desc.fee                     = tit->second.fee;
-		desc.size                    = tit->second.binary_tx.size();
-		desc.newest_referenced_block = tit->second.newest_referenced_block;
+		desc.hash                    = record.tid;
+		desc.fee                     = record.fee;
+		desc.size                    = record.binary_tx.size();
+		desc.newest_referenced_block = record.newest_referenced_block;
 		result.push_back(desc);
 	}
 	return result;
 }
 
-bool BlockChainState::add_transaction(const Hash &tid, const Transaction &tx, const BinaryArray &binary_tx,
-    bool check_sigs, const std::string &source_address) {
-	if (m_memory_state_tx.count(tid) != 0) {
-		m_archive.add(Archive::TRANSACTION, binary_tx, tid, source_address);
-		return false;  // AddTransactionResult::ALREADY_IN_POOL;
-	}
-	const size_t my_size         = binary_tx.size();
+bool BlockChainState::fee_enough_for_pool(const Hash &tid, const Transaction &tx, size_t my_size) const {
 	const Amount my_fee          = cn::get_tx_fee(tx);
 	const Amount my_fee_per_byte = my_fee / my_size;
 	Hash minimal_tid;
 	Amount minimal_fee = minimum_pool_fee_per_byte(false, &minimal_tid);
 	// Invariant is if 1 byte of cheapest transaction fits, then all transaction fits
-	if (m_memory_state_total_size >= m_max_pool_size && my_fee_per_byte < minimal_fee)
+	if (m_tx_pool.get_total_size() >= m_max_pool_size && my_fee_per_byte < minimal_fee)
 		return false;  // AddTransactionResult::INCREASE_FEE;
 	// Deterministic behaviour here and below so tx pools have tendency to stay the same
-	if (m_memory_state_total_size >= m_max_pool_size && my_fee_per_byte == minimal_fee && tid < minimal_tid)
+	if (m_tx_pool.get_total_size() >= m_max_pool_size && my_fee_per_byte == minimal_fee && tid < minimal_tid)
 		return false;  // AddTransactionResult::INCREASE_FEE;
 	for (const auto &input : tx.inputs) {
 		if (const auto *in = boost::get<InputKey>(&input)) {
-			auto tit = m_memory_state_ki_tx.find(in->key_image);
-			if (tit == m_memory_state_ki_tx.end())
+			const Hash *other_tid = m_tx_pool.find_keyimage(in->key_image);
+			if (!other_tid)
 				continue;
-			const PoolTransaction &other_tx = m_memory_state_tx.at(tit->second);
-			const Amount other_fee_per_byte = other_tx.fee_per_byte();
+			const Amount other_fee_per_byte = m_tx_pool.at(*other_tid).fee_per_byte();
 			if (my_fee_per_byte < other_fee_per_byte)
 				return false;  // AddTransactionResult::INCREASE_FEE;
-			if (my_fee_per_byte == other_fee_per_byte && tid < tit->second)
+			if (my_fee_per_byte == other_fee_per_byte && tid < *other_tid)
 				return false;  // AddTransactionResult::INCREASE_FEE;
 			break;  // Can displace another transaction from the pool, Will have to make heavy-lifting for this tx
 		}
 	}
+	return true;
+}
+
+bool BlockChainState::prepare_pool_transaction_check(
+    const Hash &tid, const Transaction &tx, const BinaryArray &binary_tx, PoolCheckerMulticore::Job *job) const {
+	if (m_tx_pool.find(tid) || !fee_enough_for_pool(tid, tx, binary_tx.size()))
+		return false;
+	for (const auto &input : tx.inputs) {
+		if (const auto *in = boost::get<InputKey>(&input)) {
+			Height conflict_height = 0;
+			if (read_keyimage(in->key_image, &conflict_height)) {
+				throw ConsensusErrorOutputSpent("Output already spent", in->key_image, conflict_height);
+			}
+		}
+	}
+	const uint8_t major_version = get_tip().major_version;
+	validate_tx_semantic(m_currency, major_version, false, tx, false, true);  // Keys are checked by job
+	// std::function must be copyable
+	auto args = std::make_shared<const RingSignatureCheckArgs>(fill_ring_check_args(
+	    tx, major_version, get_tip_height() + 1, get_tip().timestamp, get_tip().timestamp_median));
+	auto job_tx                   = std::make_shared<const Transaction>(tx);
+	const Currency *job_currency  = &m_currency;
+	OutputKeyCache *job_key_cache = m_output_key_cache.get();
+
+	*job = [job_currency, job_key_cache, major_version, job_tx, args]() {
+		validate_tx_semantic(*job_currency, major_version, false, *job_tx, true, true);
+		if (!args->check(job_key_cache))
+			throw ConsensusErrorBadOutputOrSignature{
+			    "Bad signature or output reference changed", args->newest_referenced_height};
+	};
+	return true;
+}
+
+bool BlockChainState::add_transaction(const Hash &tid, const Transaction &tx, const BinaryArray &binary_tx,
+    bool check_sigs, const std::string &source_address) {
+	if (m_tx_pool.find(tid)) {
+		m_archive.add(Archive::TRANSACTION, binary_tx, tid, source_address);
+		return false;  // AddTransactionResult::ALREADY_IN_POOL;
+	}
+	const size_t my_size         = binary_tx.size();
+	const Amount my_fee          = cn::get_tx_fee(tx);
+	const Amount my_fee_per_byte = my_fee / my_size;
+	if (!fee_enough_for_pool(tid, tx, my_size))
+		return false;
 	for (const auto &input : tx.inputs) {
 		if (const auto *in = boost::get<InputKey>(&input)) {
 			Height conflict_height = 0;
@@ -749,50 +868,33 @@ bool BlockChainState::add_transaction(const Hash &tid, const Transaction &tx, co
 	// space there
 	//	update_first_seen_timestamp(tid, unlock_timestamp);
 	for (auto &&ki : memory_state.get_keyimages()) {
-		auto tit = m_memory_state_ki_tx.find(ki.first);
-		if (tit == m_memory_state_ki_tx.end())
+		const Hash *other_tid = m_tx_pool.find_keyimage(ki.first);
+		if (!other_tid)
 			continue;
-		const PoolTransaction &other_tx = m_memory_state_tx.at(tit->second);
-		const Amount other_fee_per_byte = other_tx.fee_per_byte();
+		const Amount other_fee_per_byte = m_tx_pool.at(*other_tid).fee_per_byte();
 		if (my_fee_per_byte < other_fee_per_byte)
 			return false;  // AddTransactionResult::INCREASE_FEE;  // Never because checked above
-		if (my_fee_per_byte == other_fee_per_byte && tid < tit->second)
+		if (my_fee_per_byte == other_fee_per_byte && tid < *other_tid)
 			return false;  // AddTransactionResult::INCREASE_FEE;  // Never because checked above
-		remove_from_pool(tit->second);
-	}
-	bool all_inserted = true;
-	for (auto &&ki : memory_state.get_keyimages()) {
-		if (!m_memory_state_ki_tx.insert(std::make_pair(ki.first, tid)).second)
-			all_inserted = false;
+		remove_from_pool(*other_tid);
 	}
 	const auto now = platform::now_unix_timestamp();
-	if (!m_memory_state_tx
-	         .insert(std::make_pair(tid, PoolTransaction{tx, binary_tx, my_fee, now, newest_referenced_bid}))
-	         .second)
-		all_inserted = false;
-	if (!m_memory_state_fee_tx.insert(std::make_pair(my_fee_per_byte, tid)).second)
-		all_inserted = false;
-	// insert all before throw
-	invariant(all_inserted, "memory_state_fee_tx empty");
-	m_memory_state_total_size += my_size;
-	while (m_memory_state_total_size > m_max_pool_size) {
-		invariant(!m_memory_state_fee_tx.empty(), "memory_state_fee_tx empty");
-		//		auto &be = m_memory_state_fee_tx.begin()->second;
-		//		invariant(!be.empty(), "memory_state_fee_tx empty set");
-		Hash rhash                        = m_memory_state_fee_tx.begin()->second;
-		const PoolTransaction &minimal_tx = m_memory_state_tx.at(rhash);
-		if (m_memory_state_total_size < m_max_pool_size + minimal_tx.binary_tx.size())
+	m_tx_pool.insert(tid, tx, binary_tx, my_fee, now, newest_referenced_bid);
+	while (m_tx_pool.get_total_size() > m_max_pool_size) {
+		const Hash rhash                          = m_tx_pool.get_fee_index().begin()->second;
+		const TransactionPool::Record &minimal_tx = m_tx_pool.at(rhash);
+		if (m_tx_pool.get_total_size() < m_max_pool_size + minimal_tx.binary_tx.size())
 			break;  // Removing would diminish pool below max size
 		remove_from_pool(rhash);
 	}
-	auto min_size = m_memory_state_fee_tx.empty()
-	                    ? 0
-	                    : m_memory_state_tx.at(m_memory_state_fee_tx.begin()->second).binary_tx.size();
-	auto min_fee_per_byte = m_memory_state_fee_tx.empty() ? 0 : m_memory_state_fee_tx.begin()->first;
+	const size_t total_size = m_tx_pool.get_total_size();
+	const auto &fee_index   = m_tx_pool.get_fee_index();
+	auto min_size           = fee_index.empty() ? 0 : m_tx_pool.at(fee_index.begin()->second).binary_tx.size();
+	auto min_fee_per_byte   = fee_index.empty() ? 0 : fee_index.begin()->first;
 	m_log(logging::INFO) << "Added transaction with hash=" << tid << " size=" << my_size << " fee=" << my_fee
-	                     << " fee/byte=" << my_fee_per_byte << " current_pool_size=("
-	                     << m_memory_state_total_size - min_size << "+" << min_size << ")=" << m_memory_state_total_size
-	                     << " count=" << m_memory_state_tx.size() << " min fee/byte=" << min_fee_per_byte;
+	                     << " fee/byte=" << my_fee_per_byte << " current_pool_size=(" << total_size - min_size << "+"
+	                     << min_size << ")=" << total_size << " count=" << m_tx_pool.size()
+	                     << " min fee/byte=" << min_fee_per_byte;
 	m_archive.add(Archive::TRANSACTION, binary_tx, tid, source_address);
 	m_tx_pool_version += 1;
 	return true;
@@ -827,35 +929,20 @@ bool BlockChainState::get_largest_referenced_height(const TransactionPrefix &tra
 }
 
 void BlockChainState::remove_from_pool(Hash tid) {
-	auto tit = m_memory_state_tx.find(tid);
-	if (tit == m_memory_state_tx.end())
+	const TransactionPool::Record *record = m_tx_pool.find(tid);
+	if (!record)
 		return;
-	bool all_erased       = true;
-	const Transaction &tx = tit->second.tx;
-	for (const auto &input : tx.inputs) {
-		if (const auto *in = boost::get<InputKey>(&input)) {
-			if (m_memory_state_ki_tx.erase(in->key_image) != 1)
-				all_erased = false;
-		}
-	}
-	const size_t my_size         = tit->second.binary_tx.size();
-	const Amount my_fee_per_byte = tit->second.fee_per_byte();
-	if (m_memory_state_fee_tx.erase(std::make_pair(my_fee_per_byte, tid)) != 1)
-		all_erased = false;
-	//	if (m_memory_state_fee_tx[my_fee_per_byte].empty())
-	//		m_memory_state_fee_tx.erase(my_fee_per_byte);
-	m_memory_state_total_size -= my_size;
-	m_memory_state_tx.erase(tit);
-	invariant(all_erased, "remove_memory_pool failed to erase everything");
+	const size_t my_size = record->binary_tx.size();
+	m_tx_pool.erase(tid);
 	// We do not increment m_tx_pool_version, because removing tx from pool is
 	// always followed by reset or increment
-	auto min_size = m_memory_state_fee_tx.empty()
-	                    ? 0
-	                    : m_memory_state_tx.at(m_memory_state_fee_tx.begin()->second).binary_tx.size();
-	auto min_fee_per_byte = m_memory_state_fee_tx.empty() ? 0 : m_memory_state_fee_tx.begin()->first;
+	const size_t total_size = m_tx_pool.get_total_size();
+	const auto &fee_index   = m_tx_pool.get_fee_index();
+	auto min_size           = fee_index.empty() ? 0 : m_tx_pool.at(fee_index.begin()->second).binary_tx.size();
+	auto min_fee_per_byte   = fee_index.empty() ? 0 : fee_index.begin()->first;
 	m_log(logging::INFO) << "Removed transaction with hash=" << tid << " size=" << my_size << " current_pool_size=("
-	                     << m_memory_state_total_size - min_size << "+" << min_size << ")=" << m_memory_state_total_size
-	                     << " count=" << m_memory_state_tx.size() << " min fee/byte=" << min_fee_per_byte;
+	                     << total_size - min_size << "+" << min_size << ")=" << total_size
+	                     << " count=" << m_tx_pool.size() << " min fee/byte=" << min_fee_per_byte;
 }
 
 // Called only on transactions which passed validate_tx_semantic()
@@ -928,6 +1015,7 @@ void BlockChainState::redo_transaction(uint8_t major_block_version, bool coinbas
 	const bool is_tx_amethyst = transaction.version >= m_currency.amethyst_transaction_version;
 	DeltaState tx_delta(delta_state->get_block_height(), delta_state->get_block_timestamp(),
 	    delta_state->get_block_median_timestamp(), delta_state);
+	tx_delta.reserve(transaction.inputs.size(), transaction.outputs.size());
 	stack_indexes->resize(stack_indexes->size() + 1);
 	auto &my_indexes = stack_indexes->back();
 	my_indexes.reserve(transaction.outputs.size());
@@ -993,23 +1081,40 @@ void BlockChainState::redo_block(const Block &block,
 
 void BlockChainState::redo_block(const Hash &bhash, const Block &block, const api::BlockHeader &info) {
 	DeltaState delta(info.height, info.timestamp, info.timestamp_median, this);
+	size_t keyimage_count = 0, output_count = block.header.base_transaction.outputs.size();
+	for (const auto &tx : block.transactions) {
+		keyimage_count += tx.inputs.size();
+		output_count += tx.outputs.size();
+	}
+	delta.reserve(keyimage_count, output_count);  // Single allocation per vector for the whole block
 	BlockStackIndexes stack_indexes;
 	stack_indexes.reserve(block.transactions.size() + 1);
 	const bool check_sigs = m_config.paranoid_checks || !m_currency.is_in_hard_checkpoint_zone(info.height + 1);
-	if (check_sigs) {
-		m_ring_checker.start_batch();
-		// block.header.base_transaction has no signatures
-		for (const auto &tx : block.transactions)
-			m_ring_checker.add_work(fill_ring_check_args(
-			    tx, block.header.major_version, info.height, info.timestamp, info.timestamp_median));
-	}
-	redo_block(block, info, &delta, &stack_indexes);
-	if (check_sigs) {
-		auto errors = m_ring_checker.move_batch_errors();
+	// Own batch is waited for here or, with signature window, by wait_signature_checks
+	const bool own_batch  = check_sigs && m_deferred_signature_batch == 0;
+	const size_t batch_id = own_batch ? m_ring_checker.start_batch() : m_deferred_signature_batch;
+	try {
+		if (check_sigs) {
+			// block.header.base_transaction has no signatures
+			for (const auto &tx : block.transactions)
+				m_ring_checker.add_work(fill_ring_check_args(
+				    tx, block.header.major_version, info.height, info.timestamp, info.timestamp_median));
+		}
+		redo_block(block, info, &delta, &stack_indexes);
+	} catch (const std::exception &) {
+		if (own_batch)
+			m_ring_checker.cancel_batch(batch_id);
+		throw;
+	}
+	if (own_batch && m_signature_window != 0)
+		m_pending_signature_blocks.push_back(PendingSignatureBlock{bhash, batch_id});
+	else if (own_batch) {
+		auto errors = m_ring_checker.move_batch_errors(batch_id);
 		if (!errors.empty())
 			throw errors.front();  // We report first error only
 	}
 	delta.apply(this);  // Will remove from pool by key_image
+	m_db.write(m_apply_batch);  // Sorted, so B-tree pages are visited in order
 	for (auto tit = block.transactions.begin(); tit != block.transactions.end(); ++tit) {
 		const auto tid = block.header.transaction_hashes.at(tit - block.transactions.begin());
 		for (size_t input_index = 0; input_index != tit->inputs.size(); ++input_index) {
@@ -1018,8 +1123,9 @@ void BlockChainState::redo_block(const Hash &bhash, const Block &block, const ap
 				process_input(tid, input_index, *in);
 		}
 	}
-	auto key =
-	    BLOCK_STACK_INDICES_PREFIX + DB::to_binary_key(bhash.data, sizeof(bhash.data)) + BLOCK_STACK_INDICES_SUFFIX;
+	auto key = DB::Key(BLOCK_STACK_INDICES_PREFIX)
+	               .append(bhash.data, sizeof(bhash.data))
+	               .append(BLOCK_STACK_INDICES_SUFFIX);
 	BinaryArray ba = seria::to_binary(stack_indexes);
 	m_db.put(key, ba, true);
 
@@ -1035,6 +1141,37 @@ void BlockChainState::redo_block(const Hash &bhash, const Block &block, const ap
 	}
 }
 
+void BlockChainState::start_deferred_signature_checks() {
+	m_deferred_signature_batch = m_ring_checker.start_batch();
+}
+
+bool BlockChainState::finish_deferred_signature_checks() {
+	auto errors                = m_ring_checker.move_batch_errors(m_deferred_signature_batch);
+	m_deferred_signature_batch = 0;
+	if (!errors.empty())
+		m_log(logging::WARNING) << "Deferred signature checks failed, count=" << errors.size()
+		                        << " first error=" << common::what(errors.front());
+	return errors.empty();
+}
+
+bool BlockChainState::wait_signature_checks(size_t max_pending, Hash *bad_bid) {
+	while (m_pending_signature_blocks.size() > max_pending) {
+		const PendingSignatureBlock pending = m_pending_signature_blocks.front();
+		m_pending_signature_blocks.pop_front();
+		auto errors = m_ring_checker.move_batch_errors(pending.batch_id);
+		if (errors.empty())
+			continue;
+		m_log(logging::WARNING) << "Signature checks of block " << pending.bid << " failed, count=" << errors.size()
+		                        << " first error=" << common::what(errors.front());
+		for (const auto &other : m_pending_signature_blocks)
+			m_ring_checker.cancel_batch(other.batch_id);
+		m_pending_signature_blocks.clear();
+		*bad_bid = pending.bid;
+		return false;
+	}
+	return true;
+}
+
 void BlockChainState::undo_block(const Hash &bhash, const Block &block, Height height) {
 	auto now = std::chrono::steady_clock::now();
 	if (std::chrono::duration_cast<std::chrono::milliseconds>(now - m_log_redo_block_timestamp).count() > 1000) {
@@ -1051,13 +1188,15 @@ void BlockChainState::undo_block(const Hash &bhash, const Block &block, Height h
 	}
 	undo_transaction(this, height, block.header.base_transaction);
 
-	auto key =
-	    BLOCK_STACK_INDICES_PREFIX + DB::to_binary_key(bhash.data, sizeof(bhash.data)) + BLOCK_STACK_INDICES_SUFFIX;
+	auto key = DB::Key(BLOCK_STACK_INDICES_PREFIX)
+	               .append(bhash.data, sizeof(bhash.data))
+	               .append(BLOCK_STACK_INDICES_SUFFIX);
 	m_db.del(key, true);
 }
 
 bool BlockChainState::read_block_output_stack_indexes_data(const Hash &bid, BinaryArray *rb) const {
-	auto key = BLOCK_STACK_INDICES_PREFIX + DB::to_binary_key(bid.data, sizeof(bid.data)) + BLOCK_STACK_INDICES_SUFFIX;
+	auto key =
+	    DB::Key(BLOCK_STACK_INDICES_PREFIX).append(bid.data, sizeof(bid.data)).append(BLOCK_STACK_INDICES_SUFFIX);
 	return m_db.get(key, *rb);
 }
 
@@ -1092,6 +1231,10 @@ api::cnd::SyncBlocks::RawBlockCompact BlockChainState::fill_sync_block_compact(c
 
 std::vector<api::Output> BlockChainState::get_random_outputs(uint8_t block_major_version, Amount amount,
     size_t output_count, Height confirmed_height, Timestamp block_timestamp, Timestamp block_median_timestamp) const {
+	if (m_config.use_outputs_index)
+		if (const auto *items = get_outputs_index(amount))
+			return get_random_outputs_from_index(*items, block_major_version, amount, output_count, confirmed_height,
+			    block_timestamp, block_median_timestamp);
 	std::vector<api::Output> result;
 	std::vector<api::Output> spent_result;
 	size_t total_stack_count = next_stack_index_for_amount(amount);
@@ -1133,7 +1276,7 @@ std::vector<api::Output> BlockChainState::get_random_outputs(uint8_t block_major
 	if (result.size() < output_count) {
 		// Read the whole index.
 		attempts = 0;
-		for (DB::Cursor cur = m_db.rbegin(AMOUNT_OUTPUT_PREFIX + common::write_varint_sqlite4(amount));
+		for (DB::Cursor cur = m_db.rbegin(DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount));
 		     result.size() < output_count && attempts < 10000 && !cur.end(); cur.next(), ++attempts) {  // TODO - 10000
 			const size_t stack_index = common::integer_cast<size_t>(common::read_varint_sqlite4(cur.get_suffix()));
 			if (tried_or_added.count(stack_index) != 0)
@@ -1162,25 +1305,204 @@ std::vector<api::Output> BlockChainState::get_random_outputs(uint8_t block_major
 	return result;
 }
 
+const AmountOutputsIndex::Items *BlockChainState::get_outputs_index(Amount amount) const {
+	if (const auto *items = m_outputs_index.find(amount))
+		return items;
+	// Large amounts would stall the caller if read at once, so we read next chunk per request
+	const size_t loaded = m_outputs_index.get_loaded_count(amount);
+	AmountOutputsIndex::Items items;
+	DB::Cursor cur = m_db.begin(
+	    DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount), common::write_varint_sqlite4(loaded));
+	for (; !cur.end() && items.size() < OUTPUTS_INDEX_CHUNK; cur.next()) {
+		size_t global_index = 0;
+		seria::from_binary(global_index, cur.get_value_array());
+		OutputIndexData unp;
+		invariant(read_hidden_amount_output(global_index, &unp), "");
+		AmountOutputsIndex::Item item;
+		item.global_index              = global_index;
+		item.unlock_block_or_timestamp = unp.unlock_block_or_timestamp;
+		item.height                    = unp.height;
+		item.spent                     = unp.spent;
+		items.push_back(item);
+	}
+	const bool complete = cur.end();
+	invariant(!complete || loaded + items.size() == next_stack_index_for_amount(amount),
+	    "Outputs index does not match amount map");
+	m_outputs_index.load_chunk(amount, items, complete);
+	return m_outputs_index.find(amount);
+}
+
+// Same selection as DB path below, but only selected outputs are read from DB (for public key)
+std::vector<api::Output> BlockChainState::get_random_outputs_from_index(const AmountOutputsIndex::Items &items,
+    uint8_t block_major_version, Amount amount, size_t output_count, Height confirmed_height,
+    Timestamp block_timestamp, Timestamp block_median_timestamp) const {
+	std::vector<api::Output> result;
+	size_t total_stack_count = items.size();
+	std::unordered_set<size_t> tried_or_added;
+	tried_or_added.reserve(output_count * 20);
+	auto try_add = [&](size_t stack_index) {
+		const auto &it = items[stack_index];
+		if (it.spent || !m_currency.is_transaction_unlocked(block_major_version, it.unlock_block_or_timestamp,
+		                    confirmed_height, block_timestamp, block_median_timestamp))
+			return;  // spent outputs were never returned by DB path either
+		OutputIndexData unp;
+		invariant(read_hidden_amount_output(it.global_index, &unp), "");
+		api::Output item;
+		item.amount                    = amount;
+		item.stack_index               = stack_index;
+		item.global_index              = it.global_index;
+		item.unlock_block_or_timestamp = it.unlock_block_or_timestamp;
+		item.public_key                = unp.public_key;
+		item.height                    = it.height;
+		result.push_back(item);
+	};
+	if (total_stack_count > output_count)  // implicit total_stack_count > 0
+		for (size_t attempts = 0; result.size() < output_count && attempts < output_count * 20; ++attempts) {
+			const size_t num = m_currency.mixin_distribution(amount, total_stack_count);
+			if (!tried_or_added.insert(num).second)
+				continue;
+			if (items[num].height > confirmed_height) {
+				if (confirmed_height + 128 < get_tip_height())
+					total_stack_count = num;  // same heuristic as DB path
+				continue;
+			}
+			try_add(num);
+		}
+	for (size_t attempts = 0, num = items.size(); result.size() < output_count && attempts < 10000 && num-- > 0;
+	     ++attempts) {
+		if (tried_or_added.count(num) == 0 && items[num].height <= confirmed_height)
+			try_add(num);
+	}
+	return result;
+}
+
+void BlockChainState::open_keyimage_filter() {
+	const auto path = m_config.get_data_folder() + "/keyimage_filter";
+	auto filter     = std::make_unique<KeyImageFilter>(0);
+	if (filter->load(path, get_tip_bid())) {
+		m_keyimage_filter = std::move(filter);
+		return;
+	}
+	m_log(logging::INFO) << "Building key image filter...";
+	size_t count = 0;
+	for (DB::Cursor cur = m_db.begin(KEYIMAGE_PREFIX); !cur.end(); cur.next())
+		count += 1;
+	rebuild_keyimage_filter(count * 2);
+	m_log(logging::INFO) << "Building key image filter finished, count=" << m_keyimage_filter->size();
+}
+
+void BlockChainState::rebuild_keyimage_filter(size_t capacity) {
+	m_keyimage_filter.reset();
+	while (!m_keyimage_filter) {
+		auto filter = std::make_unique<KeyImageFilter>(capacity);
+		for (DB::Cursor cur = m_db.begin(KEYIMAGE_PREFIX); !cur.end(); cur.next()) {
+			KeyImage ki;
+			DB::from_binary_key(cur.get_suffix(), 0, ki.data, sizeof(ki.data));
+			if (!filter->insert(ki) || filter->is_overloaded())
+				break;
+		}
+		if (filter->is_overloaded())
+			capacity = std::max<size_t>(capacity, filter->size()) * 2;
+		else
+			m_keyimage_filter = std::move(filter);
+	}
+}
+
+bool BlockChainState::load_next_indexes() {
+	DB::Value value;
+	if (!m_db.get(NEXT_INDEXES_KEY, value) || value.size() < sizeof(Hash::data))
+		return false;
+	if (std::memcmp(value.data(), get_tip_bid().data, sizeof(Hash::data)) != 0)
+		return false;  // Stale, DB was modified by version which does not save snapshot
+	const char *be = value.begin() + sizeof(Hash::data);
+	const char *en = value.end();
+	uint64_t next_global = 0, next_nz = 0, count = 0;
+	if (common::read_varint(be, en, &next_global) < 0 || common::read_varint(be, en, &next_nz) < 0 ||
+	    common::read_varint(be, en, &count) < 0)
+		return false;
+	m_next_stack_index.clear();
+	m_next_stack_index.reserve(static_cast<size_t>(std::min<uint64_t>(count, value.size())));
+	for (uint64_t i = 0; i != count; ++i) {
+		uint64_t amount = 0, next_stack_index = 0;
+		if (common::read_varint(be, en, &amount) < 0 || common::read_varint(be, en, &next_stack_index) < 0)
+			return false;
+		m_next_stack_index[amount] = common::integer_cast<size_t>(next_stack_index);
+	}
+	if (be != en)
+		return false;
+	m_next_global_key_output_index = common::integer_cast<size_t>(next_global);
+	m_next_nz_input_index          = common::integer_cast<size_t>(next_nz);
+	return true;
+}
+
+void BlockChainState::save_next_indexes() {
+	if (!m_next_indexes_loaded)
+		return;  // Blocks added by constructor (genesis, upgrade) before counters were read
+	std::vector<std::pair<Amount, size_t>> sorted(m_next_stack_index.begin(), m_next_stack_index.end());
+	std::sort(sorted.begin(), sorted.end());  // Same content gives same bytes
+	BinaryArray ba(get_tip_bid().data, get_tip_bid().data + sizeof(Hash::data));
+	ba.reserve(ba.size() + 30 + sorted.size() * 16);
+	common::write_varint(std::back_inserter(ba), m_next_global_key_output_index);
+	common::write_varint(std::back_inserter(ba), m_next_nz_input_index);
+	common::write_varint(std::back_inserter(ba), sorted.size());
+	for (const auto &si : sorted) {
+		common::write_varint(std::back_inserter(ba), si.first);
+		common::write_varint(std::back_inserter(ba), si.second);
+	}
+	m_db.put(NEXT_INDEXES_KEY, ba, false);
+}
+
+void BlockChainState::before_db_commit() {
+	save_next_indexes();
+	if (!m_keyimage_filter)
+		return;
+	m_log(logging::INFO) << "BlockChainState::before_db_commit key image filter count=" << m_keyimage_filter->size()
+	                     << " lookups=" << m_keyimage_filter_lookups.load(std::memory_order_relaxed)
+	                     << " skipped=" << m_keyimage_filter_skipped.load(std::memory_order_relaxed)
+	                     << " false_positives=" << m_keyimage_filter_false_positives.load(std::memory_order_relaxed);
+	if (!m_keyimage_filter->save(m_config.get_data_folder() + "/keyimage_filter", get_tip_bid()))
+		m_log(logging::WARNING) << "Failed to save key image filter, it will be rebuilt on next start";
+}
+
 void BlockChainState::store_keyimage(const KeyImage &key_image, Height height) {
-	auto key = KEYIMAGE_PREFIX + DB::to_binary_key(key_image.data, sizeof(key_image.data));
-	m_db.put(key, seria::to_binary(height), true);
-	auto tit = m_memory_state_ki_tx.find(key_image);
-	if (tit == m_memory_state_ki_tx.end())
+	auto key = DB::Key(KEYIMAGE_PREFIX).append(key_image.data, sizeof(key_image.data));
+	m_apply_batch.put(std::string(key), seria::to_binary(height), true);
+	if (m_keyimage_filter && (!m_keyimage_filter->insert(key_image) || m_keyimage_filter->is_overloaded())) {
+		m_db.write(m_apply_batch);  // Filter is rebuilt from DB, which must contain key_image
+		rebuild_keyimage_filter(m_keyimage_filter->size() * 2);
+	}
+	const Hash *tid = m_tx_pool.find_keyimage(key_image);
+	if (!tid)
 		return;
-	remove_from_pool(tit->second);
+	remove_from_pool(*tid);
 }
 
 void BlockChainState::delete_keyimage(const KeyImage &key_image) {
-	auto key = KEYIMAGE_PREFIX + DB::to_binary_key(key_image.data, sizeof(key_image.data));
+	auto key = DB::Key(KEYIMAGE_PREFIX).append(key_image.data, sizeof(key_image.data));
 	m_db.del(key, true);
+	if (m_keyimage_filter)
+		invariant(m_keyimage_filter->erase(key_image), "Key image filter out of sync with DB");
 }
 
 bool BlockChainState::read_keyimage(const KeyImage &key_image, Height *height) const {
-	auto key = KEYIMAGE_PREFIX + DB::to_binary_key(key_image.data, sizeof(key_image.data));
-	BinaryArray rb;
-	if (!m_db.get(key, rb))
+	auto key = DB::Key(KEYIMAGE_PREFIX).append(key_image.data, sizeof(key_image.data));
+	if (m_keyimage_filter) {
+		m_keyimage_filter_lookups.fetch_add(1, std::memory_order_relaxed);
+		if (!m_keyimage_filter->maybe_contains(key_image)) {
+			m_keyimage_filter_skipped.fetch_add(1, std::memory_order_relaxed);
+			if (m_config.paranoid_checks) {
+				DB::Value rb;
+				invariant(!m_db.get(key, rb), "Key image filter false negative");
+			}
+			return false;
+		}
+	}
+	DB::Value rb;
+	if (!m_db.get(key, rb)) {
+		if (m_keyimage_filter)
+			m_keyimage_filter_false_positives.fetch_add(1, std::memory_order_relaxed);
 		return false;
+	}
 	seria::from_binary(*height, rb);
 	return true;
 }
@@ -1192,15 +1514,19 @@ size_t BlockChainState::push_amount_output(
 		m_log(logging::WARNING) << "double-spend " << amount << ":" << my_stack_index << " -> "
 		                        << m_next_global_key_output_index;
 
-	auto key =
-	    AMOUNT_OUTPUT_PREFIX + common::write_varint_sqlite4(amount) + common::write_varint_sqlite4(my_stack_index);
-	BinaryArray ba = seria::to_binary(m_next_global_key_output_index);
-	m_db.put(key, ba, true);
+	// Stack index is cached in m_next_stack_index, so DB is not read for amounts with outputs in batch
+	auto key = DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount).append_varint(my_stack_index);
+	m_apply_batch.put(std::string(key), seria::to_binary(m_next_global_key_output_index), true);
 	m_next_stack_index[amount] += 1;
-
-	key = OUTPUT_PREFIX + common::write_varint_sqlite4(m_next_global_key_output_index);
-	ba  = seria::to_binary(OutputIndexData{amount, unlock_time, pk, block_height, 0, is_amethyst, {}});
-	m_db.put(key, ba, true);
+	AmountOutputsIndex::Item item;
+	item.global_index              = m_next_global_key_output_index;
+	item.unlock_block_or_timestamp = unlock_time;
+	item.height                    = block_height;
+	m_outputs_index.push(amount, item);
+
+	key = DB::Key(OUTPUT_PREFIX).append_varint(m_next_global_key_output_index);
+	m_apply_batch.put(std::string(key),
+	    seria::to_binary(OutputIndexData{amount, unlock_time, pk, block_height, 0, is_amethyst, {}}), true);
 	m_next_global_key_output_index += 1;
 
 	return my_stack_index;
@@ -1214,6 +1540,7 @@ void BlockChainState::pop_amount_output(Amount amount, BlockOrTimestamp unlock_t
 
 	invariant(m_next_global_key_output_index != 0, "BlockChainState::pop_amount_output hidden underflow");
 	m_next_global_key_output_index -= 1;
+	m_outputs_index.pop(amount, m_next_global_key_output_index);
 
 	size_t should_be_global_index = 0;
 	invariant(read_hidden_amount_map(amount, my_stack_index, &should_be_global_index), "");
@@ -1224,10 +1551,9 @@ void BlockChainState::pop_amount_output(Amount amount, BlockOrTimestamp unlock_t
 	invariant(
 	    !unp.spent && unp.amount == amount && unp.unlock_block_or_timestamp == unlock_time && unp.public_key == pk,
 	    "BlockChainState::pop_amount_output popping wrong element");
-	auto key =
-	    AMOUNT_OUTPUT_PREFIX + common::write_varint_sqlite4(amount) + common::write_varint_sqlite4(my_stack_index);
+	auto key = DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount).append_varint(my_stack_index);
 	m_db.del(key, true);
-	key = OUTPUT_PREFIX + common::write_varint_sqlite4(m_next_global_key_output_index);
+	key = DB::Key(OUTPUT_PREFIX).append_varint(m_next_global_key_output_index);
 	m_db.del(key, true);
 }
 
@@ -1235,16 +1561,46 @@ size_t BlockChainState::next_stack_index_for_amount(Amount amount) const {
 	auto it = m_next_stack_index.find(amount);
 	if (it != m_next_stack_index.end())
 		return it->second;
-	std::string prefix = AMOUNT_OUTPUT_PREFIX + common::write_varint_sqlite4(amount);
-	DB::Cursor cur2    = m_db.rbegin(prefix);
+	DB::Cursor cur2 = m_db.rbegin(DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount));
 	size_t alt_in = cur2.end() ? 0 : common::integer_cast<size_t>(common::read_varint_sqlite4(cur2.get_suffix())) + 1;
 	m_next_stack_index[amount] = alt_in;
 	return alt_in;
 }
 
+void BlockChainState::prefetch_block_state(const std::vector<InputKey> &inputs) const {
+	// Only const members here, key image filter and caches are modified by main thread
+	std::vector<std::string> keys;
+	for (const auto &in : inputs) {
+		std::vector<size_t> absolute_indexes;
+		if (!relative_output_offsets_to_absolute(&absolute_indexes, in.output_indexes))
+			continue;  // Block will fail consensus check
+		for (auto stack_index : absolute_indexes)
+			keys.push_back(
+			    std::string(DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(in.amount).append_varint(stack_index)));
+	}
+	const size_t amount_keys_count = keys.size();
+	if (!m_config.use_keyimage_filter)
+		for (const auto &in : inputs)
+			keys.push_back(std::string(DB::Key(KEYIMAGE_PREFIX).append(in.key_image.data, sizeof(in.key_image.data))));
+	std::vector<BinaryArray> values;
+	std::vector<bool> found;
+	if (keys.empty() || !m_db.get_many_committed(keys, &values, &found))
+		return;
+	std::vector<std::string> output_keys;
+	for (size_t i = 0; i != amount_keys_count; ++i) {
+		if (!found.at(i))
+			continue;  // Output from block not yet committed
+		size_t global_index = 0;
+		seria::from_binary(global_index, values.at(i));
+		output_keys.push_back(std::string(DB::Key(OUTPUT_PREFIX).append_varint(global_index)));
+	}
+	if (!output_keys.empty())
+		m_db.get_many_committed(output_keys, &values, &found);
+}
+
 bool BlockChainState::read_hidden_amount_map(Amount amount, size_t stack_index, size_t *hidden_index) const {
-	auto key = AMOUNT_OUTPUT_PREFIX + common::write_varint_sqlite4(amount) + common::write_varint_sqlite4(stack_index);
-	BinaryArray rb;
+	auto key = DB::Key(AMOUNT_OUTPUT_PREFIX).append_varint(amount).append_varint(stack_index);
+	DB::Value rb;
 	if (!m_db.get(key, rb))
 		return false;
 	seria::from_binary(*hidden_index, rb);
@@ -1252,8 +1608,8 @@ bool BlockChainState::read_hidden_amount_map(Amount amount, size_t stack_index,
 }
 
 bool BlockChainState::read_hidden_amount_output(size_t hidden_index, OutputIndexData *unp) const {
-	auto key = OUTPUT_PREFIX + common::write_varint_sqlite4(hidden_index);
-	BinaryArray rb;
+	auto key = DB::Key(OUTPUT_PREFIX).append_varint(hidden_index);
+	DB::Value rb;
 	if (!m_db.get(key, rb))
 		return false;
 	seria::from_binary(*unp, rb);
@@ -1279,7 +1635,7 @@ void BlockChainState::process_input(const Hash &tid, size_t iid, const InputKey
 	if (chain_reaction == 1)
 		return;
 	const auto input_index = m_next_nz_input_index;
-	auto din_key           = DIN_PREFIX + common::write_varint_sqlite4(m_next_nz_input_index);
+	auto din_key           = DB::Key(DIN_PREFIX).append_varint(m_next_nz_input_index);
 	m_next_nz_input_index += 1;
 	std::vector<size_t> absolute_indexes;
 	invariant(relative_output_offsets_to_absolute(&absolute_indexes, input.output_indexes), "");
@@ -1298,7 +1654,7 @@ void BlockChainState::process_input(const Hash &tid, size_t iid, const InputKey
 	if (din.first.size() > 1)
 		for (size_t i = 0; i != din.first.size(); ++i) {
 			unspents[i].dins.push_back(input_index);
-			auto key = OUTPUT_PREFIX + common::write_varint_sqlite4(din.first[i]);
+			auto key = DB::Key(OUTPUT_PREFIX).append_varint(din.first[i]);
 			m_db.put(key, seria::to_binary(unspents[i]), false);
 		}
 	m_db.put(din_key, seria::to_binary(din), true);
@@ -1322,7 +1678,7 @@ void BlockChainState::unprocess_input(const InputKey &input) {
 		return;
 	m_next_nz_input_index -= 1;
 	const auto input_index = m_next_nz_input_index;
-	auto din_key           = DIN_PREFIX + common::write_varint_sqlite4(input_index);
+	auto din_key           = DB::Key(DIN_PREFIX).append_varint(input_index);
 	BinaryArray din_ba;
 	invariant(m_db.get(din_key, din_ba), "");
 	InputDesc din;
@@ -1334,7 +1690,7 @@ void BlockChainState::unprocess_input(const InputKey &input) {
 			invariant(read_hidden_amount_output(hidden_index, &unp), "");
 			invariant(!unp.dins.empty() && unp.dins.back() == input_index, "");
 			unp.dins.pop_back();
-			auto key = OUTPUT_PREFIX + common::write_varint_sqlite4(hidden_index);
+			auto key = DB::Key(OUTPUT_PREFIX).append_varint(hidden_index);
 			m_db.put(key, seria::to_binary(unp), false);
 		}
 	m_db.del(din_key, true);
@@ -1349,7 +1705,7 @@ void BlockChainState::spend_output(
     OutputIndexData &&output, size_t hidden_index, size_t trigger_input_index, size_t level, bool spent) {
 	if (level >= 5)
 		m_log(logging::INFO) << "Sure spent level=" << level << " hi=" << hidden_index;
-	auto key                         = OUTPUT_PREFIX + common::write_varint_sqlite4(hidden_index);
+	auto key                         = DB::Key(OUTPUT_PREFIX).append_varint(hidden_index);
 	bool no_subgroup_check_aftermath = hidden_index == 35654297 || hidden_index == 35655016;
 	if (spent) {
 		invariant(no_subgroup_check_aftermath || output.spent == 0, "");
@@ -1359,6 +1715,7 @@ void BlockChainState::spend_output(
 		output.spent -= 1;
 	}
 	m_db.put(key, seria::to_binary(output), false);
+	m_outputs_index.set_spent(output.amount, hidden_index, output.spent);
 	if (spent && output.spent > 1)
 		return;
 	if (!spent && output.spent > 0)
@@ -1368,7 +1725,7 @@ void BlockChainState::spend_output(
 	for (auto input_index : output.dins) {
 		if (input_index == trigger_input_index)
 			continue;
-		auto din_key = DIN_PREFIX + common::write_varint_sqlite4(input_index);
+		auto din_key = DB::Key(DIN_PREFIX).append_varint(input_index);
 		BinaryArray din_ba;
 		invariant(m_db.get(din_key, din_ba), "");
 		InputDesc din;
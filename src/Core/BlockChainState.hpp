@@ -3,10 +3,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <set>
 #include <unordered_map>
+#include "AmountOutputsIndex.hpp"
 #include "BlockChain.hpp"
+#include "KeyImageFilter.hpp"
 #include "Multicore.hpp"
+#include "TransactionPool.hpp"
 #include "crypto/hash.hpp"
 
 namespace cn {
@@ -51,35 +55,33 @@ public:
 	api::cnd::SyncBlocks::RawBlockCompact fill_sync_block_compact(const Hash &bid) const;
 
 	Amount minimum_pool_fee_per_byte(bool zero_if_not_full, Hash *minimal_tid = nullptr) const;
+	// Reads outputs referenced by transaction and returns job checking its keys and signatures on other thread,
+	// then add_transaction with check_sigs=false can be called if tip did not change. Returns false if
+	// add_transaction would reject transaction without checking signatures. Throws ConsensusError
+	bool prepare_pool_transaction_check(
+	    const Hash &tid, const Transaction &, const BinaryArray &binary_tx, PoolCheckerMulticore::Job *job) const;
 	bool add_transaction(const Hash &tid, const Transaction &, const BinaryArray &binary_tx, bool check_sigs,
 	    const std::string &source_address);
 	bool get_largest_referenced_height(const TransactionPrefix &tx, Height *block_height) const;
 
 	size_t get_tx_pool_version() const { return m_tx_pool_version; }
-	struct PoolTransaction {
-		Transaction tx;
-		BinaryArray binary_tx;
-		Amount amount;
-		Amount fee;
-		Timestamp timestamp;
-		Hash newest_referenced_block;
-
-		PoolTransaction(const Transaction &tx, const BinaryArray &binary_tx, Amount fee, Timestamp timestamp,
-		    const Hash &newest_referenced_block);
-		Amount fee_per_byte() const { return fee / binary_tx.size(); }
-	};
-	typedef std::map<Hash, PoolTransaction> PoolTransMap;
-	const PoolTransMap &get_memory_state_transactions() const { return m_memory_state_tx; }
+	const TransactionPool &get_tx_pool() const { return m_tx_pool; }
+	OutputKeyCache *get_output_key_cache() const { return m_output_key_cache.get(); }  // nullptr if disabled
 	std::vector<TransactionDesc> sync_pool(
 	    const std::pair<Amount, Hash> &from, const std::pair<Amount, Hash> &to, size_t max_count) const;
 
 	void create_mining_block_template(const Hash &, const AccountAddress &, const BinaryArray &extra_nonce,
 	    const Hash &miner_secret, BlockTemplate *, Difficulty *, Height *, size_t *) const;
 	bool add_mined_block(const BinaryArray &raw_block_template, RawBlock *, api::BlockHeader *);
+	// Checks versions, timestamps and PoW of block extending tip, but not its transactions, so that block
+	// can be relayed before add_block. Sets pb->pow_hash, so add_block does not calculate it again
+	bool check_header_for_relay(PreparedBlock *pb) const;
 
 	void dump_outputs_quality(size_t max_count) const;
 
 	void fill_statistics(api::cnd::GetStatistics::Response &res) const override;
+	// Thread-safe, reads committed DB state referenced by inputs, so that redo_block finds pages in cache
+	void prefetch_block_state(const std::vector<InputKey> &inputs) const;
 	std::vector<api::Output> get_mixed_outputs(uint8_t tx_version, size_t input_index, const InputKey &in) const;
 
 protected:
@@ -91,9 +93,12 @@ protected:
 	void undo_block(const Hash &bhash, const Block &, Height) override;
 
 private:
+	// Flat append-only vectors, reserved once per block or transaction. Key images are sorted once
+	// before apply, so that they are written to DB in key order
 	class DeltaState : public IBlockChainState {
-		std::map<KeyImage, Height> m_keyimages;  // sorted to speed up bulk saving to DB
-		std::map<Amount, std::vector<std::tuple<uint64_t, PublicKey, bool>>> m_global_amounts;
+		std::vector<std::pair<KeyImage, Height>> m_keyimages;
+		bool m_keyimages_sorted = true;
+		std::vector<std::pair<Amount, size_t>> m_amount_counts;  // few different amounts per block, linear search
 		std::vector<OutputIndexData> m_ordered_global_amounts;
 		Height m_block_height;  // Every delta state corresponds to some height
 		Timestamp m_block_timestamp;
@@ -109,9 +114,10 @@ private:
 		Height get_block_height() const { return m_block_height; }
 		Height get_block_timestamp() const { return m_block_timestamp; }
 		Height get_block_median_timestamp() const { return m_block_median_timestamp; }
-		void apply(IBlockChainState *parent_state) const;  // Apply modifications to (non-const) parent
-		void clear(Height new_block_height);               // We use it for memory_state
-		const std::map<KeyImage, Height> &get_keyimages() const { return m_keyimages; }
+		void reserve(size_t keyimages, size_t outputs);
+		void apply(IBlockChainState *parent_state);  // Apply modifications to (non-const) parent
+		void clear(Height new_block_height);         // We use it for memory_state
+		const std::vector<std::pair<KeyImage, Height>> &get_keyimages();  // sorted
 
 		void store_keyimage(const KeyImage &, Height) override;
 		void delete_keyimage(const KeyImage &) override;
@@ -127,6 +133,23 @@ private:
 	void delete_keyimage(const KeyImage &) override;
 	bool read_keyimage(const KeyImage &, Height *) const override;
 
+	platform::DBBatch m_apply_batch;  // Filled by DeltaState::apply, written to DB in key order by redo_block
+
+	std::unique_ptr<KeyImageFilter> m_keyimage_filter;  // nullptr if disabled, then every lookup goes to DB
+	// Counted by lookups on worker threads, too, only statistics, so relaxed
+	mutable std::atomic<size_t> m_keyimage_filter_lookups{0};
+	mutable std::atomic<size_t> m_keyimage_filter_skipped{0};  // definite misses, DB not read
+	mutable std::atomic<size_t> m_keyimage_filter_false_positives{0};
+	void open_keyimage_filter();
+	void rebuild_keyimage_filter(size_t capacity);
+	void before_db_commit() override;
+
+	// Next stack index for every amount and other counters are saved at each DB commit, so that
+	// after restart they are loaded at once instead of one cursor seek per amount
+	bool m_next_indexes_loaded = false;  // Set at the end of constructor
+	bool load_next_indexes();
+	void save_next_indexes();
+
 	size_t push_amount_output(Amount, BlockOrTimestamp, Height, const PublicKey &, bool is_amethyst) override;
 	void pop_amount_output(Amount, BlockOrTimestamp, const PublicKey &) override;
 	size_t next_stack_index_for_amount(Amount) const override;
@@ -147,18 +170,42 @@ private:
 	mutable crypto::CryptoNightContext m_hash_crypto_context;
 	mutable std::unordered_map<Amount, size_t> m_next_stack_index;
 	// Read from db on first use, write on modification
+	mutable AmountOutputsIndex m_outputs_index;
+	// Same, but whole amount, only for get_random_outputs. Reads next chunk, nullptr until amount is complete
+	const AmountOutputsIndex::Items *get_outputs_index(Amount) const;
+	std::vector<api::Output> get_random_outputs_from_index(const AmountOutputsIndex::Items &,
+	    uint8_t block_major_version, Amount, size_t output_count, Height, Timestamp block_timestamp,
+	    Timestamp block_median_timestamp) const;
 
 	void remove_from_pool(Hash tid);
+	bool fee_enough_for_pool(const Hash &tid, const Transaction &, size_t size) const;
 
 	size_t m_tx_pool_version = 1;  // Incremented every time pool changes, TODO cycle
-	PoolTransMap m_memory_state_tx;
-	std::map<KeyImage, Hash> m_memory_state_ki_tx;
-	std::set<std::pair<Amount, Hash>> m_memory_state_fee_tx;
-	size_t m_memory_state_total_size = 0;
+	TransactionPool m_tx_pool;
 
 	mutable std::map<Hash, std::pair<BinaryArray, Height>> m_mining_transactions;
 	// We remember them for several blocks
 	void clear_mining_transactions() const;
+
+	// Part of block template not depending on miner address and extra nonce, shared by all getblocktemplate calls
+	struct MiningTemplateCache {
+		Hash parent_bid;  // Hash{} if empty, reset on every tip change
+		api::BlockHeader parent_info;
+		uint8_t major_version           = 0;
+		Difficulty difficulty           = 0;
+		Timestamp next_median_timestamp = 0;
+		size_t max_consensus_txs_size   = 0;  // Before miner tx and extra nonce reserve
+		size_t effective_size_median    = 0;
+
+		size_t tx_pool_version = 0;  // Selection below is valid only for this pool version and max_txs_size
+		size_t max_txs_size    = 0;
+		std::vector<Hash> transaction_hashes;
+		size_t txs_size            = 0;
+		Amount txs_fee             = 0;
+		size_t block_capacity_vote = 0;
+	};
+	mutable MiningTemplateCache m_mining_template;
+	const MiningTemplateCache &get_mining_template(const Hash &parent_bid, size_t extra_nonce_size) const;
 	size_t m_next_global_key_output_index = 0;
 	size_t m_next_nz_input_index          = 0;
 	void process_input(const Hash &tid, size_t iid, const InputKey &input);
@@ -173,8 +220,19 @@ private:
 	Timestamp calculate_next_median_timestamp(const api::BlockHeader &prev_info) const;
 	size_t calculate_next_median_size(const api::BlockHeader &prev_info) const;
 	size_t calculate_next_median_block_capacity_vote(const api::BlockHeader &prev_info) const;
+	Difficulty calculate_next_difficulty(const api::BlockHeader &prev_info, uint8_t major_version) const;
 
+	std::unique_ptr<OutputKeyCache> m_output_key_cache;  // nullptr if disabled, must outlive m_ring_checker
 	RingCheckerMulticore m_ring_checker;
+	size_t m_deferred_signature_batch = 0;  // One batch for all blocks of new branch, 0 if not deferring
+	void start_deferred_signature_checks() override;
+	bool finish_deferred_signature_checks() override;
+	struct PendingSignatureBlock {
+		Hash bid;
+		size_t batch_id;
+	};
+	std::deque<PendingSignatureBlock> m_pending_signature_blocks;  // Applied, but still checked, oldest first
+	bool wait_signature_checks(size_t max_pending, Hash *bad_bid) override;
 	RingSignatureCheckArgs fill_ring_check_args(const Transaction &transaction, uint8_t major_block_version,
 	    Height unlock_height, Timestamp block_timestamp, Timestamp block_median_timestamp) const;
 	std::chrono::steady_clock::time_point m_log_redo_block_timestamp;
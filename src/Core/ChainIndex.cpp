@@ -0,0 +1,157 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "ChainIndex.hpp"
+#include <algorithm>
+#include "common/Invariant.hpp"
+#include "common/Math.hpp"
+#include "common/Varint.hpp"
+
+using namespace cn;
+
+// File starts with header, then records for heights 0, 1, 2... All integers are little-endian.
+// Space for records is reserved in chunks, so that file is not remapped on every push.
+// Mapped pages can be written to disk in any order at any time, so before records below clean count
+// can be overwritten, lowered clean count is written to disk.
+static const char MAGIC[]                 = "armorchi";
+static const uint32_t FORMAT_VERSION      = 2;
+static const size_t HEADER_SIZE           = 64;
+static const size_t RECORD_SIZE           = 128;
+static const size_t RESERVE_RECORDS_CHUNK = 16 * 1024;
+
+static const size_t MAGIC_OFFSET = 0, VERSION_OFFSET = 8, RECORD_SIZE_OFFSET = 12, COUNT_OFFSET = 16,
+                    CLEAN_COUNT_OFFSET = 24;
+
+static const size_t BID_OFFSET = 0, CD_LO_OFFSET = 32, CD_HI_OFFSET = 40, DIFFICULTY_OFFSET = 48, REWARD_OFFSET = 56,
+                    AGC_OFFSET = 64, AGT_OFFSET = 72, TIMESTAMP_OFFSET = 80, TIMESTAMP_MAX_OFFSET = 84,
+                    BLOCK_SIZE_OFFSET = 88, TRANSACTIONS_SIZE_OFFSET = 92, CAPACITY_VOTE_OFFSET = 96,
+                    MAJOR_VERSION_OFFSET = 100, MINOR_VERSION_OFFSET = 101;
+
+ChainRecord::ChainRecord(const api::BlockHeader &header, Timestamp previous_timestamp_max)
+    : bid(header.hash)
+    , height(header.height)
+    , major_version(header.major_version)
+    , minor_version(header.minor_version)
+    , timestamp(header.timestamp)
+    , timestamp_max(std::max(header.timestamp, previous_timestamp_max))
+    , cumulative_difficulty(header.cumulative_difficulty)
+    , difficulty(header.difficulty)
+    , reward(header.reward)
+    , already_generated_coins(header.already_generated_coins)
+    , already_generated_transactions(header.already_generated_transactions)
+    , block_size(common::integer_cast<uint32_t>(header.block_size))
+    , transactions_size(common::integer_cast<uint32_t>(header.transactions_size))
+    , block_capacity_vote(common::integer_cast<uint32_t>(header.block_capacity_vote)) {}
+
+ChainIndex::ChainIndex(const std::string &path) : m_file(path, platform::O_OPEN_ALWAYS) {
+	const unsigned char *da = m_file.data();
+	if (m_file.size() >= HEADER_SIZE && std::equal(MAGIC, MAGIC + 8, da + MAGIC_OFFSET) &&
+	    common::uint_le_from_bytes<uint32_t>(da + VERSION_OFFSET, 4) == FORMAT_VERSION &&
+	    common::uint_le_from_bytes<uint32_t>(da + RECORD_SIZE_OFFSET, 4) == RECORD_SIZE) {
+		const uint64_t count       = common::uint_le_from_bytes<uint64_t>(da + COUNT_OFFSET, 8);
+		const uint64_t clean_count = common::uint_le_from_bytes<uint64_t>(da + CLEAN_COUNT_OFFSET, 8);
+		const uint64_t max_count   = (m_file.size() - HEADER_SIZE) / RECORD_SIZE;
+		m_count                    = static_cast<Height>(std::min(std::min(count, clean_count), max_count));
+		m_clean_count              = m_count;
+		return;
+	}
+	m_file.resize(0);  // Unknown format, will be rebuilt by BlockChain
+	m_file.resize(HEADER_SIZE + RECORD_SIZE * RESERVE_RECORDS_CHUNK);
+	unsigned char *wda = m_file.data();
+	std::copy(MAGIC, MAGIC + 8, wda + MAGIC_OFFSET);
+	common::uint_le_to_bytes<uint32_t>(wda + VERSION_OFFSET, 4, FORMAT_VERSION);
+	common::uint_le_to_bytes<uint32_t>(wda + RECORD_SIZE_OFFSET, 4, RECORD_SIZE);
+	write_counts();
+}
+
+const unsigned char *ChainIndex::record_data(Height height) const {
+	invariant(height < m_count, "ChainIndex height out of range");
+	return m_file.data() + HEADER_SIZE + RECORD_SIZE * height;
+}
+
+Hash ChainIndex::get_bid(Height height) const {
+	Hash result;
+	const unsigned char *da = record_data(height) + BID_OFFSET;
+	std::copy(da, da + sizeof(result.data), result.data);
+	return result;
+}
+
+ChainRecord ChainIndex::get(Height height) const {
+	const unsigned char *da = record_data(height);
+	ChainRecord result;
+	std::copy(da + BID_OFFSET, da + BID_OFFSET + sizeof(result.bid.data), result.bid.data);
+	result.height                         = height;
+	result.major_version                  = da[MAJOR_VERSION_OFFSET];
+	result.minor_version                  = da[MINOR_VERSION_OFFSET];
+	result.timestamp                      = common::uint_le_from_bytes<Timestamp>(da + TIMESTAMP_OFFSET, 4);
+	result.timestamp_max                  = common::uint_le_from_bytes<Timestamp>(da + TIMESTAMP_MAX_OFFSET, 4);
+	result.cumulative_difficulty.lo       = common::uint_le_from_bytes<uint64_t>(da + CD_LO_OFFSET, 8);
+	result.cumulative_difficulty.hi       = common::uint_le_from_bytes<uint64_t>(da + CD_HI_OFFSET, 8);
+	result.difficulty                     = common::uint_le_from_bytes<Difficulty>(da + DIFFICULTY_OFFSET, 8);
+	result.reward                         = common::uint_le_from_bytes<Amount>(da + REWARD_OFFSET, 8);
+	result.already_generated_coins        = common::uint_le_from_bytes<Amount>(da + AGC_OFFSET, 8);
+	result.already_generated_transactions = common::uint_le_from_bytes<uint64_t>(da + AGT_OFFSET, 8);
+	result.block_size                     = common::uint_le_from_bytes<uint32_t>(da + BLOCK_SIZE_OFFSET, 4);
+	result.transactions_size              = common::uint_le_from_bytes<uint32_t>(da + TRANSACTIONS_SIZE_OFFSET, 4);
+	result.block_capacity_vote            = common::uint_le_from_bytes<uint32_t>(da + CAPACITY_VOTE_OFFSET, 4);
+	return result;
+}
+
+void ChainIndex::push(const api::BlockHeader &header) {
+	invariant(header.height == m_count, "ChainIndex push of wrong height");
+	const ChainRecord rec(header, m_count == 0 ? 0 : get(m_count - 1).timestamp_max);
+	if (HEADER_SIZE + RECORD_SIZE * (uint64_t(m_count) + 1) > m_file.size())
+		m_file.resize(HEADER_SIZE + RECORD_SIZE * (uint64_t(m_count) + RESERVE_RECORDS_CHUNK));
+	unsigned char *da = m_file.data() + HEADER_SIZE + RECORD_SIZE * m_count;
+	std::fill(da, da + RECORD_SIZE, 0);
+	std::copy(rec.bid.data, rec.bid.data + sizeof(rec.bid.data), da + BID_OFFSET);
+	da[MAJOR_VERSION_OFFSET] = rec.major_version;
+	da[MINOR_VERSION_OFFSET] = rec.minor_version;
+	common::uint_le_to_bytes<Timestamp>(da + TIMESTAMP_OFFSET, 4, rec.timestamp);
+	common::uint_le_to_bytes<Timestamp>(da + TIMESTAMP_MAX_OFFSET, 4, rec.timestamp_max);
+	common::uint_le_to_bytes<uint64_t>(da + CD_LO_OFFSET, 8, rec.cumulative_difficulty.lo);
+	common::uint_le_to_bytes<uint64_t>(da + CD_HI_OFFSET, 8, rec.cumulative_difficulty.hi);
+	common::uint_le_to_bytes<Difficulty>(da + DIFFICULTY_OFFSET, 8, rec.difficulty);
+	common::uint_le_to_bytes<Amount>(da + REWARD_OFFSET, 8, rec.reward);
+	common::uint_le_to_bytes<Amount>(da + AGC_OFFSET, 8, rec.already_generated_coins);
+	common::uint_le_to_bytes<uint64_t>(da + AGT_OFFSET, 8, rec.already_generated_transactions);
+	common::uint_le_to_bytes<uint32_t>(da + BLOCK_SIZE_OFFSET, 4, rec.block_size);
+	common::uint_le_to_bytes<uint32_t>(da + TRANSACTIONS_SIZE_OFFSET, 4, rec.transactions_size);
+	common::uint_le_to_bytes<uint32_t>(da + CAPACITY_VOTE_OFFSET, 4, rec.block_capacity_vote);
+	m_count += 1;
+	write_counts();
+}
+
+void ChainIndex::truncate(Height count) {
+	invariant(count <= m_count, "ChainIndex truncate beyond size");
+	m_count = count;
+	if (count < m_clean_count) {  // Records from count will be overwritten by push
+		m_clean_count = count;
+		write_counts();
+		m_file.flush_front(HEADER_SIZE);
+		return;
+	}
+	write_counts();
+}
+
+void ChainIndex::set_committed() {
+	m_clean_count = m_count;
+	write_counts();  // Not flushed, lower value on disk only causes more records rebuilt from DB
+}
+
+Height ChainIndex::get_timestamp_lower_bound_height(Timestamp ts) const {
+	Height left = 0, right = m_count;  // timestamp_max is non-decreasing, so binary search works
+	while (left < right) {
+		Height middle = left + (right - left) / 2;
+		if (common::uint_le_from_bytes<Timestamp>(record_data(middle) + TIMESTAMP_MAX_OFFSET, 4) < ts)
+			left = middle + 1;
+		else
+			right = middle;
+	}
+	return left;
+}
+
+void ChainIndex::write_counts() {
+	common::uint_le_to_bytes<uint64_t>(m_file.data() + COUNT_OFFSET, 8, m_count);
+	common::uint_le_to_bytes<uint64_t>(m_file.data() + CLEAN_COUNT_OFFSET, 8, m_clean_count);
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include "Difficulty.hpp"
+#include "platform/Files.hpp"
+#include "rpc_api.hpp"
+
+namespace cn {
+
+// Part of header used in block window calculations and lookups by height
+struct ChainRecord {
+	Hash bid;
+	Height height         = 0;
+	uint8_t major_version = 0;
+	uint8_t minor_version = 0;
+	Timestamp timestamp   = 0;
+	Timestamp timestamp_max = 0;  // of this and all previous blocks, non-decreasing with height
+	CumulativeDifficulty cumulative_difficulty{};
+	Difficulty difficulty                   = 0;
+	Amount reward                           = 0;
+	Amount already_generated_coins          = 0;
+	uint64_t already_generated_transactions = 0;
+	uint32_t block_size                     = 0;
+	uint32_t transactions_size              = 0;
+	uint32_t block_capacity_vote            = 0;
+
+	ChainRecord() = default;
+	explicit ChainRecord(const api::BlockHeader &header, Timestamp previous_timestamp_max = 0);
+};
+
+// Main chain as file with fixed-size record per height, so lookups by height need no DB access.
+// File is not in DB transaction. Records below clean count match DB as of last commit, on open index is
+// truncated to it and BlockChain rebuilds the rest from DB
+class ChainIndex : private common::Nocopy {
+public:
+	explicit ChainIndex(const std::string &path);
+	Height size() const { return m_count; }
+	Hash get_bid(Height height) const;
+	ChainRecord get(Height height) const;
+	void push(const api::BlockHeader &header);
+	void pop() { truncate(m_count - 1); }
+	void truncate(Height count);
+	Height get_timestamp_lower_bound_height(Timestamp ts) const;  // first height with timestamp >= ts
+	void flush() { m_file.flush(); }  // before DB commit
+	void set_committed();             // after DB commit
+
+private:
+	platform::MappedFile m_file;
+	Height m_count       = 0;
+	Height m_clean_count = 0;
+	const unsigned char *record_data(Height height) const;
+	void write_counts();
+};
+
+}  // namespace cn
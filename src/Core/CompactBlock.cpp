@@ -0,0 +1,83 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "CompactBlock.hpp"
+#include "CryptoNoteTools.hpp"
+#include "common/Invariant.hpp"
+#include "seria/BinaryInputStream.hpp"
+#include "seria/BinaryOutputStream.hpp"
+
+using namespace cn;
+
+p2p::RelayCompactBlock::Notify cn::make_compact_block(const BinaryArray &block, const Hash &bid, Height height) {
+	BlockTemplate header;
+	seria::from_binary(header, block);
+	p2p::RelayCompactBlock::Notify msg;
+	msg.salt                      = crypto::rand<uint64_t>();
+	msg.top_id                    = bid;
+	msg.current_blockchain_height = height;
+	const Hash key                = msg.get_short_id_key();
+	msg.short_ids.reserve(header.transaction_hashes.size());
+	for (const auto &tid : header.transaction_hashes)
+		msg.short_ids.push_back(p2p::RelayCompactBlock::Notify::get_short_id(key, tid));
+	header.transaction_hashes.clear();
+	msg.header = seria::to_binary(header);
+	return msg;
+}
+
+ShortIdMap::ShortIdMap(const TransactionPool &pool, const Hash &short_id_key) {
+	m_records.reserve(pool.size());
+	for (const auto &fit : pool.get_fee_index())
+		insert(p2p::RelayCompactBlock::Notify::get_short_id(short_id_key, fit.second), &pool.at(fit.second));
+}
+
+void ShortIdMap::insert(uint64_t short_id, const TransactionPool::Record *record) {
+	auto pit = m_records.insert(std::make_pair(short_id, record));
+	if (!pit.second)
+		pit.first->second = nullptr;
+}
+
+const TransactionPool::Record *ShortIdMap::find(uint64_t short_id) const {
+	auto pit = m_records.find(short_id);
+	return pit == m_records.end() ? nullptr : pit->second;
+}
+
+void CompactBlockReconstruction::fill(const ShortIdMap &pool_by_short_id) {
+	invariant(header.transaction_hashes.empty(), "");
+	header.transaction_hashes.resize(msg.short_ids.size());
+	transactions.resize(msg.short_ids.size());
+	missing.clear();
+	for (size_t i = 0; i != msg.short_ids.size(); ++i) {
+		const TransactionPool::Record *record = pool_by_short_id.find(msg.short_ids[i]);
+		if (!record) {
+			missing.push_back(static_cast<uint32_t>(i));
+			continue;
+		}
+		header.transaction_hashes[i] = record->tid;
+		transactions[i]              = record->binary_tx;
+	}
+}
+
+bool CompactBlockReconstruction::add_missing(std::vector<BinaryArray> &&missing_transactions) {
+	invariant(missing_transactions.size() == missing.size(), "");
+	const Hash key = msg.get_short_id_key();
+	for (size_t i = 0; i != missing.size(); ++i) {
+		const size_t index = missing[i];
+		Transaction tx;
+		seria::from_binary(tx, missing_transactions[i]);
+		const Hash tid = get_transaction_hash(tx);
+		if (p2p::RelayCompactBlock::Notify::get_short_id(key, tid) != msg.short_ids.at(index))
+			return false;
+		header.transaction_hashes.at(index) = tid;
+		transactions.at(index)              = std::move(missing_transactions[i]);
+	}
+	missing.clear();
+	return true;
+}
+
+RawBlock CompactBlockReconstruction::move_raw_block() {
+	RawBlock rb;
+	rb.block        = seria::to_binary(header);
+	rb.transactions = std::move(transactions);
+	return rb;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "TransactionPool.hpp"
+#include "p2p/P2pProtocolDefinitions.hpp"
+
+namespace cn {
+
+// Header without transaction hashes, plus short ids of transactions, salted with random number
+p2p::RelayCompactBlock::Notify make_compact_block(const BinaryArray &block, const Hash &bid, Height height);
+
+// Pool transactions by short id of compact block. Ambiguous short ids are requested like missing ones
+class ShortIdMap {
+public:
+	ShortIdMap() = default;
+	ShortIdMap(const TransactionPool &pool, const Hash &short_id_key);
+	void insert(uint64_t short_id, const TransactionPool::Record *record);
+	const TransactionPool::Record *find(uint64_t short_id) const;  // nullptr if not found or ambiguous
+
+private:
+	std::unordered_map<uint64_t, const TransactionPool::Record *> m_records;
+};
+
+struct CompactBlockReconstruction {
+	p2p::RelayCompactBlock::Notify msg;     // msg.top_id is zero if not waiting for transactions
+	BlockTemplate header;                   // hashes of missing transactions are zero
+	std::vector<BinaryArray> transactions;  // missing transactions are empty
+	std::vector<uint32_t> missing;          // requested with GetBlockTransactions
+
+	void fill(const ShortIdMap &pool_by_short_id);  // header must be parsed from msg
+	// transactions in order of missing, false if any does not match its short id
+	bool add_missing(std::vector<BinaryArray> &&missing_transactions);
+	RawBlock move_raw_block();
+};
+
+}  // namespace cn
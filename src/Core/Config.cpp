@@ -99,6 +99,10 @@ Config::Config(common::CommandLine &cmd)
 	}
 	if (const char *pa = cmd.get("--p2p-external-port"))
 		p2p_external_port = common::integer_cast<uint16_t>(pa);
+	if (const char *pa = cmd.get("--p2p-upload-limit"))
+		p2p_upload_limit = common::integer_cast<size_t>(pa) * 1024;
+	if (const char *pa = cmd.get("--p2p-peer-upload-limit"))
+		p2p_peer_upload_limit = common::integer_cast<size_t>(pa) * 1024;
 	if (const char *pa = cmd.get("--walletd-bind-address")) {
 		ewrap(common::parse_ip_address_and_port(pa, &walletd_bind_ip, &walletd_bind_port),
 		    ConfigError("Command line option --walletd-bind-address has wrong format"));
@@ -142,6 +146,9 @@ Config::Config(common::CommandLine &cmd)
 			    ConfigError(emsg));
 		}
 	}
+	if (const char *pa = cmd.get("--worker-threads"))
+		worker_threads = common::integer_cast<size_t>(pa);
+	worker_threads_affinity = cmd.get_bool("--worker-threads-affinity");
 	cmd.get_bool("--allow-local-ip", "Local IPs are automatically allowed for peers from the same private network");
 	parse_peer_and_add_to_container(cmd, seed_nodes, "--seed-node-address");
 	parse_peer_and_add_to_container(cmd, seed_nodes, "--seed-node", "Use --seed-node-address instead");
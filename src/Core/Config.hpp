@@ -63,6 +63,26 @@ public:
 	size_t max_pool_size              = 4 * 1000 * 1000;
 	size_t max_undo_transactions_size = 200 * 1000 * 1000;
 	// During very large reorganization, only last transaction within limit will be redone
+	size_t max_header_cache_size = 64 * 1000 * 1000;
+	// Approximate memory used by block headers cache, least recently used headers are evicted
+	bool use_chain_index_file = true;
+	// Main chain is also kept in file with fixed-size record per height for lookups without DB access
+	bool use_keyimage_filter = true;
+	// Spent key images are also kept in memory filter, so that checks of unspent ones skip DB
+	bool prefetch_block_state = true;
+	// Outputs referenced by downloaded blocks are read on worker threads, so that DB pages are in cache when needed
+	bool use_outputs_index = true;
+	// get_random_outputs samples from in-memory index of amount, loaded in chunks by requests for that amount
+	bool compact_tx_pool = false;
+	// Pool keeps only binary transactions and parses them on demand, using much less memory per transaction
+	size_t signature_check_window = 16;
+	// During download, ring signatures of that many last blocks are checked while next blocks are applied
+	size_t output_key_cache_size = 64 * 1000 * 1000;
+	// Approximate memory used by output keys prepared for ring signature checks, 0 disables cache
+	size_t worker_threads = 0;
+	// Threads preparing downloaded blocks, 0 means 3/4 of hardware threads. A third as many check pool transactions
+	bool worker_threads_affinity = false;
+	// Each of those threads is pinned to its own CPU, so caches stay warm during long sync
 
 	Timestamp db_commit_period_wallet_cache = 111;
 	Timestamp db_commit_period_blockchain   = 311;
@@ -95,6 +115,16 @@ public:
 	Timestamp p2p_no_incoming_message_disconnect_timeout   = 60 * 6;
 	Timestamp p2p_no_outgoing_message_ping_timeout         = 60 * 4;
 
+	size_t p2p_upload_limit      = 0;
+	size_t p2p_peer_upload_limit = 0;
+	// bytes per second, 0 for no limit. Relays always go before blocks served to syncing peers
+
+	float p2p_transaction_trickle_period = 0.5f;
+	size_t p2p_known_transactions_limit  = 20000;
+	// Transactions are announced to each peer in batches at random intervals averaging trickle period,
+	// except those peer sent us or we already announced to it, of which we remember up to limit
+	// in Bloom filter of 2 bytes per transaction (40 KB per peer for default limit)
+
 	size_t rpc_sync_blocks_max_count;
 	size_t rpc_sync_blocks_max_size;
 
@@ -113,6 +143,12 @@ public:
 	// During download, we send time sync commands periodically to inform other that
 	// they can now download more blocks from us
 
+	size_t download_peer_window_min    = 256 * 1024;
+	size_t download_peer_window_max    = 32 * 1024 * 1024;
+	float download_peer_target_latency = 5.0f;  // seconds
+	// Peers with batched GetObjects get requests limited by window in bytes instead of block count. Window grows
+	// while blocks arrive faster than target latency, and is halved when they arrive slower
+
 	Timestamp wallet_sync_timestamp_granularity = 86400 * 30;
 	// Sending exact timestamp of wallet to public node allows tracking
 	size_t wallet_sync_preparator_queue_size = 10 * 1024 * 1024;
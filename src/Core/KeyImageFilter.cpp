@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "KeyImageFilter.hpp"
+#include <algorithm>
+#include "common/Varint.hpp"
+#include "platform/PathTools.hpp"
+
+using namespace cn;
+
+static const char MAGIC[]            = "armorkif";
+static const uint32_t FORMAT_VERSION = 1;
+static const size_t HEADER_SIZE      = 8 + 4 + 32 + 8 + 8;  // magic, version, tip_bid, bucket count, count
+static const size_t MIN_BUCKETS      = 1024;
+static const size_t MAX_KICKS        = 500;
+
+// Key images are points in compressed form, so their bytes are already uniformly distributed
+static uint64_t index_bits(const KeyImage &ki) { return common::uint_le_from_bytes<uint64_t>(ki.data, 8); }
+static uint16_t fingerprint_bits(const KeyImage &ki) {
+	const uint16_t fp = common::uint_le_from_bytes<uint16_t>(ki.data + 8, 2);
+	return fp == 0 ? 1 : fp;
+}
+
+KeyImageFilter::KeyImageFilter(size_t capacity) {
+	size_t bucket_count = MIN_BUCKETS;
+	while (bucket_count * BUCKET_SIZE * 15 / 16 < capacity)
+		bucket_count *= 2;
+	init(bucket_count);
+}
+
+void KeyImageFilter::init(size_t bucket_count) {
+	m_buckets.assign(bucket_count * BUCKET_SIZE, 0);
+	m_mask         = bucket_count - 1;
+	m_count        = 0;
+	m_victim       = 0;
+	m_victim_index = 0;
+}
+
+size_t KeyImageFilter::alt_index(size_t index, Fingerprint fp) const {
+	return (index ^ (size_t(fp) * 0x5bd1e995)) & m_mask;
+}
+
+bool KeyImageFilter::insert_into_bucket(size_t index, Fingerprint fp) {
+	Fingerprint *bucket = m_buckets.data() + index * BUCKET_SIZE;
+	for (size_t i = 0; i != BUCKET_SIZE; ++i)
+		if (bucket[i] == 0) {
+			bucket[i] = fp;
+			return true;
+		}
+	return false;
+}
+
+bool KeyImageFilter::erase_from_bucket(size_t index, Fingerprint fp) {
+	Fingerprint *bucket = m_buckets.data() + index * BUCKET_SIZE;
+	for (size_t i = 0; i != BUCKET_SIZE; ++i)
+		if (bucket[i] == fp) {
+			bucket[i] = 0;
+			return true;
+		}
+	return false;
+}
+
+bool KeyImageFilter::bucket_contains(size_t index, Fingerprint fp) const {
+	const Fingerprint *bucket = m_buckets.data() + index * BUCKET_SIZE;
+	for (size_t i = 0; i != BUCKET_SIZE; ++i)
+		if (bucket[i] == fp)
+			return true;
+	return false;
+}
+
+bool KeyImageFilter::insert(const KeyImage &ki) {
+	if (m_victim != 0)
+		return false;  // Previous insert already failed to place fingerprint
+	Fingerprint fp     = fingerprint_bits(ki);
+	const size_t index = index_bits(ki) & m_mask;
+	m_count += 1;
+	if (insert_into_bucket(index, fp) || insert_into_bucket(alt_index(index, fp), fp))
+		return true;
+	size_t kick_index = (m_kick_counter & 1) == 0 ? index : alt_index(index, fp);
+	for (size_t kick = 0; kick != MAX_KICKS; ++kick) {
+		// Counter instead of random, we need determinism, not uniformity
+		std::swap(fp, m_buckets.at(kick_index * BUCKET_SIZE + (m_kick_counter++ % BUCKET_SIZE)));
+		kick_index = alt_index(kick_index, fp);
+		if (insert_into_bucket(kick_index, fp))
+			return true;
+	}
+	m_victim       = fp;  // Still in filter, so no false negatives
+	m_victim_index = kick_index;
+	return true;
+}
+
+bool KeyImageFilter::erase(const KeyImage &ki) {
+	const Fingerprint fp = fingerprint_bits(ki);
+	const size_t index   = index_bits(ki) & m_mask;
+	const size_t index2  = alt_index(index, fp);
+	if (m_victim == fp && (m_victim_index == index || m_victim_index == index2)) {
+		m_victim = 0;
+		m_count -= 1;
+		return true;
+	}
+	if (!erase_from_bucket(index, fp) && !erase_from_bucket(index2, fp))
+		return false;
+	m_count -= 1;
+	if (m_victim != 0 && (insert_into_bucket(m_victim_index, m_victim) ||
+	                         insert_into_bucket(alt_index(m_victim_index, m_victim), m_victim)))
+		m_victim = 0;
+	return true;
+}
+
+bool KeyImageFilter::maybe_contains(const KeyImage &ki) const {
+	const Fingerprint fp = fingerprint_bits(ki);
+	const size_t index   = index_bits(ki) & m_mask;
+	const size_t index2  = alt_index(index, fp);
+	if (m_victim == fp && (m_victim_index == index || m_victim_index == index2))
+		return true;
+	return bucket_contains(index, fp) || bucket_contains(index2, fp);
+}
+
+bool KeyImageFilter::load(const std::string &path, const Hash &tip_bid) {
+	common::BinaryArray data;
+	if (!platform::load_file(path, data) || data.size() < HEADER_SIZE)
+		return false;
+	const uint8_t *da = data.data();
+	if (!std::equal(MAGIC, MAGIC + 8, da) || common::uint_le_from_bytes<uint32_t>(da + 8, 4) != FORMAT_VERSION ||
+	    !std::equal(tip_bid.data, tip_bid.data + sizeof(tip_bid.data), da + 12))
+		return false;
+	const uint64_t bucket_count = common::uint_le_from_bytes<uint64_t>(da + 44, 8);
+	const uint64_t count        = common::uint_le_from_bytes<uint64_t>(da + 52, 8);
+	if (bucket_count < MIN_BUCKETS || (bucket_count & (bucket_count - 1)) != 0 ||
+	    data.size() != HEADER_SIZE + bucket_count * BUCKET_SIZE * sizeof(Fingerprint))
+		return false;
+	init(static_cast<size_t>(bucket_count));
+	m_count = static_cast<size_t>(count);
+	da += HEADER_SIZE;
+	for (size_t i = 0; i != m_buckets.size(); ++i, da += sizeof(Fingerprint))
+		m_buckets[i] = common::uint_le_from_bytes<Fingerprint>(da, sizeof(Fingerprint));
+	return true;
+}
+
+bool KeyImageFilter::save(const std::string &path, const Hash &tip_bid) const {
+	if (m_victim != 0)
+		return false;  // Will be rebuilt from DB on next start
+	common::BinaryArray data(HEADER_SIZE + m_buckets.size() * sizeof(Fingerprint));
+	uint8_t *da = data.data();
+	std::copy(MAGIC, MAGIC + 8, da);
+	common::uint_le_to_bytes<uint32_t>(da + 8, 4, FORMAT_VERSION);
+	std::copy(tip_bid.data, tip_bid.data + sizeof(tip_bid.data), da + 12);
+	common::uint_le_to_bytes<uint64_t>(da + 44, 8, m_mask + 1);
+	common::uint_le_to_bytes<uint64_t>(da + 52, 8, m_count);
+	da += HEADER_SIZE;
+	for (size_t i = 0; i != m_buckets.size(); ++i, da += sizeof(Fingerprint))
+		common::uint_le_to_bytes<Fingerprint>(da, sizeof(Fingerprint), m_buckets[i]);
+	return platform::atomic_save_file(path, data.data(), data.size(), path + ".tmp");
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <vector>
+#include "CryptoNote.hpp"
+
+namespace cn {
+
+// Cuckoo filter of spent key images, so that lookups of unspent ones (almost all) do not touch DB.
+// Never gives false negatives, false positive rate is about 2 * BUCKET_SIZE / 65536.
+// Unlike Bloom filter supports erase, which we need to undo blocks
+class KeyImageFilter {
+public:
+	enum { BUCKET_SIZE = 4 };
+	explicit KeyImageFilter(size_t capacity);
+
+	bool insert(const KeyImage &ki);  // false if full, filter should be rebuilt when is_overloaded()
+	bool erase(const KeyImage &ki);   // false if not found, should not happen for inserted key images
+	bool maybe_contains(const KeyImage &ki) const;
+
+	size_t size() const { return m_count; }
+	size_t get_capacity() const { return m_buckets.size(); }
+	size_t get_memory_size() const { return m_buckets.size() * sizeof(Fingerprint); }
+	bool is_overloaded() const { return m_victim != 0 || m_count > get_capacity() * 15 / 16; }
+
+	// File is valid only for DB state with the same tip, otherwise filter must be rebuilt from DB
+	bool load(const std::string &path, const Hash &tip_bid);
+	bool save(const std::string &path, const Hash &tip_bid) const;
+
+private:
+	typedef uint16_t Fingerprint;  // 0 means empty slot
+	std::vector<Fingerprint> m_buckets;
+	size_t m_mask         = 0;  // bucket count - 1, bucket count is power of 2
+	size_t m_count        = 0;
+	Fingerprint m_victim  = 0;  // kicked out by insert and not placed into any bucket
+	size_t m_victim_index = 0;
+	size_t m_kick_counter = 0;
+
+	void init(size_t bucket_count);
+	size_t alt_index(size_t index, Fingerprint fp) const;
+	bool insert_into_bucket(size_t index, Fingerprint fp);
+	bool erase_from_bucket(size_t index, Fingerprint fp);
+	bool bucket_contains(size_t index, Fingerprint fp) const;
+};
+
+}  // namespace cn
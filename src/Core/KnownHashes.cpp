@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "KnownHashes.hpp"
+#include <algorithm>
+#include "common/Varint.hpp"
+#include "crypto/crypto.hpp"
+#include "crypto/hash.hpp"
+
+using namespace cn;
+
+KnownHashes::KnownHashes(size_t max_count)
+    : m_max_count(std::max<size_t>(2, max_count))
+    , m_bit_count((m_max_count / 2 * BITS_PER_HASH + 63) / 64 * 64)
+    , m_current(m_bit_count / 64)
+    , m_previous(m_bit_count / 64)
+    , m_salt(crypto::rand<Hash>()) {}
+
+Hash KnownHashes::salted_hash(const Hash &hash) const {
+	unsigned char data[2 * sizeof(Hash)];
+	memcpy(data, m_salt.data, sizeof(m_salt.data));
+	memcpy(data + sizeof(m_salt.data), hash.data, sizeof(hash.data));
+	return crypto::cn_fast_hash(data, sizeof(data));
+}
+
+size_t KnownHashes::bit_index(const Hash &salted, size_t i) const {
+	// Keyed hash is random enough to be sliced into HASH_FUNCTIONS independent values
+	return common::uint_le_from_bytes<uint32_t>(salted.data + 4 * i, 4) % m_bit_count;
+}
+
+bool KnownHashes::generation_contains(const std::vector<uint64_t> &generation, const Hash &salted) const {
+	for (size_t i = 0; i != HASH_FUNCTIONS; ++i) {
+		const size_t index = bit_index(salted, i);
+		if ((generation[index / 64] & (uint64_t(1) << (index % 64))) == 0)
+			return false;
+	}
+	return true;
+}
+
+bool KnownHashes::contains(const Hash &hash) const {
+	const Hash salted = salted_hash(hash);
+	return generation_contains(m_current, salted) || generation_contains(m_previous, salted);
+}
+
+bool KnownHashes::insert(const Hash &hash) {
+	const Hash salted = salted_hash(hash);
+	if (generation_contains(m_current, salted))
+		return false;
+	// Hashes known only to previous generation are copied, so they are not forgotten at next rotation
+	const bool in_previous = generation_contains(m_previous, salted);
+	for (size_t i = 0; i != HASH_FUNCTIONS; ++i) {
+		const size_t index = bit_index(salted, i);
+		m_current[index / 64] |= uint64_t(1) << (index % 64);
+	}
+	if (++m_current_count >= m_max_count / 2) {
+		m_previous.swap(m_current);
+		std::fill(m_current.begin(), m_current.end(), 0);
+		m_current_count = 0;
+	}
+	return !in_previous;
+}
+
+void KnownHashes::clear() {
+	std::fill(m_current.begin(), m_current.end(), 0);
+	std::fill(m_previous.begin(), m_previous.end(), 0);
+	m_current_count = 0;
+}
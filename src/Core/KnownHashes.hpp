@@ -0,0 +1,35 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <vector>
+#include "CryptoNote.hpp"
+
+namespace cn {
+
+// Rolling Bloom filter, remembers at least max_count / 2 latest hashes, older ones are forgotten by halves.
+// 16 bits per hash in each of 2 generations, false positive rate is about 0.1%.
+// Bits are selected by hash keyed with random salt of each filter, so that nobody can grind transactions
+// making target transaction look known everywhere
+class KnownHashes {
+public:
+	enum { BITS_PER_HASH = 16, HASH_FUNCTIONS = 8 };
+	explicit KnownHashes(size_t max_count);
+	bool contains(const Hash &hash) const;
+	bool insert(const Hash &hash);  // false if already known
+	void clear();
+
+private:
+	size_t m_max_count;
+	size_t m_bit_count;
+	size_t m_current_count = 0;
+	std::vector<uint64_t> m_current;
+	std::vector<uint64_t> m_previous;
+	Hash m_salt;
+	Hash salted_hash(const Hash &hash) const;
+	size_t bit_index(const Hash &salted, size_t i) const;
+	bool generation_contains(const std::vector<uint64_t> &generation, const Hash &salted) const;
+};
+
+}  // namespace cn
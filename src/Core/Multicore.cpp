@@ -2,24 +2,31 @@
 // Licensed under the GNU Lesser General Public License. See LICENSE for details.
 
 #include "Multicore.hpp"
+#include <algorithm>
 #include "BlockChainState.hpp"
 #include "Config.hpp"
 #include "CryptoNoteTools.hpp"
 #include "Currency.hpp"
 #include "TransactionExtra.hpp"
 #include "crypto/crypto.hpp"
+#include "crypto/crypto_helpers.hpp"
 #include "platform/Network.hpp"
+#include "platform/Threads.hpp"
 
 using namespace cn;
 
-BlockPreparatorMulticore::BlockPreparatorMulticore(const Currency &currency, platform::EventLoop *main_loop)
+BlockPreparatorMulticore::BlockPreparatorMulticore(
+    const Currency &currency, platform::EventLoop *main_loop, size_t thread_count, bool pin_threads)
     : currency(currency), main_loop(main_loop) {
-	auto th_count = std::max<size_t>(2, 3 * std::thread::hardware_concurrency() / 4);
-	// we use more energy but have the same speed when using hyperthreading
-	//	std::cout << "Starting multicore ring checker using " << th_count << "/" << std::thread::hardware_concurrency()
-	//	          << " cpus" << std::endl;
+	const size_t th_count  = platform::get_worker_thread_count(thread_count);
+	const size_t cpu_count = std::max<size_t>(1, std::thread::hardware_concurrency());
 	for (size_t i = 0; i != th_count; ++i)
-		threads.emplace_back(&BlockPreparatorMulticore::thread_run, this);
+		results.push_back(std::make_unique<common::SpscRing<std::unique_ptr<ResultItem>>>(RESULT_RING_SIZE));
+	for (size_t i = 0; i != th_count; ++i) {
+		threads.emplace_back(&BlockPreparatorMulticore::thread_run, this, i);
+		if (pin_threads)
+			platform::set_thread_affinity(threads.back(), i % cpu_count);  // Only a hint, ignore failure
+	}
 }
 BlockPreparatorMulticore::~BlockPreparatorMulticore() {
 	{
@@ -30,47 +37,173 @@ BlockPreparatorMulticore::~BlockPreparatorMulticore() {
 	for (auto &&th : threads)
 		th.join();
 }
-void BlockPreparatorMulticore::thread_run() {
+void BlockPreparatorMulticore::thread_run(size_t index) {
 	crypto::CryptoNightContext ctx;
+	auto &result_ring                    = *results.at(index);
+	const ParallelFor local_parallel_for = [this](size_t count, const std::function<void(size_t)> &body) {
+		parallel_for(count, body);
+	};
 	while (true) {
 		WorkItem local_work;
-		{
+		if (quit)
+			return;
+		if (help_with_subtasks())
+			continue;  // Finishing blocks already started is more important than starting new ones
+		if (!work.try_pop(&local_work)) {
 			std::unique_lock<std::mutex> lock(mu);
 			if (quit)
 				return;
-			if (work.empty()) {
+			sleeping_threads += 1;  // add_block reads it after push, so either we see work or it sees us
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const bool popped = work.try_pop(&local_work);
+			if (!popped && subtasks_size == 0)
 				have_work.wait(lock);
+			sleeping_threads -= 1;
+			if (!popped)
 				continue;
-			}
-			local_work = std::move(work.front());
-			work.pop_front();
 		}
-		boost::variant<ConsensusError, PreparedBlock> result = ConsensusError{""};
+		auto local_prefetch_handler = std::atomic_load(&prefetch_handler);
+		std::unique_ptr<ResultItem> item(new ResultItem{local_work.hash, ConsensusError{""}});
 		try {
-			result = PreparedBlock{std::move(local_work.rb), currency, local_work.check_pow ? &ctx : nullptr};
+			item->result = PreparedBlock{
+			    std::move(local_work.rb), currency, local_work.check_pow ? &ctx : nullptr, local_parallel_for};
 		} catch (const ConsensusError &ex) {
-			result = ex;
+			item->result = ex;
 		} catch (const std::runtime_error &ex) {
-			result = ConsensusError{"Runtime error - " + common::what(ex)};
+			item->result = ConsensusError{"Runtime error - " + common::what(ex)};
 		} catch (const std::logic_error &ex) {  // TODO - terminate app
-			result = ConsensusError{"Logic error - " + common::what(ex)};
+			item->result = ConsensusError{"Logic error - " + common::what(ex)};
 		}
-		{
-			std::unique_lock<std::mutex> lock(mu);
-			prepared_blocks.insert(std::make_pair(local_work.hash, std::move(result)));
-			main_loop->wake([]() {});  // so we start processing on_idle
+		std::vector<InputKey> prefetch_inputs;
+		if (local_prefetch_handler)
+			if (const auto *pb = boost::get<PreparedBlock>(&item->result))
+				for (const auto &tx : pb->block.transactions)
+					for (const auto &input : tx.inputs)
+						if (const auto *in = boost::get<InputKey>(&input))
+							prefetch_inputs.push_back(*in);
+		// Before publishing result, otherwise main thread often reads pages itself before we do
+		if (!prefetch_inputs.empty()) {
+			try {  // Prefetch is only a hint, block will be checked by main thread anyway
+				(*local_prefetch_handler)(prefetch_inputs);
+			} catch (const std::exception &) {
+			}
+		}
+		while (!result_ring.try_push(std::move(item))) {  // main thread is busy applying blocks
+			if (!main_loop_woken.exchange(true))
+				main_loop->wake([]() {});
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			if (quit)
+				return;
 		}
+		if (!main_loop_woken.exchange(true))  // so we start processing on_idle, but only once per drain
+			main_loop->wake([]() {});
 	}
 }
 
-void BlockPreparatorMulticore::add_block(Hash bid, bool check_pow, RawBlock &&rb) {
-	std::unique_lock<std::mutex> lock(mu);
-	work.push_back(WorkItem{bid, check_pow, std::move(rb)});
-	have_work.notify_all();
+void BlockPreparatorMulticore::parallel_for(size_t count, const std::function<void(size_t)> &body) {
+	if (count < 2 || threads.size() < 2) {
+		for (size_t i = 0; i != count; ++i)
+			body(i);
+		return;
+	}
+	auto job   = std::make_shared<Subtasks>();
+	job->count = count;
+	job->body  = &body;
+	{
+		std::unique_lock<std::mutex> lock(subtasks_mu);
+		subtasks.push_back(job);
+		subtasks_size = subtasks.size();
+	}
+	wake_workers(true);
+	run_subtasks(job);
+	{  // Helpers may still run subtasks they took, body must stay valid until they finish
+		std::unique_lock<std::mutex> lock(job->mu);
+		job->finished.wait(lock, [&]() { return job->done_count == job->count; });
+	}
+	if (job->error)
+		std::rethrow_exception(job->error);
+}
+
+void BlockPreparatorMulticore::run_subtasks(const std::shared_ptr<Subtasks> &job) {
+	while (true) {
+		const size_t i = job->next_index++;
+		if (i >= job->count)
+			break;
+		if (!job->failed) {  // after error we only count remaining subtasks
+			try {
+				(*job->body)(i);
+			} catch (...) {
+				std::unique_lock<std::mutex> lock(job->mu);
+				if (!job->error)
+					job->error = std::current_exception();
+				job->failed = true;
+			}
+		}
+		if (job->done_count.fetch_add(1) + 1 == job->count) {
+			std::unique_lock<std::mutex> lock(job->mu);
+			job->finished.notify_all();
+		}
+	}
+	std::unique_lock<std::mutex> lock(subtasks_mu);  // No indices left, so nobody should look at job anymore
+	auto sit = std::find(subtasks.begin(), subtasks.end(), job);
+	if (sit != subtasks.end())
+		subtasks.erase(sit);
+	subtasks_size = subtasks.size();
+}
+
+bool BlockPreparatorMulticore::help_with_subtasks() {
+	if (subtasks_size == 0)
+		return false;
+	std::shared_ptr<Subtasks> job;
+	{
+		std::unique_lock<std::mutex> lock(subtasks_mu);
+		if (subtasks.empty())
+			return false;
+		job = subtasks.front();
+	}
+	run_subtasks(job);
+	return true;
+}
+
+void BlockPreparatorMulticore::set_prefetch_handler(PrefetchHandler &&handler) {
+	std::shared_ptr<const PrefetchHandler> local_handler = std::make_shared<PrefetchHandler>(std::move(handler));
+	std::atomic_store(&prefetch_handler, local_handler);
 }
 
-bool BlockPreparatorMulticore::get_prepared_block(Hash bid, boost::variant<ConsensusError, PreparedBlock> *pb) {
+void BlockPreparatorMulticore::wake_workers(bool all) {
+	std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with fence in thread_run
+	if (sleeping_threads == 0)
+		return;
 	std::unique_lock<std::mutex> lock(mu);
+	if (all)
+		have_work.notify_all();
+	else
+		have_work.notify_one();
+}
+
+void BlockPreparatorMulticore::drain_results() {
+	// Reset before popping, so result pushed after we looked at its ring wakes us again
+	main_loop_woken.exchange(false);
+	std::unique_ptr<ResultItem> item;
+	for (auto &&ring : results)
+		while (ring->try_pop(&item))
+			prepared_blocks.insert(std::make_pair(item->hash, std::move(item->result)));
+	size_t pushed = 0;
+	for (; !overflow_work.empty() && work.try_push(std::move(overflow_work.front())); ++pushed)
+		overflow_work.pop_front();
+	if (pushed != 0)
+		wake_workers(pushed > 1);
+}
+
+void BlockPreparatorMulticore::add_block(Hash bid, bool check_pow, RawBlock &&rb) {
+	WorkItem item{bid, check_pow, std::move(rb)};
+	if (!overflow_work.empty() || !work.try_push(std::move(item)))
+		overflow_work.push_back(std::move(item));  // try_push does not move from item on failure
+	wake_workers(false);
+}
+
+bool BlockPreparatorMulticore::get_prepared_block(Hash bid, Result *pb) {
+	drain_results();
 	auto pid = prepared_blocks.find(bid);
 	if (pid == prepared_blocks.end())
 		return false;
@@ -79,13 +212,64 @@ bool BlockPreparatorMulticore::get_prepared_block(Hash bid, boost::variant<Conse
 	return true;
 }
 
-bool BlockPreparatorMulticore::has_prepared_block(Hash bid) const {
-	std::unique_lock<std::mutex> lock(mu);
-	auto pid = prepared_blocks.find(bid);
-	return pid != prepared_blocks.end();
+bool BlockPreparatorMulticore::has_prepared_block(Hash bid) {
+	drain_results();
+	return prepared_blocks.count(bid) != 0;
+}
+
+OutputKeyCache::OutputKeyCache(size_t max_size) {
+	for (size_t i = 0; i != SHARDS; ++i)
+		shards.push_back(std::make_unique<Shard>(max_size / SHARDS));
 }
 
-RingCheckerMulticore::RingCheckerMulticore() {
+OutputKeyCache::Value OutputKeyCache::get(const PublicKey &key) {
+	Shard &shard = *shards.at(key.data[0] % SHARDS);
+	{
+		std::unique_lock<std::mutex> lock(shard.mu);
+		if (const Value *cached = shard.cache.find(key))
+			return *cached;
+	}
+	// Prepared outside of lock, other thread may prepare the same key meanwhile, this is rare and harmless
+	Value value = std::make_shared<const crypto::PreparedOutputKey>(key);
+	std::unique_lock<std::mutex> lock(shard.mu);
+	return *shard.cache.insert(key, std::move(value), sizeof(crypto::PreparedOutputKey) + 2 * sizeof(PublicKey));
+}
+
+crypto::PreparedRings OutputKeyCache::get_rings(
+    const std::vector<std::vector<PublicKey>> &keys, std::vector<Value> *holder) {
+	crypto::PreparedRings result(keys.size());
+	for (size_t i = 0; i != keys.size(); ++i)
+		for (const auto &key : keys[i]) {
+			holder->push_back(get(key));
+			result[i].push_back(holder->back().get());
+		}
+	return result;
+}
+
+template<typename F>
+size_t OutputKeyCache::sum_over_shards(F &&f) const {
+	size_t result = 0;
+	for (const auto &shard : shards) {
+		std::unique_lock<std::mutex> lock(shard->mu);
+		result += f(shard->cache);
+	}
+	return result;
+}
+
+size_t OutputKeyCache::size() const {
+	return sum_over_shards([](const common::LruCache<PublicKey, Value> &c) { return c.size(); });
+}
+size_t OutputKeyCache::get_total_cost() const {
+	return sum_over_shards([](const common::LruCache<PublicKey, Value> &c) { return c.get_total_cost(); });
+}
+size_t OutputKeyCache::get_hits() const {
+	return sum_over_shards([](const common::LruCache<PublicKey, Value> &c) { return c.get_hits(); });
+}
+size_t OutputKeyCache::get_misses() const {
+	return sum_over_shards([](const common::LruCache<PublicKey, Value> &c) { return c.get_misses(); });
+}
+
+RingCheckerMulticore::RingCheckerMulticore(OutputKeyCache *key_cache) : key_cache(key_cache) {
 	auto th_count = std::max<size_t>(2, 3 * std::thread::hardware_concurrency() / 4);
 	// we use more energy but have the same speed when using hyperthreading
 	//	std::cout << "Starting multicore ring checker using " << th_count << "/" << std::thread::hardware_concurrency()
@@ -104,22 +288,25 @@ RingCheckerMulticore::~RingCheckerMulticore() {
 		th.join();
 }
 
-bool RingSignatureCheckArgs::check() const {
+bool RingSignatureCheckArgs::check(OutputKeyCache *key_cache) const {
 	try {
+		std::vector<OutputKeyCache::Value> holder;
 		if (signatures.type() == typeid(RingSignatureAmethyst)) {
 			auto &sigs = boost::get<RingSignatureAmethyst>(signatures);
+			if (key_cache)
+				return crypto::check_ring_signature_amethyst(
+				    tx_prefix_hash, key_images, key_cache->get_rings(output_keys, &holder), sigs);
 			return crypto::check_ring_signature_amethyst(tx_prefix_hash, key_images, output_keys, sigs);
 		}
 		if (signatures.type() == typeid(RingSignatures)) {
 			auto &sigs = boost::get<RingSignatures>(signatures);
-			if (sigs.signatures.empty() || sigs.signatures.size() != key_images.size())
+			if (sigs.signatures.empty() || sigs.signatures.size() != key_images.size() ||
+			    output_keys.size() != key_images.size())
 				return false;
-			for (size_t input_index = 0; input_index != sigs.signatures.size(); ++input_index) {
-				if (!check_ring_signature(tx_prefix_hash, key_images.at(input_index), output_keys.at(input_index),
-				        sigs.signatures.at(input_index)))
-					return false;
-			}
-			return true;
+			if (key_cache)
+				return crypto::check_ring_signatures(
+				    tx_prefix_hash, key_images, key_cache->get_rings(output_keys, &holder), sigs.signatures);
+			return crypto::check_ring_signatures(tx_prefix_hash, key_images, output_keys, sigs.signatures);
 		}
 		// We never call check() for coinbase. If attacker manages to trick code into setting
 		// non coinbase transaction signatures to blank, we will return false
@@ -132,8 +319,7 @@ bool RingSignatureCheckArgs::check() const {
 
 void RingCheckerMulticore::thread_run() {
 	while (true) {
-		RingSignatureCheckArgs args;
-		int local_batch_counter = 0;
+		std::pair<size_t, RingSignatureCheckArgs> args;
 		{
 			std::unique_lock<std::mutex> lock(mu);
 			if (quit)
@@ -142,43 +328,118 @@ void RingCheckerMulticore::thread_run() {
 				have_work.wait(lock);
 				continue;
 			}
-			local_batch_counter = batch_counter;
-			args                = std::move(work.front());
+			args = std::move(work.front());
 			work.pop_front();
 		}
-		bool result = args.check();  // never throws
+		bool result = args.second.check(key_cache);  // never throws
 		std::unique_lock<std::mutex> lock(mu);
-		if (local_batch_counter == batch_counter) {
-			ready_counter += 1;
+		auto bit = batches.find(args.first);
+		if (bit != batches.end()) {  // Otherwise batch was cancelled
+			bit->second.ready_counter += 1;
 			if (!result)
-				errors.push_back(ConsensusErrorBadOutputOrSignature{
-				    "Bad signature or output reference changed", args.newest_referenced_height});
+				bit->second.errors.push_back(ConsensusErrorBadOutputOrSignature{
+				    "Bad signature or output reference changed", args.second.newest_referenced_height});
 			result_ready.notify_all();
 		}
 	}
 }
-void RingCheckerMulticore::start_batch() {
-	total_counter = 0;
+
+size_t RingCheckerMulticore::start_batch() {
 	std::unique_lock<std::mutex> lock(mu);
-	work.clear();
-	batch_counter += 1;
-	ready_counter = 0;
+	next_batch_id += 1;
+	batches[next_batch_id];
+	return next_batch_id;
 }
 
 void RingCheckerMulticore::add_work(RingSignatureCheckArgs &&args) {
-	total_counter += 1;
 	std::unique_lock<std::mutex> lock(mu);
-	work.push_back(std::move(args));
+	invariant(!batches.empty() && batches.rbegin()->first == next_batch_id, "add_work without start_batch");
+	batches.rbegin()->second.total_counter += 1;
+	work.emplace_back(next_batch_id, std::move(args));
 	have_work.notify_all();
 }
 
-std::vector<ConsensusErrorBadOutputOrSignature> RingCheckerMulticore::move_batch_errors() {
+std::vector<ConsensusErrorBadOutputOrSignature> RingCheckerMulticore::move_batch_errors(size_t batch_id) {
+	std::unique_lock<std::mutex> lock(mu);
 	while (true) {
-		std::unique_lock<std::mutex> lock(mu);
-		if (ready_counter != total_counter) {
+		auto bit = batches.find(batch_id);
+		invariant(bit != batches.end(), "move_batch_errors of unknown batch");
+		if (bit->second.ready_counter != bit->second.total_counter) {
 			result_ready.wait(lock);
 			continue;
 		}
-		return std::move(errors);
+		auto errors = std::move(bit->second.errors);
+		batches.erase(bit);
+		return errors;
+	}
+}
+
+void RingCheckerMulticore::cancel_batch(size_t batch_id) {
+	std::unique_lock<std::mutex> lock(mu);
+	work.erase(std::remove_if(work.begin(), work.end(),
+	               [&](const std::pair<size_t, RingSignatureCheckArgs> &w) { return w.first == batch_id; }),
+	    work.end());
+	batches.erase(batch_id);
+}
+
+PoolCheckerMulticore::PoolCheckerMulticore(const Config &config, platform::EventLoop *main_loop)
+    : main_loop(main_loop) {
+	// Pool transactions come at much lower rate than block transactions during sync
+	const size_t th_count = std::max<size_t>(1, platform::get_worker_thread_count(config.worker_threads) / 3);
+	for (size_t i = 0; i != th_count; ++i)
+		threads.emplace_back(&PoolCheckerMulticore::thread_run, this);
+}
+
+PoolCheckerMulticore::~PoolCheckerMulticore() {
+	{
+		std::unique_lock<std::mutex> lock(mu);
+		quit = true;
+		have_work.notify_all();
 	}
+	for (auto &&th : threads)
+		th.join();
+}
+
+void PoolCheckerMulticore::thread_run() {
+	while (true) {
+		std::pair<size_t, Job> local_work;
+		{
+			std::unique_lock<std::mutex> lock(mu);
+			if (quit)
+				return;
+			if (work.empty()) {
+				have_work.wait(lock);
+				continue;
+			}
+			local_work = std::move(work.front());
+			work.pop_front();
+		}
+		std::exception_ptr error;
+		try {
+			local_work.second();
+		} catch (...) {
+			error = std::current_exception();
+		}
+		std::unique_lock<std::mutex> lock(mu);
+		ready.insert(std::make_pair(local_work.first, error));
+		main_loop->wake([]() {});  // so we start processing on_idle
+	}
+}
+
+size_t PoolCheckerMulticore::add_work(Job &&job) {
+	std::unique_lock<std::mutex> lock(mu);
+	const size_t id = next_id++;
+	work.push_back(std::make_pair(id, std::move(job)));
+	have_work.notify_all();
+	return id;
+}
+
+bool PoolCheckerMulticore::get_result(size_t id, std::exception_ptr *error) {
+	std::unique_lock<std::mutex> lock(mu);
+	auto rit = ready.find(id);
+	if (rit == ready.end())
+		return false;
+	*error = rit->second;
+	ready.erase(rit);
+	return true;
 }
@@ -3,12 +3,17 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <exception>
+#include <functional>
 #include <mutex>
 #include <thread>
 #include "BlockChain.hpp"  // for PreparedBlock
 #include "CryptoNote.hpp"
+#include "common/ConcurrentQueue.hpp"
+#include "common/LruCache.hpp"
 #include "rpc_api.hpp"
 
 // Experimental machinery to offload heavy calcs to other cores
@@ -17,38 +22,117 @@
 namespace platform {
 class EventLoop;
 }
+namespace crypto {
+struct PreparedOutputKey;
+typedef std::vector<std::vector<const PreparedOutputKey *>> PreparedRings;
+}  // namespace crypto
 namespace cn {
 
 class IBlockChainState;  // We will read keyimages and outputs from it
 class Currency;
 
+// Work is taken by workers from lock-free queue, each worker returns results via its own ring to main thread.
+// Main thread is woken at most once until it drains results, mutex is used only to put idle workers to sleep.
+// Worker preparing block publishes its subtasks (PoW, parsing and hashing of each transaction), so idle workers
+// steal them and single huge block is prepared by all cores
 class BlockPreparatorMulticore {
+public:
+	typedef boost::variant<ConsensusError, PreparedBlock> Result;
+	// Called on worker thread after block is prepared, so must be thread-safe
+	typedef std::function<void(const std::vector<InputKey> &inputs)> PrefetchHandler;
+	enum { WORK_QUEUE_SIZE = 1024, RESULT_RING_SIZE = 256 };
+
+private:
 	const Currency &currency;
 
 	std::vector<std::thread> threads;
-	mutable std::mutex mu;
+	std::mutex mu;  // only for sleeping on have_work
 	std::condition_variable have_work;
+	std::atomic<size_t> sleeping_threads{0};
+	std::atomic<bool> quit{false};
 	platform::EventLoop *main_loop = nullptr;
-	//	std::condition_variable prepared_blocks_ready;
-	bool quit = false;
+	std::atomic<bool> main_loop_woken{false};
 
 	struct WorkItem {
 		Hash hash;
 		bool check_pow = false;
 		RawBlock rb;
 	};
-	std::deque<WorkItem> work;
-	std::map<Hash, boost::variant<ConsensusError, PreparedBlock>> prepared_blocks;
-
-	void thread_run();
+	struct ResultItem {
+		Hash hash;
+		Result result;
+	};
+	common::BoundedQueue<WorkItem> work{WORK_QUEUE_SIZE};
+	std::vector<std::unique_ptr<common::SpscRing<std::unique_ptr<ResultItem>>>> results;  // one per worker
+
+	// Accessed by main thread only
+	std::deque<WorkItem> overflow_work;  // when work queue is full
+	std::map<Hash, Result> prepared_blocks;
+
+	// Subtasks of block being prepared by one worker, idle workers grab indices to help with large blocks
+	struct Subtasks {
+		size_t count                            = 0;
+		const std::function<void(size_t)> *body = nullptr;
+		std::atomic<size_t> next_index{0};
+		std::atomic<size_t> done_count{0};
+		std::atomic<bool> failed{false};
+		std::mutex mu;  // protects error, finish is signalled under it
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	std::mutex subtasks_mu;
+	std::vector<std::shared_ptr<Subtasks>> subtasks;  // only those with indices left, protected by subtasks_mu
+	std::atomic<size_t> subtasks_size{0};
+
+	std::shared_ptr<const PrefetchHandler> prefetch_handler;  // accessed with std::atomic_load/store
+	void thread_run(size_t index);
+	void wake_workers(bool all);
+	void drain_results();
+	void parallel_for(size_t count, const std::function<void(size_t)> &body);
+	void run_subtasks(const std::shared_ptr<Subtasks> &job);
+	bool help_with_subtasks();
 
 public:
-	explicit BlockPreparatorMulticore(const Currency &currency, platform::EventLoop *main_loop);
+	// thread_count 0 means 3/4 of hardware threads, see platform::get_worker_thread_count
+	explicit BlockPreparatorMulticore(const Currency &currency, platform::EventLoop *main_loop,
+	    size_t thread_count = 0, bool pin_threads = false);
 	~BlockPreparatorMulticore();
 
+	// Lets worker threads read DB state referenced by block while main thread applies previous blocks
+	void set_prefetch_handler(PrefetchHandler &&handler);
+
+	// Methods below must be called from main thread only
 	void add_block(Hash bid, bool check_pow, RawBlock &&rb);
-	bool get_prepared_block(Hash bid, boost::variant<ConsensusError, PreparedBlock> *pb);
-	bool has_prepared_block(Hash bid) const;
+	bool get_prepared_block(Hash bid, Result *pb);
+	bool has_prepared_block(Hash bid);
+};
+
+// Output keys prepared for ring checks, shared by all threads. Popular decoys appear in many rings, so we reuse
+// their decompression, hash_to_good_point and precomputation tables. Sharded by key, so threads rarely contend
+class OutputKeyCache {
+public:
+	typedef std::shared_ptr<const crypto::PreparedOutputKey> Value;  // stays valid after eviction
+	enum { SHARDS = 16 };
+
+	explicit OutputKeyCache(size_t max_size);  // approximate memory in bytes
+	Value get(const PublicKey &key);  // throws crypto::Error if key is invalid
+	// Pointers in result are valid while values are kept in holder
+	crypto::PreparedRings get_rings(const std::vector<std::vector<PublicKey>> &keys, std::vector<Value> *holder);
+
+	size_t size() const;
+	size_t get_total_cost() const;
+	size_t get_hits() const;
+	size_t get_misses() const;
+
+private:
+	struct Shard {
+		mutable std::mutex mu;
+		common::LruCache<PublicKey, Value> cache;
+		explicit Shard(size_t max_cost) : cache(max_cost) {}
+	};
+	std::vector<std::unique_ptr<Shard>> shards;
+	template<typename F>
+	size_t sum_over_shards(F &&f) const;
 };
 
 struct RingSignatureCheckArgs {
@@ -60,31 +144,63 @@ struct RingSignatureCheckArgs {
 	std::vector<std::vector<Amount>> amounts;
 	TransactionSignatures signatures;
 
-	bool check() const;
+	bool check(OutputKeyCache *key_cache = nullptr) const;
 };
 
+// Several batches (usually one per block) can be checked at once, so that workers do not wait
+// while main thread applies next block. Results are collected per batch
 class RingCheckerMulticore {
+	OutputKeyCache *key_cache = nullptr;
 	std::vector<std::thread> threads;
-	size_t total_counter = 0;
 
 	mutable std::mutex mu;  // everything below is protected by mutex
 	mutable std::condition_variable have_work;
 	mutable std::condition_variable result_ready;
 	bool quit = false;
 
-	size_t ready_counter = 0;
-	std::vector<ConsensusErrorBadOutputOrSignature> errors;
+	struct Batch {
+		size_t total_counter = 0;
+		size_t ready_counter = 0;
+		std::vector<ConsensusErrorBadOutputOrSignature> errors;
+	};
+	std::map<size_t, Batch> batches;
+	size_t next_batch_id = 0;
 
-	std::deque<RingSignatureCheckArgs> work;
-	int batch_counter = 0;
+	std::deque<std::pair<size_t, RingSignatureCheckArgs>> work;
 	void thread_run();
 
 public:
-	RingCheckerMulticore();
+	explicit RingCheckerMulticore(OutputKeyCache *key_cache = nullptr);  // key_cache must outlive checker
 	~RingCheckerMulticore();
-	void start_batch();
-	void add_work(RingSignatureCheckArgs &&args);
-	std::vector<ConsensusErrorBadOutputOrSignature> move_batch_errors();
+	size_t start_batch();  // Previous batches are still being checked
+	void add_work(RingSignatureCheckArgs &&args);  // to last started batch
+	std::vector<ConsensusErrorBadOutputOrSignature> move_batch_errors(size_t batch_id);  // waits, then forgets batch
+	void cancel_batch(size_t batch_id);  // Forgets batch, its work not yet started is dropped
+};
+
+// Checks signatures of pool transactions, so that burst of relayed transactions does not stall main thread.
+// Jobs must not touch DB or pool, everything they need is read on main thread before add_work
+class PoolCheckerMulticore {
+public:
+	typedef std::function<void()> Job;  // throws ConsensusError if transaction is bad
+
+private:
+	std::vector<std::thread> threads;
+	mutable std::mutex mu;  // everything below is protected by mutex
+	std::condition_variable have_work;
+	platform::EventLoop *main_loop = nullptr;
+	bool quit                      = false;
+
+	std::deque<std::pair<size_t, Job>> work;
+	std::map<size_t, std::exception_ptr> ready;  // nullptr for good transactions
+	size_t next_id = 0;
+	void thread_run();
+
+public:
+	PoolCheckerMulticore(const Config &config, platform::EventLoop *main_loop);
+	~PoolCheckerMulticore();
+	size_t add_work(Job &&job);  // returns id to get result later
+	bool get_result(size_t id, std::exception_ptr *error);  // false if not ready yet
 };
 
 }  // namespace cn
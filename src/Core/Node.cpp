@@ -11,6 +11,7 @@
 #include "common/Base58.hpp"
 #include "common/JsonValue.hpp"
 #include "common/StringTools.hpp"
+#include "crypto/crypto_helpers.hpp"
 #include "http/Server.hpp"
 #include "p2p/PeerDB.hpp"
 #include "platform/PathTools.hpp"
@@ -36,7 +37,12 @@ Node::Node(logging::ILogger &log, const Config &config, BlockChainState &block_c
     , m_commit_timer(std::bind(&Node::db_commit, this))
     , log_request_timestamp(std::chrono::steady_clock::now())
     , log_response_timestamp(std::chrono::steady_clock::now())
-    , m_pow_checker(block_chain.get_currency(), platform::EventLoop::current()) {
+    , m_pow_checker(block_chain.get_currency(), platform::EventLoop::current(), config.worker_threads,
+          config.worker_threads_affinity)
+    , m_pool_checker(config, platform::EventLoop::current()) {
+	if (config.prefetch_block_state)
+		m_pow_checker.set_prefetch_handler(
+		    [&block_chain](const std::vector<InputKey> &inputs) { block_chain.prefetch_block_state(inputs); });
 	if (config.bytecoind_bind_port != 0) {
 		m_api = std::make_unique<http::Server>(config.bytecoind_bind_ip, config.bytecoind_bind_port,
 		    std::bind(&Node::on_api_http_request, this, _1, _2, _3),
@@ -118,6 +124,8 @@ bool Node::on_idle() {
 	}
 	if (m_block_chain.get_tip_height() < m_block_chain.internal_import_known_height())
 		m_block_chain.internal_import();
+	if (process_pending_pool_transactions())
+		on_idle_result = true;
 	if (m_block_chain.get_tip_bid() != was_top_bid) {
 		advance_long_poll();
 	}
@@ -125,6 +133,49 @@ bool Node::on_idle() {
 	return on_idle_result;
 }
 
+bool Node::process_pending_pool_transactions() {
+	bool added = false, processed = false;
+	while (!m_pending_pool_transactions.empty()) {
+		auto &ptx = m_pending_pool_transactions.front();
+		std::exception_ptr error;
+		if (!m_pool_checker.get_result(ptx.check_id, &error))
+			break;  // Arrival order
+		processed                = true;
+		const bool same_tip      = ptx.tip_bid == m_block_chain.get_tip_bid();
+		P2PProtocolBytecoin *who = ptx.who;
+		std::string ban_reason;
+		// If tip changed, referenced outputs could change, so we check again here (rare)
+		if (same_tip || m_block_chain.in_chain(ptx.newest_referenced_block)) {
+			try {
+				if (error && same_tip)
+					std::rethrow_exception(error);
+				const std::string source = who ? who->get_address().to_string() : std::string{};
+				if (m_block_chain.add_transaction(ptx.tid, ptx.tx, ptx.binary_tx, !same_tip, source)) {
+					TransactionDesc desc;
+					desc.hash                    = ptx.tid;
+					desc.size                    = ptx.binary_tx.size();
+					desc.fee                     = get_tx_fee(ptx.tx);
+					desc.newest_referenced_block = ptx.newest_referenced_block;
+					relay_transaction(desc);
+					added = true;
+				}
+			} catch (const ConsensusErrorOutputSpent &) {
+				// Not a ban reason
+			} catch (const std::exception &ex) {
+				// We are safe to ban, because we have newest referenced block
+				ban_reason = "NOTIFY_NEW_TRANSACTIONS add_transaction BAN what=" + common::what(ex);
+			}
+		}
+		m_pending_pool_tids.erase(ptx.tid);
+		m_pending_pool_transactions.pop_front();
+		if (who && !ban_reason.empty())
+			who->disconnect(ban_reason);
+	}
+	if (added)
+		advance_long_poll();
+	return processed;
+}
+
 bool Node::check_trust(const p2p::ProofOfTrust &tr) {
 	Timestamp local_time = platform::now_unix_timestamp();
 	Timestamp time_delta = local_time > tr.time ? local_time - tr.time : tr.time - local_time;
@@ -380,10 +431,43 @@ api::cnd::GetStatus::Response Node::create_status_response() const {
 	return res;
 }
 
-void Node::broadcast(P2PProtocolBytecoin *exclude, const BinaryArray &data) {
+void Node::broadcast(P2PProtocolBytecoin *exclude, BinaryArray &&data) {
+	const auto shared_data = std::make_shared<const BinaryArray>(std::move(data));
 	for (auto &&p : m_broadcast_protocols)
 		if (p != exclude)
-			p->P2PProtocol::send(BinaryArray(data));  // Move is impossible here
+			p->send_shared(shared_data);
+}
+
+void Node::relay_transaction(const TransactionDesc &desc) {
+	for (auto &&p : m_broadcast_protocols)
+		p->announce_transaction(desc);
+}
+
+void Node::broadcast_new_block(P2PProtocolBytecoin *exclude, const BinaryArray &block, const Hash &bid, Height height,
+    bool to_compact_peers, bool to_legacy_peers) {
+	common::SharedBinaryArray compact_data;  // Created on first use
+	common::SharedBinaryArray legacy_data;
+	for (auto &&p : m_broadcast_protocols) {
+		if (p == exclude || p->get_peer_sync_data().top_id == bid)
+			continue;
+		if (p->peer_has_feature(P2P_FEATURE_COMPACT_BLOCKS)) {
+			if (!to_compact_peers)
+				continue;
+			if (!compact_data)
+				compact_data =
+				    std::make_shared<const BinaryArray>(LevinProtocol::send(make_compact_block(block, bid, height)));
+			p->send_shared(compact_data);
+		} else if (to_legacy_peers) {
+			if (!legacy_data) {
+				p2p::RelayBlock::Notify msg;
+				msg.b.block                   = block;
+				msg.top_id                    = bid;
+				msg.current_blockchain_height = height;
+				legacy_data                   = std::make_shared<const BinaryArray>(LevinProtocol::send(msg));
+			}
+			p->send_shared(legacy_data);
+		}
+	}
 }
 
 bool Node::on_get_status(http::Client *who, http::RequestBody &&raw_request, json_rpc::Request &&raw_js_request,
@@ -414,6 +498,8 @@ api::cnd::GetStatistics::Response Node::create_statistics_response(const api::cn
 			desc.peer_id               = p->get_peer_unique_number();
 			desc.top_block_desc.hash   = p->get_peer_sync_data().top_id;
 			desc.top_block_desc.height = p->get_peer_sync_data().current_height;
+			desc.uploaded_bytes        = p->get_client()->get_uploaded_bytes();
+			desc.upload_queue_size     = p->get_client()->get_upload_queue_size();
 			res.connected_peers.push_back(desc);
 		}
 	}
@@ -427,6 +513,17 @@ api::cnd::GetStatistics::Response Node::create_statistics_response(const api::cn
 	res.genesis_block_hash = m_block_chain.get_currency().genesis_block_hash;
 	res.start_time         = m_start_time;
 	m_block_chain.fill_statistics(res);
+	res.compact_blocks_received             = m_compact_blocks_received;
+	res.compact_blocks_reconstructed        = m_compact_blocks_reconstructed;
+	res.compact_blocks_incomplete           = m_compact_blocks_incomplete;
+	res.compact_blocks_missing_transactions = m_compact_blocks_missing_transactions;
+	res.compact_blocks_failed               = m_compact_blocks_failed;
+	res.compact_blocks_relayed_early        = m_compact_blocks_relayed_early;
+	res.p2p_uploaded_bytes                  = m_p2p.get_uploaded_bytes();
+	res.p2p_upload_queue_size               = m_p2p.get_upload_queue_size();
+	res.transaction_relay_announced         = m_transaction_relay_announced;
+	res.transaction_relay_suppressed        = m_transaction_relay_suppressed;
+	res.transaction_relay_messages          = m_transaction_relay_messages;
 	return res;
 }
 
@@ -595,21 +692,24 @@ bool Node::on_sync_mempool(http::Client *, http::RequestBody &&http_request, jso
 	if ((!is_binary || req.need_redundant_data) &&
 	    !m_config.good_bytecoind_auth_private(http_request.r.basic_authorization))
 		throw http::ErrorAuthorization("authorization-private");  // slow variants are private
-	const auto &pool = m_block_chain.get_memory_state_transactions();
+	const auto &pool = m_block_chain.get_tx_pool();
 	for (auto &&ex : req.known_hashes)
-		if (pool.count(ex) == 0)
+		if (!pool.find(ex))
 			res.removed_hashes.push_back(ex);
-	for (auto &&tx : pool)
-		if (!std::binary_search(req.known_hashes.begin(), req.known_hashes.end(), tx.first)) {
-			res.added_raw_transactions.push_back(tx.second.tx);
+	const auto &fee_index = pool.get_fee_index();
+	for (auto fit = fee_index.rbegin(); fit != fee_index.rend(); ++fit)
+		if (!std::binary_search(req.known_hashes.begin(), req.known_hashes.end(), fit->second)) {
+			const TransactionPool::Record &record = pool.at(fit->second);
+			const Transaction tx                  = record.get_tx();
+			res.added_raw_transactions.push_back(tx);
 			res.added_transactions.push_back(api::Transaction{});
 			if (req.need_redundant_data)
-				fill_transaction_info(tx.second.tx, &res.added_transactions.back(), nullptr);
-			res.added_transactions.back().hash      = tx.first;
-			res.added_transactions.back().timestamp = tx.second.timestamp;
-			res.added_transactions.back().amount    = tx.second.amount;
-			res.added_transactions.back().fee       = tx.second.fee;
-			res.added_transactions.back().size      = tx.second.binary_tx.size();
+				fill_transaction_info(tx, &res.added_transactions.back(), nullptr);
+			res.added_transactions.back().hash      = record.tid;
+			res.added_transactions.back().timestamp = record.timestamp;
+			res.added_transactions.back().amount    = record.amount;
+			res.added_transactions.back().fee       = record.fee;
+			res.added_transactions.back().size      = record.binary_tx.size();
 		}
 	res.status = create_status_response();
 	return true;
@@ -685,22 +785,21 @@ bool Node::on_get_raw_block(http::Client *, http::RequestBody &&, json_rpc::Requ
 
 bool Node::on_get_raw_transaction(http::Client *, http::RequestBody &&, json_rpc::Request &&,
     api::cnd::GetRawTransaction::Request &&req, api::cnd::GetRawTransaction::Response &res) {
-	const auto &pool = m_block_chain.get_memory_state_transactions();
-	auto tit         = pool.find(req.hash);
-	if (tit != pool.end()) {
-		res.raw_transaction = static_cast<const TransactionPrefix &>(tit->second.tx);
-		fill_transaction_info(tit->second.tx, &res.transaction, &res.mixed_outputs);
+	if (const TransactionPool::Record *record = m_block_chain.get_tx_pool().find(req.hash)) {
+		const Transaction tx = record->get_tx();
+		res.raw_transaction  = static_cast<const TransactionPrefix &>(tx);
+		fill_transaction_info(tx, &res.transaction, &res.mixed_outputs);
 		for (const auto &outputs : res.mixed_outputs) {
 			res.mixed_public_keys.push_back(std::vector<PublicKey>{});
 			for (const auto &output : outputs)
 				res.mixed_public_keys.back().push_back(output.public_key);
 		}
-		res.transaction.fee          = tit->second.fee;
+		res.transaction.fee          = record->fee;
 		res.transaction.hash         = req.hash;
 		res.transaction.block_height = m_block_chain.get_tip_height() + 1;
-		res.transaction.timestamp    = tit->second.timestamp;
-		res.transaction.size         = tit->second.binary_tx.size();
-		res.signatures               = tit->second.tx.signatures;
+		res.transaction.timestamp    = record->timestamp;
+		res.transaction.size         = record->binary_tx.size();
+		res.signatures               = tx.signatures;
 		return true;
 	}
 	BinaryArray binary_tx;
@@ -735,7 +834,6 @@ bool Node::on_send_transaction(http::Client *, http::RequestBody &&, json_rpc::R
     api::cnd::SendTransaction::Request &&request, api::cnd::SendTransaction::Response &response) {
 	response.send_result = "broadcast";
 
-	p2p::RelayTransactions::Notify msg_v4;
 	Transaction tx;
 	try {
 		seria::from_binary(tx, request.binary_transaction);
@@ -748,10 +846,7 @@ bool Node::on_send_transaction(http::Client *, http::RequestBody &&, json_rpc::R
 			Height newest_referenced_height = 0;
 			invariant(m_block_chain.get_largest_referenced_height(tx, &newest_referenced_height), "");
 			invariant(m_block_chain.get_chain(newest_referenced_height, &desc.newest_referenced_block), "");
-			msg_v4.transaction_descs.push_back(desc);
-
-			BinaryArray raw_msg_v4 = LevinProtocol::send(msg_v4);
-			broadcast(nullptr, raw_msg_v4);
+			relay_transaction(desc);
 			advance_long_poll();
 		}
 	} catch (const ConsensusErrorOutputDoesNotExist &ex) {
@@ -894,7 +989,14 @@ void Node::check_sendproof(const BinaryArray &data_inside_base58, api::cnd::Chec
 	for (size_t i = 0; i != mixed_outputs.size(); ++i)
 		all_output_keys.at(0).push_back(mixed_outputs.at(i).public_key);
 
-	if (!crypto::check_ring_signature_amethyst(proof_prefix_hash, all_keyimages, all_output_keys, rsa)) {
+	// Outputs returned by get_mixed_outputs are checked through the same cache as outputs in blocks
+	std::vector<OutputKeyCache::Value> key_holder;
+	OutputKeyCache *key_cache = m_block_chain.get_output_key_cache();
+	const bool good_signature =
+	    key_cache ? crypto::check_ring_signature_amethyst(
+	                    proof_prefix_hash, all_keyimages, key_cache->get_rings(all_output_keys, &key_holder), rsa)
+	              : crypto::check_ring_signature_amethyst(proof_prefix_hash, all_keyimages, all_output_keys, rsa);
+	if (!good_signature) {
 		throw api::cnd::CheckSendproof::Error(api::cnd::CheckSendproof::PROOF_WRONG_SIGNATURE,
 		    "Proof object does not match transaction or was tampered with", sp.transaction_hash);
 	}
@@ -1000,13 +1102,8 @@ void Node::submit_block(const BinaryArray &blockblob, api::BlockHeader *info) {
 	}
 	for (auto who : m_broadcast_protocols)
 		who->advance_transactions();
-	p2p::RelayBlock::Notify msg_v4;
-	msg_v4.b.block                   = raw_block.block;
-	msg_v4.current_blockchain_height = m_block_chain.get_tip_height();
-	msg_v4.top_id                    = m_block_chain.get_tip_bid();
-
-	BinaryArray raw_msg_v4 = LevinProtocol::send(msg_v4);
-	broadcast(nullptr, raw_msg_v4);
+	broadcast_new_block(
+	    nullptr, raw_block.block, m_block_chain.get_tip_bid(), m_block_chain.get_tip_height(), true, true);
 	advance_long_poll();
 }
 
@@ -5,7 +5,10 @@
 
 #include <functional>
 #include <iostream>
+#include <unordered_set>
 #include "BlockChainState.hpp"
+#include "CompactBlock.hpp"
+#include "KnownHashes.hpp"
 #include "http/BinaryRpc.hpp"
 #include "http/JsonRpc.hpp"
 #include "p2p/P2P.hpp"
@@ -120,7 +123,8 @@ protected:
 		size_t chain_counter                 = 0;
 		P2PProtocolBytecoin *who_downloading = nullptr;
 		Height expected_height               = 0;  // Set during download
-		bool preparing                       = false;
+		std::chrono::steady_clock::time_point request_time;  // Set during download
+		bool preparing = false;
 	};
 	std::map<Hash, DownloadInfo> chain_blocks;
 	void remove_chain_block(std::map<Hash, DownloadInfo>::iterator it);
@@ -134,6 +138,11 @@ protected:
 		platform::Timer m_chain_timer;
 		platform::Timer m_download_timer;
 		size_t m_downloading_block_count = 0;
+		size_t m_download_window         = 0;  // bytes, only for peers with P2P_FEATURE_BATCHED_OBJECTS
+		size_t m_average_block_size      = 0;  // of blocks downloaded from this peer, 0 if none yet
+		std::chrono::steady_clock::time_point m_download_window_decreased;
+		size_t get_max_downloading_blocks() const;
+		void on_block_downloaded(size_t size, std::chrono::steady_clock::time_point request_time);
 		void on_chain_timer();
 		void on_download_timer();
 		Hash m_previous_chain_hash;
@@ -151,6 +160,18 @@ protected:
 		void transaction_download_finished(const Hash &tid, bool success);
 		bool on_transaction_descs(const std::vector<TransactionDesc> &descs);
 
+		KnownHashes m_known_transactions;  // sent by peer to us or by us to peer
+		std::deque<TransactionDesc> m_trickle_queue;
+		platform::Timer m_trickle_timer;
+		void on_trickle_timer();
+		void set_trickle_timer();
+
+		CompactBlockReconstruction m_compact_block;  // msg.top_id is zero if not waiting for transactions
+		platform::Timer m_compact_block_timer;
+		void on_compact_block_timer();
+		void on_compact_block_failed(const Hash &top_id, Height height);  // will download normally
+		void add_relayed_block(RawBlock &&rb, const Hash &top_id, Height height, bool compact);
+
 	protected:
 		void on_disconnect(const std::string &ban_reason) override;
 
@@ -171,6 +192,9 @@ protected:
 		void on_msg_notify_new_block(p2p::RelayBlock::Notify &&) override;
 		void on_msg_notify_new_transactions(p2p::RelayTransactions::Notify &&) override;
 		void on_msg_notify_checkpoint(p2p::Checkpoint::Notify &&) override;
+		void on_msg_notify_new_compact_block(p2p::RelayCompactBlock::Notify &&) override;
+		void on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Request &&) override;
+		void on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Response &&) override;
 #if bytecoin_ALLOW_DEBUG_COMMANDS
 		void on_msg_stat_info(p2p::GetStatInfo::Request &&) override;
 #endif
@@ -181,6 +205,7 @@ protected:
 		void advance_blocks();
 		bool on_idle(std::chrono::steady_clock::time_point idle_start);
 		void advance_transactions();
+		void announce_transaction(const TransactionDesc &desc);  // with next trickle, unless peer knows it
 	};
 	std::unique_ptr<P2PProtocol> client_factory(P2PClient *client) {
 		return std::make_unique<P2PProtocolBytecoin>(this, client);
@@ -195,7 +220,35 @@ protected:
 	BlockPreparatorMulticore m_pow_checker;
 	// TODO - periodically clear m_pow_checker of blocks that were not asked
 
-	void broadcast(P2PProtocolBytecoin *exclude, const BinaryArray &data);
+	// Relayed transactions wait here while m_pool_checker checks signatures, then enter pool in arrival order
+	struct PendingPoolTransaction {
+		size_t check_id = 0;
+		Hash tid;
+		Transaction tx;
+		BinaryArray binary_tx;
+		Hash tip_bid;  // Referenced outputs were read at this tip
+		Hash newest_referenced_block;
+		P2PProtocolBytecoin *who = nullptr;  // nullptr after disconnect
+	};
+	std::deque<PendingPoolTransaction> m_pending_pool_transactions;
+	std::unordered_set<Hash> m_pending_pool_tids;  // Same transactions, so that we do not download them again
+	PoolCheckerMulticore m_pool_checker;
+	bool process_pending_pool_transactions();
+
+	void broadcast(P2PProtocolBytecoin *exclude, BinaryArray &&data);  // data is shared by all send queues
+	void relay_transaction(const TransactionDesc &desc);
+	size_t m_transaction_relay_announced  = 0;
+	size_t m_transaction_relay_suppressed = 0;
+	size_t m_transaction_relay_messages   = 0;
+	// Peers with P2P_FEATURE_COMPACT_BLOCKS get RelayCompactBlock, others get RelayBlock header
+	void broadcast_new_block(P2PProtocolBytecoin *exclude, const BinaryArray &block, const Hash &bid, Height height,
+	    bool to_compact_peers, bool to_legacy_peers);
+	size_t m_compact_blocks_received             = 0;
+	size_t m_compact_blocks_reconstructed        = 0;
+	size_t m_compact_blocks_incomplete           = 0;
+	size_t m_compact_blocks_missing_transactions = 0;
+	size_t m_compact_blocks_failed               = 0;
+	size_t m_compact_blocks_relayed_early        = 0;
 
 	void fill_cors(const http::RequestBody &req, http::ResponseBody &res);
 	bool on_api_http_request(http::Client *, http::RequestBody &&, http::ResponseBody &);
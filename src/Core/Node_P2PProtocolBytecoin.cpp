@@ -29,8 +29,12 @@ Node::P2PProtocolBytecoin::P2PProtocolBytecoin(Node *node, P2PClient *client)
     , m_node(node)
     , m_chain_timer(std::bind(&P2PProtocolBytecoin::on_chain_timer, this))
     , m_download_timer(std::bind(&P2PProtocolBytecoin::on_download_timer, this))
+    , m_download_window(node->m_config.download_peer_window_min)
     , m_syncpool_timer(std::bind(&P2PProtocolBytecoin::on_syncpool_timer, this))
-    , m_download_transactions_timer(std::bind(&P2PProtocolBytecoin::on_download_transactions_timer, this)) {}
+    , m_download_transactions_timer(std::bind(&P2PProtocolBytecoin::on_download_transactions_timer, this))
+    , m_known_transactions(node->m_config.p2p_known_transactions_limit)
+    , m_trickle_timer(std::bind(&P2PProtocolBytecoin::on_trickle_timer, this))
+    , m_compact_block_timer(std::bind(&P2PProtocolBytecoin::on_compact_block_timer, this)) {}
 
 Node::P2PProtocolBytecoin::~P2PProtocolBytecoin() = default;
 
@@ -124,13 +128,14 @@ void Node::P2PProtocolBytecoin::advance_blocks() {
 		m_node->remove_chain_block(m_chain.front());
 		m_chain.pop_front();
 	}
-	if (m_downloading_block_count >= m_node->m_config.max_downloading_blocks_from_each_peer)
+	const size_t max_downloading = get_max_downloading_blocks();
+	if (m_downloading_block_count >= max_downloading)
 		return;
 	size_t we_downloading = 0;
 	std::vector<Hash> request_block_ids;
-	for (size_t i = 0; i < std::min(m_chain.size(), m_node->m_config.download_window) &&
-	                   we_downloading < m_node->m_config.max_downloading_blocks_from_each_peer;
-	     ++i) {
+	const auto now = std::chrono::steady_clock::now();
+	for (size_t i = 0;
+	     i < std::min(m_chain.size(), m_node->m_config.download_window) && we_downloading < max_downloading; ++i) {
 		auto cit = m_chain.at(i);
 		if (cit->second.who_downloading || cit->second.preparing) {
 			we_downloading += (cit->second.who_downloading == this) ? 1 : 0;
@@ -139,9 +144,9 @@ void Node::P2PProtocolBytecoin::advance_blocks() {
 		we_downloading += 1;
 		cit->second.who_downloading = this;
 		cit->second.expected_height = static_cast<Height>(m_chain_start_height + i);
+		cit->second.request_time    = now;
 		m_downloading_block_count += 1;
 		request_block_ids.push_back(cit->first);
-		const auto now = std::chrono::steady_clock::now();
 		if (std::chrono::duration_cast<std::chrono::milliseconds>(now - m_node->log_request_timestamp).count() > 1000) {
 			m_node->log_request_timestamp = now;
 			std::cout << "Requesting block " << m_chain_start_height + i << " from " << get_address() << std::endl;
@@ -151,13 +156,41 @@ void Node::P2PProtocolBytecoin::advance_blocks() {
 	}
 	if (!request_block_ids.empty())
 		m_download_timer.once(m_node->m_config.download_block_timeout);
-	for (const auto &bid : request_block_ids) {
+	// Legacy peers get separate request for each block
+	const size_t batch_size =
+	    peer_has_feature(P2P_FEATURE_BATCHED_OBJECTS) ? size_t(p2p::GetObjects::MAX_BATCH_OBJECTS) : 1;
+	for (size_t i = 0; i < request_block_ids.size(); i += batch_size) {
 		p2p::GetObjects::Request msg;
-		msg.blocks.push_back(bid);
+		msg.blocks.assign(request_block_ids.begin() + i,
+		    request_block_ids.begin() + std::min(request_block_ids.size(), i + batch_size));
 		send(LevinProtocol::send(msg));
 	}
 }
 
+size_t Node::P2PProtocolBytecoin::get_max_downloading_blocks() const {
+	if (!peer_has_feature(P2P_FEATURE_BATCHED_OBJECTS) || m_average_block_size == 0)
+		return m_node->m_config.max_downloading_blocks_from_each_peer;
+	return std::max<size_t>(1, m_download_window / m_average_block_size);
+}
+
+void Node::P2PProtocolBytecoin::on_block_downloaded(size_t size, std::chrono::steady_clock::time_point request_time) {
+	const bool window_full = m_downloading_block_count >= get_max_downloading_blocks();
+	m_average_block_size   = m_average_block_size == 0 ? size : (m_average_block_size * 7 + size) / 8;
+	const auto &config     = m_node->m_config;
+	const auto now         = std::chrono::steady_clock::now();
+	const auto latency_ms  = std::chrono::duration_cast<std::chrono::milliseconds>(now - request_time).count();
+	const auto target_ms   = int(1000 * config.download_peer_target_latency);
+	if (latency_ms > target_ms) {
+		// Blocks wait in peer's queue too long. All blocks of that window will be late, so we decrease only once
+		if (std::chrono::duration_cast<std::chrono::milliseconds>(now - m_download_window_decreased).count() >
+		    target_ms) {
+			m_download_window           = std::max(config.download_peer_window_min, m_download_window / 2);
+			m_download_window_decreased = now;
+		}
+	} else if (window_full)  // Doubles every round trip, until limited by latency or max
+		m_download_window = std::min(config.download_peer_window_max, m_download_window + size);
+}
+
 void Node::P2PProtocolBytecoin::advance_transactions() {
 	if (get_peer_sync_data().top_id != m_node->m_block_chain.get_tip_bid())
 		return;
@@ -177,7 +210,7 @@ void Node::P2PProtocolBytecoin::advance_transactions() {
 }
 
 bool Node::P2PProtocolBytecoin::on_transaction_descs(const std::vector<TransactionDesc> &descs) {
-	const auto &pool   = m_node->m_block_chain.get_memory_state_transactions();
+	const auto &pool   = m_node->m_block_chain.get_tx_pool();
 	Amount minimum_fee = m_node->m_block_chain.minimum_pool_fee_per_byte(true);
 	//	Amount previous_fee_per_byte = std::numeric_limits<Amount>::max();
 	//	Hash previous_hash;
@@ -188,6 +221,7 @@ bool Node::P2PProtocolBytecoin::on_transaction_descs(const std::vector<Transacti
 			disconnect("SyncPool desc size == 0");
 			return false;
 		}
+		m_known_transactions.insert(desc.hash);
 		Amount fee_per_byte = desc.fee / desc.size;
 		//		TODO - uncomment when no 3.4.0 version is running in the wild
 		//		if (fee_per_byte > previous_fee_per_byte ||
@@ -201,12 +235,14 @@ bool Node::P2PProtocolBytecoin::on_transaction_descs(const std::vector<Transacti
 			continue;
 		if (!m_node->m_block_chain.in_chain(desc.newest_referenced_block))
 			continue;
-		if (pool.count(desc.hash) != 0 || m_node->m_block_chain.has_transaction(desc.hash))
+		if (pool.find(desc.hash) || m_node->m_block_chain.has_transaction(desc.hash))
 			continue;
 		if (m_transaction_descs.count(desc.hash) != 0)
 			continue;  // Already have
 		if (m_node->downloading_transactions.count(desc.hash) != 0)
 			continue;  // Already downloading
+		if (m_node->m_pending_pool_tids.count(desc.hash) != 0)
+			continue;  // Already checking signatures
 		request_transaction_descs.push_back(desc);
 	}
 	//	TODO - remove sort when no 3.4.0 version is running in the wild
@@ -224,6 +260,43 @@ bool Node::P2PProtocolBytecoin::on_transaction_descs(const std::vector<Transacti
 	return true;
 }
 
+void Node::P2PProtocolBytecoin::announce_transaction(const TransactionDesc &desc) {
+	if (m_known_transactions.contains(desc.hash)) {
+		m_node->m_transaction_relay_suppressed += 1;
+		return;
+	}
+	m_trickle_queue.push_back(desc);  // Becomes known only when sent, so re-added transaction is announced again
+	if (!m_trickle_timer.is_set())
+		set_trickle_timer();
+}
+
+void Node::P2PProtocolBytecoin::set_trickle_timer() {
+	// Random intervals make it harder to find origin of transaction by timing
+	const float random_factor = 0.5f + crypto::rand<uint16_t>() / 65536.0f;
+	m_trickle_timer.once(m_node->m_config.p2p_transaction_trickle_period * random_factor);
+}
+
+void Node::P2PProtocolBytecoin::on_trickle_timer() {
+	const auto &pool = m_node->m_block_chain.get_tx_pool();
+	p2p::RelayTransactions::Notify msg;
+	for (; !m_trickle_queue.empty() && msg.transaction_descs.size() < p2p::RelayTransactions::Notify::MAX_DESC_COUNT;
+	     m_trickle_queue.pop_front())
+		if (pool.find(m_trickle_queue.front().hash)) {  // Skip those already in block or evicted
+			if (m_known_transactions.insert(m_trickle_queue.front().hash))
+				msg.transaction_descs.push_back(m_trickle_queue.front());
+			else  // Peer sent it to us while waiting, or queued twice
+				m_node->m_transaction_relay_suppressed += 1;
+		}
+	if (!msg.transaction_descs.empty()) {
+		std::sort(msg.transaction_descs.begin(), msg.transaction_descs.end(), greater_fee_per_byte);
+		send(LevinProtocol::send(msg));
+		m_node->m_transaction_relay_announced += msg.transaction_descs.size();
+		m_node->m_transaction_relay_messages += 1;
+	}
+	if (!m_trickle_queue.empty())
+		set_trickle_timer();
+}
+
 void Node::P2PProtocolBytecoin::transaction_download_finished(const Hash &tid, bool success) {
 	auto tit = m_transaction_descs.find(tid);
 	if (tit == m_transaction_descs.end())
@@ -244,12 +317,21 @@ void Node::P2PProtocolBytecoin::transaction_download_finished(const Hash &tid, b
 bool Node::P2PProtocolBytecoin::on_idle(std::chrono::steady_clock::time_point idle_start) {
 	size_t added_counter                                 = 0;
 	boost::variant<ConsensusError, PreparedBlock> result = ConsensusError{""};
+	// Bad signature in chain advertised by peer, same as add_block exception below
+	auto check_signatures = [&]() -> bool {
+		if (m_node->m_block_chain.check_pending_signatures())
+			return true;
+		m_node->m_log(logging::INFO) << "on_idle add_block BAN bad signature in downloaded block";
+		disconnect("on_idle add_block BAN what=bad signature in downloaded block");
+		return false;
+	};
 	while (!m_chain.empty() && m_node->m_pow_checker.get_prepared_block(m_chain.front()->first, &result)) {
 		auto cit = m_chain.front();
 		m_node->m_log(logging::TRACE) << "on_idle prepared block " << cit->second.expected_height
 		                              << " hash=" << cit->first << " from " << get_address();
 		if (const ConsensusError *err = boost::get<ConsensusError>(&result)) {
 			m_node->m_log(logging::INFO) << "on_idle prepared block consensus error what=" << err->what();
+			m_node->m_block_chain.check_pending_signatures();
 			disconnect(std::string{"on_idle prepared what="} + err->what());
 			return false;
 		}
@@ -266,8 +348,9 @@ bool Node::P2PProtocolBytecoin::on_idle(std::chrono::steady_clock::time_point id
 		api::BlockHeader info;
 		bool add_block_result = false;
 		try {
-			add_block_result = m_node->m_block_chain.add_block(pb, &info, false, get_address().to_string());
+			add_block_result = m_node->m_block_chain.add_block(pb, &info, false, get_address().to_string(), true);
 		} catch (const std::exception &ex) {
+			m_node->m_block_chain.check_pending_signatures();
 			auto what = common::what(ex);
 			m_node->m_log(logging::INFO) << "on_idle add_block BAN expected height=" << expected_height
 			                             << " actual height=" << info.height << " wb=" << pb.bid << " what=" << what;
@@ -284,6 +367,8 @@ bool Node::P2PProtocolBytecoin::on_idle(std::chrono::steady_clock::time_point id
 			if (m_chain.empty() ||
 			    m_node->m_block_chain.get_tip_height() % m_node->m_config.download_broadcast_every_n_blocks == 0) {
 				// We do not want to broadcast too often during download
+				if (!check_signatures())
+					return false;  // We must not advertise tip which can be rolled back
 				m_node->m_log(logging::INFO)
 				    << "Added last (from batch) downloaded block height=" << info.height << " bid=" << info.hash;
 				p2p::TimedSync::Notify req;
@@ -291,7 +376,7 @@ bool Node::P2PProtocolBytecoin::on_idle(std::chrono::steady_clock::time_point id
 				    CoreSyncData{m_node->m_block_chain.get_tip_height(), m_node->m_block_chain.get_tip_bid()};
 				BinaryArray raw_msg = LevinProtocol::send(req);
 				m_node->broadcast(
-				    nullptr, raw_msg);  // nullptr - we can not always know which connection was block source
+				    nullptr, std::move(raw_msg));  // nullptr - we can not always know which connection was block source
 			}
 		}
 		added_counter += 1;
@@ -300,6 +385,8 @@ bool Node::P2PProtocolBytecoin::on_idle(std::chrono::steady_clock::time_point id
 		if (idea_ms.count() > int(1000 * m_node->m_config.max_on_idle_time))
 			break;
 	}
+	if (!check_signatures())
+		return false;
 	return !m_chain.empty() && m_node->m_pow_checker.has_prepared_block(m_chain.front()->first);
 }
 
@@ -337,7 +424,7 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_chain(p2p::GetChain::Reque
 	    req.block_ids, &msg.start_height, p2p::GetChain::Response::MAX_BLOCK_IDS);
 
 	BinaryArray raw_msg = LevinProtocol::send(msg);
-	send(std::move(raw_msg));
+	send_bulk(std::move(raw_msg));  // Serving sync must not delay relays to other peers
 }
 
 void Node::P2PProtocolBytecoin::on_msg_notify_request_chain(p2p::GetChain::Response &&req) {
@@ -379,22 +466,48 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_chain(p2p::GetChain::Respo
 }
 
 void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::Request &&req) {
-	if (req.txs.size() + req.blocks.size() != 1)
+	const bool batched = peer_has_feature(P2P_FEATURE_BATCHED_OBJECTS);
+	const size_t count = req.txs.size() + req.blocks.size();
+	if (!batched && count != 1)
 		return disconnect("Must be 1 block or 1 transaction in GetObjectsRequest");
+	if (count == 0 || count > p2p::GetObjects::MAX_BATCH_OBJECTS)
+		return disconnect("Must be 1.." + common::to_string(p2p::GetObjects::MAX_BATCH_OBJECTS) +
+		                  " objects in GetObjectsRequest");
 	p2p::GetObjects::Response msg;
+	size_t msg_size = 0;
+	// Blocks are served to syncing peers, while transactions are requested for relay
+	auto send_msg = [&]() {
+		if (req.blocks.empty())
+			send(LevinProtocol::send(msg));
+		else
+			send_bulk(LevinProtocol::send(msg));
+	};
+	// Objects are split into several responses, so that each fits in MAX_SIZE
+	auto add_size = [&](size_t size) {
+		if (msg_size != 0 && msg_size + size > p2p::GetObjects::Response::MAX_SIZE / 2) {
+			send_msg();
+			msg      = p2p::GetObjects::Response{};
+			msg_size = 0;
+		}
+		msg_size += size;
+	};
 	for (const auto &bid : req.blocks) {
 		RawBlock raw_block;
 		if (m_node->m_block_chain.get_block(bid, &raw_block)) {
+			size_t size = raw_block.block.size();
+			for (const auto &tx : raw_block.transactions)
+				size += tx.size();
+			add_size(size);
 			msg.blocks.push_back(std::move(raw_block));
 			continue;
 		}
+		add_size(sizeof(Hash));
 		msg.missed_ids.push_back(bid);
 	}
 	for (const auto &tid : req.txs) {
-		const auto &pool = m_node->m_block_chain.get_memory_state_transactions();
-		auto tit         = pool.find(tid);
-		if (tit != pool.end()) {
-			msg.txs.push_back(tit->second.binary_tx);
+		if (const TransactionPool::Record *record = m_node->m_block_chain.get_tx_pool().find(tid)) {
+			add_size(record->binary_tx.size());
+			msg.txs.push_back(record->binary_tx);
 			continue;
 		}
 		BinaryArray binary_tx;
@@ -402,18 +515,23 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::R
 		Height block_height   = 0;
 		Hash block_hash;
 		if (m_node->m_block_chain.get_transaction(tid, &binary_tx, &block_height, &block_hash, &index_in_block)) {
+			add_size(binary_tx.size());
 			msg.txs.push_back(std::move(binary_tx));
 			continue;
 		}
+		add_size(sizeof(Hash));
 		msg.missed_ids.push_back(tid);
 	}
-	send(LevinProtocol::send(msg));
+	send_msg();
 }
 
 void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::Response &&req) {
-	if (req.blocks.size() + req.txs.size() + req.missed_ids.size() != 1)
+	const size_t max_count =
+	    peer_has_feature(P2P_FEATURE_BATCHED_OBJECTS) ? size_t(p2p::GetObjects::MAX_BATCH_OBJECTS) : 1;
+	const size_t count = req.blocks.size() + req.txs.size() + req.missed_ids.size();
+	if (count == 0 || count > max_count)
 		return disconnect("Too much objects in GetObjectsResponse");
-	for (auto &&rb : req.blocks) {  // 0 or 1
+	for (auto &&rb : req.blocks) {  // 0 or 1, up to MAX_BATCH_OBJECTS if batched
 		Hash bid;
 		try {
 			BlockTemplate bheader;
@@ -432,6 +550,10 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::R
 			disconnect("Stray Block Returned");
 			return;
 		}
+		size_t size = rb.block.size();
+		for (const auto &tx : rb.transactions)
+			size += tx.size();
+		on_block_downloaded(size, cit->second.request_time);
 		cit->second.who_downloading = nullptr;
 		cit->second.preparing       = true;
 		invariant(m_downloading_block_count > 0, "");
@@ -469,7 +591,19 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::R
 			    !m_node->m_block_chain.in_chain(newest_referenced_height, tit->second.newest_referenced_block))
 				return disconnect("Lied about newest_referenced_block");
 			try {
-				if (m_node->m_block_chain.add_transaction(tid, tx, btx, true, get_address().to_string())) {
+				PoolCheckerMulticore::Job job;
+				if (m_node->m_block_chain.prepare_pool_transaction_check(tid, tx, btx, &job)) {
+					PendingPoolTransaction ptx;
+					ptx.check_id                = m_node->m_pool_checker.add_work(std::move(job));
+					ptx.tid                     = tid;
+					ptx.tx                      = std::move(tx);
+					ptx.binary_tx               = btx;
+					ptx.tip_bid                 = m_node->m_block_chain.get_tip_bid();
+					ptx.newest_referenced_block = tit->second.newest_referenced_block;
+					ptx.who                     = this;
+					m_node->m_pending_pool_tids.insert(tid);
+					m_node->m_pending_pool_transactions.push_back(std::move(ptx));
+				} else if (m_node->m_block_chain.add_transaction(tid, tx, btx, true, get_address().to_string())) {
 					TransactionDesc desc;
 					desc.hash                    = tid;
 					desc.size                    = btx.size();
@@ -522,19 +656,19 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_objects(p2p::GetObjects::R
 		m_download_transactions_timer.once(m_node->m_config.download_transaction_timeout);
 	else
 		m_download_transactions_timer.cancel();
-	if (!msg_v4.transaction_descs.empty()) {
-		// Contains exactly 1 transaction
-		BinaryArray raw_msg_v4 = LevinProtocol::send(msg_v4);
-
-		m_node->broadcast(this, raw_msg_v4);
+	for (const auto &desc : msg_v4.transaction_descs)  // 0 or 1
+		m_node->relay_transaction(desc);
+	if (!msg_v4.transaction_descs.empty())
 		m_node->advance_long_poll();
-	}
 	if (!req.blocks.empty())
 		advance_blocks();
 }
 
 void Node::P2PProtocolBytecoin::on_disconnect(const std::string &ban_reason) {
 	m_node->m_broadcast_protocols.erase(this);
+	for (auto &ptx : m_node->m_pending_pool_transactions)
+		if (ptx.who == this)
+			ptx.who = nullptr;  // Will be added or dropped without us
 
 	m_chain_request_sent = false;
 	m_chain_timer.cancel();
@@ -549,6 +683,8 @@ void Node::P2PProtocolBytecoin::on_disconnect(const std::string &ban_reason) {
 	m_chain.clear();
 	m_download_timer.cancel();
 	invariant(m_downloading_block_count == 0, "");
+	m_download_window    = m_node->m_config.download_peer_window_min;
+	m_average_block_size = 0;
 
 	m_syncpool_request_sent = false;
 	m_syncpool_timer.cancel();
@@ -565,6 +701,13 @@ void Node::P2PProtocolBytecoin::on_disconnect(const std::string &ban_reason) {
 	m_download_transactions_timer.cancel();
 	invariant(m_downloading_transaction_count == 0, "");
 
+	m_compact_block = CompactBlockReconstruction{};
+	m_compact_block_timer.cancel();
+
+	m_known_transactions.clear();
+	m_trickle_queue.clear();
+	m_trickle_timer.cancel();
+
 	P2PProtocolBasic::on_disconnect(ban_reason);
 	m_node->advance_long_poll();
 }
@@ -574,7 +717,9 @@ void Node::P2PProtocolBytecoin::on_msg_notify_request_tx_pool(p2p::SyncPool::Req
 		return disconnect("SyncPool request from <= to");
 	p2p::SyncPool::Response msg;
 	msg.transaction_descs = m_node->m_block_chain.sync_pool(req.from, req.to, p2p::SyncPool::Response::MAX_DESC_COUNT);
-	send(LevinProtocol::send(msg));
+	for (const auto &desc : msg.transaction_descs)
+		m_known_transactions.insert(desc.hash);
+	send_bulk(LevinProtocol::send(msg));
 }
 
 void Node::P2PProtocolBytecoin::on_msg_notify_request_tx_pool(p2p::SyncPool::Response &&req) {
@@ -606,11 +751,10 @@ void Node::P2PProtocolBytecoin::on_msg_notify_new_block(p2p::RelayBlock::Notify
 		return;
 	BlockTemplate header;
 	seria::from_binary(header, req.b.block);
-	const auto &pool = m_node->m_block_chain.get_memory_state_transactions();
+	const auto &pool = m_node->m_block_chain.get_tx_pool();
 	for (const auto &tid : header.transaction_hashes) {
-		auto tit = pool.find(tid);
-		if (tit != pool.end()) {
-			req.b.transactions.push_back(tit->second.binary_tx);
+		if (const TransactionPool::Record *record = pool.find(tid)) {
+			req.b.transactions.push_back(record->binary_tx);
 			continue;
 		}
 		BinaryArray binary_tx;
@@ -626,28 +770,114 @@ void Node::P2PProtocolBytecoin::on_msg_notify_new_block(p2p::RelayBlock::Notify
 		advance_chain();
 		return;
 	}
-	// We reassembled full block, can now broadcast it to V1 or V4 clients
-	PreparedBlock pb{RawBlock(req.b), m_node->m_block_chain.get_currency(), nullptr};
-	if (req.top_id != pb.bid)
-		return disconnect("RelayBlock lied about top_id");
+	// We reassembled full block
+	add_relayed_block(std::move(req.b), req.top_id, req.current_blockchain_height, false);
+}
+
+void Node::P2PProtocolBytecoin::add_relayed_block(RawBlock &&rb, const Hash &top_id, Height height, bool compact) {
+	PreparedBlock pb{std::move(rb), m_node->m_block_chain.get_currency(), nullptr};
+	if (top_id != pb.bid) {
+		if (!compact)
+			return disconnect("RelayBlock lied about top_id");
+		// Either short id collision or lie, we cannot tell
+		return on_compact_block_failed(top_id, height);
+	}
+	// Peers with compact blocks do not ban for invalid transactions, so they get block before it is validated
+	const bool header_ok = m_node->m_block_chain.check_header_for_relay(&pb);
+	if (header_ok) {
+		m_node->broadcast_new_block(
+		    this, pb.raw_block.block, pb.bid, m_node->m_block_chain.get_tip_height() + 1, true, false);
+		m_node->m_compact_blocks_relayed_early += 1;
+	}
 	api::BlockHeader info;
-	// We'll catch consensus error automatically in common handler
-	if (m_node->m_block_chain.add_block(pb, &info, false, get_address().to_string())) {
-		if (req.current_blockchain_height != info.height)
-			return disconnect("RelayBlock lied about current_blockchain_height");
-		set_peer_sync_data(CoreSyncData{info.height, pb.bid});
-		p2p::RelayBlock::Notify req_v4;
-		req_v4.b.block                   = req.b.block;
-		req_v4.top_id                    = info.hash;
-		req_v4.current_blockchain_height = info.height;
-
-		BinaryArray raw_msg_v4 = LevinProtocol::send(req_v4);
-		// TODO - broadcast to only those who do not have it
-		m_node->broadcast(this, raw_msg_v4);
-		m_node->advance_long_poll();
-	} else {
-		set_peer_sync_data(CoreSyncData{req.current_blockchain_height, pb.bid});
+	bool add_block_result = false;
+	try {
+		add_block_result = m_node->m_block_chain.add_block(pb, &info, false, get_address().to_string());
+	} catch (const ConsensusError &ex) {
+		if (!compact || !header_ok)
+			throw;  // We'll catch consensus error automatically in common handler
+		// Sender could relay it before validation, like we do
+		m_node->m_log(logging::INFO) << "RelayCompactBlock " << pb.bid << " from " << get_address()
+		                             << " failed validation what=" << common::what(ex);
+		return;
+	}
+	if (!add_block_result) {
+		set_peer_sync_data(CoreSyncData{height, pb.bid});
+		return;
+	}
+	if (height != info.height)
+		return disconnect(compact ? "RelayCompactBlock lied about current_blockchain_height"
+		                          : "RelayBlock lied about current_blockchain_height");
+	set_peer_sync_data(CoreSyncData{info.height, pb.bid});
+	m_node->broadcast_new_block(this, pb.raw_block.block, info.hash, info.height, !header_ok, true);
+	m_node->advance_long_poll();
+}
+
+void Node::P2PProtocolBytecoin::on_msg_notify_new_compact_block(p2p::RelayCompactBlock::Notify &&req) {
+	if (!peer_has_feature(P2P_FEATURE_COMPACT_BLOCKS))
+		return disconnect("RelayCompactBlock without feature");
+	if (m_node->m_block_chain.has_header(req.top_id))
+		return;
+	CompactBlockReconstruction cb;
+	seria::from_binary(cb.header, req.header);
+	if (!cb.header.transaction_hashes.empty())
+		return disconnect("RelayCompactBlock header with transaction hashes");
+	m_node->m_compact_blocks_received += 1;
+	cb.msg = std::move(req);
+	cb.fill(ShortIdMap(m_node->m_block_chain.get_tx_pool(), cb.msg.get_short_id_key()));
+	if (cb.missing.empty()) {
+		m_node->m_compact_blocks_reconstructed += 1;
+		return add_relayed_block(cb.move_raw_block(), cb.msg.top_id, cb.msg.current_blockchain_height, true);
 	}
+	m_node->m_compact_blocks_incomplete += 1;
+	m_node->m_compact_blocks_missing_transactions += cb.missing.size();
+	p2p::GetBlockTransactions::Request msg;
+	msg.block_id    = cb.msg.top_id;
+	msg.indexes     = cb.missing;
+	m_compact_block = std::move(cb);  // Replaces previous one, if any, its response will be ignored
+	m_compact_block_timer.once(m_node->m_config.download_block_timeout);
+	send(LevinProtocol::send(msg));
+}
+
+void Node::P2PProtocolBytecoin::on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Request &&req) {
+	if (!peer_has_feature(P2P_FEATURE_COMPACT_BLOCKS))
+		return disconnect("GetBlockTransactions without feature");
+	p2p::GetBlockTransactions::Response msg;
+	msg.block_id = req.block_id;
+	RawBlock rb;
+	if (m_node->m_block_chain.get_block(req.block_id, &rb)) {
+		if (!req.indexes_valid(rb.transactions.size()))
+			return disconnect("GetBlockTransactions wrong indexes");
+		for (auto index : req.indexes)
+			msg.transactions.push_back(std::move(rb.transactions[index]));
+	}
+	send(LevinProtocol::send(msg));
+}
+
+void Node::P2PProtocolBytecoin::on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Response &&req) {
+	if (m_compact_block.msg.top_id == Hash{} || req.block_id != m_compact_block.msg.top_id)
+		return;  // After timeout or newer RelayCompactBlock
+	m_compact_block_timer.cancel();
+	CompactBlockReconstruction cb = std::move(m_compact_block);
+	m_compact_block               = CompactBlockReconstruction{};
+	if (req.transactions.size() != cb.missing.size())  // Peer has no such block anymore
+		return on_compact_block_failed(cb.msg.top_id, cb.msg.current_blockchain_height);
+	if (!cb.add_missing(std::move(req.transactions)))
+		return disconnect("GetBlockTransactions returned wrong transaction");
+	add_relayed_block(cb.move_raw_block(), cb.msg.top_id, cb.msg.current_blockchain_height, true);
+}
+
+void Node::P2PProtocolBytecoin::on_compact_block_timer() {
+	const Hash top_id   = m_compact_block.msg.top_id;
+	const Height height = m_compact_block.msg.current_blockchain_height;
+	m_compact_block     = CompactBlockReconstruction{};
+	on_compact_block_failed(top_id, height);
+}
+
+void Node::P2PProtocolBytecoin::on_compact_block_failed(const Hash &top_id, Height height) {
+	m_node->m_compact_blocks_failed += 1;
+	set_peer_sync_data(CoreSyncData{height, top_id});
+	advance_chain();
 }
 
 void Node::P2PProtocolBytecoin::on_msg_notify_new_transactions(p2p::RelayTransactions::Notify &&req) {
@@ -662,12 +892,12 @@ void Node::P2PProtocolBytecoin::on_msg_notify_checkpoint(p2p::Checkpoint::Notify
 	m_node->m_log(logging::INFO) << "p2p::Checkpoint::Notify height=" << req.height << " hash=" << req.hash
 	                             << " key_id=" << req.key_id << " counter=" << req.counter;
 	BinaryArray raw_msg = LevinProtocol::send(req);
-	m_node->broadcast(nullptr, raw_msg);  // nullptr, not this - so a sender sees "reflection" of message
+	m_node->broadcast(nullptr, std::move(raw_msg));  // nullptr, not this - so a sender sees "reflection" of message
 	// TODO - investigate reason for TimedSync broadcast here
 	p2p::TimedSync::Notify ts_req;
 	ts_req.payload_data = CoreSyncData{m_node->m_block_chain.get_tip_height(), m_node->m_block_chain.get_tip_bid()};
 	raw_msg             = LevinProtocol::send(ts_req);
-	m_node->broadcast(nullptr, raw_msg);
+	m_node->broadcast(nullptr, std::move(raw_msg));
 	m_node->advance_long_poll();
 }
 
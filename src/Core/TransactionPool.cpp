@@ -0,0 +1,159 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "TransactionPool.hpp"
+#include <algorithm>
+#include "CryptoNoteTools.hpp"
+#include "seria/BinaryInputStream.hpp"
+
+using namespace cn;
+
+Transaction TransactionPool::Record::get_tx() const {
+	if (tx)
+		return *tx;
+	Transaction result;
+	seria::from_binary(result, binary_tx);
+	return result;
+}
+
+const TransactionPool::Record *TransactionPool::find(const Hash &tid) const {
+	auto tit = m_by_tid.find(tid);
+	return tit == m_by_tid.end() ? nullptr : &m_records[tit->second];
+}
+
+const TransactionPool::Record &TransactionPool::at(const Hash &tid) const {
+	const Record *record = find(tid);
+	invariant(record, "Transaction pool corrupted");
+	return *record;
+}
+
+const Hash *TransactionPool::find_keyimage(const KeyImage &ki) const {
+	auto kit = m_by_keyimage.find(ki);
+	return kit == m_by_keyimage.end() ? nullptr : &kit->second;
+}
+
+const TransactionPool::Record &TransactionPool::insert(const Hash &tid, const Transaction &tx,
+    const BinaryArray &binary_tx, Amount fee, Timestamp timestamp, const Hash &newest_referenced_block) {
+	size_t slot = m_records.size();
+	if (m_free_records.empty())
+		m_records.emplace_back();
+	else {
+		slot = m_free_records.back();
+		m_free_records.pop_back();
+	}
+	Record &record = m_records[slot];
+	record.tid     = tid;
+	record.binary_tx.assign(binary_tx.begin(), binary_tx.end());
+	if (!m_compact)
+		record.tx.reset(new Transaction(tx));
+	for (const auto &input : tx.inputs)
+		if (const auto *in = boost::get<InputKey>(&input))
+			record.key_images.push_back(in->key_image);
+	record.amount                  = get_tx_sum_outputs(tx);
+	record.fee                     = fee;
+	record.timestamp               = timestamp;
+	record.newest_referenced_block = newest_referenced_block;
+
+	bool all_inserted = m_by_tid.insert(std::make_pair(tid, slot)).second;
+	for (const auto &ki : record.key_images)
+		if (!m_by_keyimage.insert(std::make_pair(ki, tid)).second)
+			all_inserted = false;
+	if (!m_by_fee.insert(std::make_pair(record.fee_per_byte(), tid)).second)
+		all_inserted = false;
+	invariant(all_inserted, "Transaction pool insert of duplicate tid or key image");
+	m_total_size += record.binary_tx.size();
+	return record;
+}
+
+bool TransactionPool::erase(const Hash &tid) {
+	auto tit = m_by_tid.find(tid);
+	if (tit == m_by_tid.end())
+		return false;
+	const size_t slot = tit->second;
+	Record &record    = m_records[slot];
+	bool all_erased   = m_by_fee.erase(std::make_pair(record.fee_per_byte(), tid)) == 1;
+	for (const auto &ki : record.key_images)
+		if (m_by_keyimage.erase(ki) != 1)
+			all_erased = false;
+	invariant(all_erased, "Transaction pool failed to erase everything");
+	m_total_size -= record.binary_tx.size();
+	m_by_tid.erase(tit);
+	record = Record{};  // Release memory, slot is reused by next insert
+	m_free_records.push_back(slot);
+	return true;
+}
+
+void TransactionPool::clear() {
+	m_records.clear();
+	m_free_records.clear();
+	m_by_tid.clear();
+	m_by_keyimage.clear();
+	m_by_fee.clear();
+	m_total_size = 0;
+}
+
+TransactionPool::Selection TransactionPool::select_greedy(size_t max_size) const {
+	Selection result;
+	for (auto fit = m_by_fee.rbegin(); fit != m_by_fee.rend(); ++fit) {
+		const Record &record = at(fit->second);
+		if (result.size + record.binary_tx.size() > max_size)
+			continue;
+		result.size += record.binary_tx.size();
+		result.fee += record.fee;
+		result.tids.push_back(record.tid);
+	}
+	return result;
+}
+
+TransactionPool::Selection TransactionPool::select_knapsack(size_t max_size) const {
+	std::vector<const Record *> records;  // most expensive first
+	records.reserve(m_by_fee.size());
+	for (auto fit = m_by_fee.rbegin(); fit != m_by_fee.rend(); ++fit)
+		records.push_back(&at(fit->second));
+	size_t break_index = 0, prefix_size = 0;
+	for (; break_index != records.size() && prefix_size + records[break_index]->binary_tx.size() <= max_size;
+	     ++break_index)
+		prefix_size += records[break_index]->binary_tx.size();
+	Selection greedy = select_greedy(max_size);
+	if (break_index == records.size())
+		return greedy;  // Everything fits
+
+	// Transactions before core are taken, knapsack decides on core, then transactions after core fill the rest
+	const size_t core_begin = break_index > KNAPSACK_ITEMS / 2 ? break_index - KNAPSACK_ITEMS / 2 : 0;
+	const size_t core_end   = std::min(records.size(), core_begin + KNAPSACK_ITEMS);
+	Selection result;
+	for (size_t i = 0; i != core_begin; ++i) {
+		result.size += records[i]->binary_tx.size();
+		result.fee += records[i]->fee;
+		result.tids.push_back(records[i]->tid);
+	}
+	const size_t capacity = max_size - result.size;
+	const size_t unit     = std::max<size_t>(1, (capacity + KNAPSACK_BUCKETS - 1) / KNAPSACK_BUCKETS);
+	const size_t buckets  = capacity / unit;  // Sizes rounded up, so solution always fits
+	std::vector<Amount> best(buckets + 1, 0);
+	std::vector<std::vector<bool>> taken(core_end - core_begin, std::vector<bool>(buckets + 1, false));
+	for (size_t i = core_begin; i != core_end; ++i) {
+		const size_t weight = (records[i]->binary_tx.size() + unit - 1) / unit;  // binary_tx is never empty
+		for (size_t c = buckets; c >= weight; --c)
+			if (best[c - weight] + records[i]->fee > best[c]) {
+				best[c]                  = best[c - weight] + records[i]->fee;
+				taken[i - core_begin][c] = true;
+			}
+	}
+	std::vector<bool> in_core_result(core_end - core_begin, false);
+	for (size_t i = core_end, c = buckets; i-- != core_begin;)
+		if (taken[i - core_begin][c]) {
+			in_core_result[i - core_begin] = true;
+			c -= (records[i]->binary_tx.size() + unit - 1) / unit;
+		}
+	for (size_t i = core_begin; i != records.size(); ++i) {
+		if (i < core_end && !in_core_result[i - core_begin])
+			continue;
+		if (result.size + records[i]->binary_tx.size() > max_size)
+			continue;  // Only for transactions after core
+		result.size += records[i]->binary_tx.size();
+		result.fee += records[i]->fee;
+		result.tids.push_back(records[i]->tid);
+	}
+	return result.fee > greedy.fee ? result : greedy;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "CryptoNote.hpp"
+
+namespace cn {
+
+// Pool records live in slab (vector with free list), indexes refer to slots. One index per key - tid, key image
+// and fee per byte, the latter ordered for eviction of cheapest, template packing and sync_pool.
+// In compact mode parsed transaction is not kept, get_tx() parses binary_tx on demand
+class TransactionPool {
+public:
+	struct Record {
+		Hash tid;
+		BinaryArray binary_tx;
+		std::unique_ptr<Transaction> tx;  // nullptr in compact mode
+		std::vector<KeyImage> key_images;
+		Amount amount       = 0;
+		Amount fee          = 0;
+		Timestamp timestamp = 0;
+		Hash newest_referenced_block;
+
+		Amount fee_per_byte() const { return fee / binary_tx.size(); }
+		Transaction get_tx() const;
+	};
+	typedef std::set<std::pair<Amount, Hash>> FeeIndex;  // fee_per_byte, tid, cheapest first
+	struct Selection {
+		std::vector<Hash> tids;  // In fee per byte order, most expensive first
+		size_t size = 0;
+		Amount fee  = 0;
+	};
+	// Knapsack is solved only for KNAPSACK_ITEMS transactions around the first one not fitting, with sizes
+	// rounded up to max_size / KNAPSACK_BUCKETS, so its cost is bounded whatever the pool size
+	enum { KNAPSACK_ITEMS = 64, KNAPSACK_BUCKETS = 4096 };
+
+	explicit TransactionPool(bool compact) : m_compact(compact) {}
+
+	const Record *find(const Hash &tid) const;  // nullptr if not in pool
+	const Record &at(const Hash &tid) const;
+	const Hash *find_keyimage(const KeyImage &ki) const;  // tid of pool transaction spending ki
+	const FeeIndex &get_fee_index() const { return m_by_fee; }
+
+	// Transactions for block template with total size not above max_size
+	Selection select_greedy(size_t max_size) const;    // By fee per byte, skipping those not fitting
+	Selection select_knapsack(size_t max_size) const;  // Never worse than greedy
+
+	// Caller must remove conflicting transactions first
+	const Record &insert(const Hash &tid, const Transaction &tx, const BinaryArray &binary_tx, Amount fee,
+	    Timestamp timestamp, const Hash &newest_referenced_block);
+	bool erase(const Hash &tid);  // false if not in pool
+	void clear();
+
+	bool empty() const { return m_by_tid.empty(); }
+	size_t size() const { return m_by_tid.size(); }
+	size_t get_total_size() const { return m_total_size; }  // Sum of binary sizes
+	bool is_compact() const { return m_compact; }
+
+private:
+	bool m_compact;
+	std::vector<Record> m_records;
+	std::vector<size_t> m_free_records;
+	std::unordered_map<Hash, size_t> m_by_tid;
+	std::unordered_map<KeyImage, Hash> m_by_keyimage;
+	FeeIndex m_by_fee;
+	size_t m_total_size = 0;
+};
+
+}  // namespace cn
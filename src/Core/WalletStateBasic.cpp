@@ -111,7 +111,7 @@ WalletStateBasic::WalletStateBasic(
 			size_t from   = height < max_undo_height ? 0 : height - max_undo_height;
 			size_t added  = 0;
 			for (; from != height; from += 1) {
-				auto key = INDEX_HEIGHT_to_STATE + common::write_varint_sqlite4(from + 1);
+				auto key = DB::Key(INDEX_HEIGHT_to_STATE).append_varint(from + 1);
 				BinaryArray ba;
 				if (!m_db.get(key, ba)) {
 					m_db.put(key, seria::to_binary(UndoMap{}), true);
@@ -236,22 +236,22 @@ void WalletStateBasic::push_chain(const api::BlockHeader &header) {
 		                      << " header.height=" << header.height;
 	}
 	BinaryArray ba = seria::to_binary(header);
-	m_db.put(INDEX_HEIGHT_to_HEADER + common::write_varint_sqlite4(m_chain_height), ba, true);
+	m_db.put(DB::Key(INDEX_HEIGHT_to_HEADER).append_varint(m_chain_height), ba, true);
 	m_tip = header;
 	save_db_state(m_chain_height, current_undo_map);
 	current_undo_map.clear();
 	if (m_chain_height < max_undo_height)
 		return;
-	m_db.del(INDEX_HEIGHT_to_STATE + common::write_varint_sqlite4(m_chain_height - max_undo_height), false);
+	m_db.del(DB::Key(INDEX_HEIGHT_to_STATE).append_varint(m_chain_height - max_undo_height), false);
 	DB::Cursor cur =
 	    m_db.begin(INDEX_ADDRESS_HEIGHT_TID + "/" + common::write_varint_sqlite4(m_chain_height - max_undo_height));
 	if (!cur.end())  // Have transactions at this height
 		return;
 	DB::Cursor cur2 =
-	    m_db.begin(UNLOCKED_INDEX_REALHE_GI_to_OUTPUT + common::write_varint_sqlite4(m_chain_height - max_undo_height));
+	    m_db.begin(DB::Key(UNLOCKED_INDEX_REALHE_GI_to_OUTPUT).append_varint(m_chain_height - max_undo_height));
 	if (!cur2.end())  // Have unlocked block at this height
 		return;
-	m_db.del(INDEX_HEIGHT_to_HEADER + common::write_varint_sqlite4(m_chain_height - max_undo_height), false);
+	m_db.del(DB::Key(INDEX_HEIGHT_to_HEADER).append_varint(m_chain_height - max_undo_height), false);
 }
 
 bool WalletStateBasic::pop_chain() {
@@ -261,7 +261,7 @@ bool WalletStateBasic::pop_chain() {
 		clear_db(false);
 		return false;
 	}
-	m_db.del(INDEX_HEIGHT_to_HEADER + common::write_varint_sqlite4(m_chain_height), true);
+	m_db.del(DB::Key(INDEX_HEIGHT_to_HEADER).append_varint(m_chain_height), true);
 	m_chain_height -= 1;
 	if (read_chain(m_chain_height, &m_tip))
 		return true;
@@ -270,8 +270,8 @@ bool WalletStateBasic::pop_chain() {
 }
 
 bool WalletStateBasic::read_chain(Height height, api::BlockHeader *header) const {
-	BinaryArray rb;
-	if (!m_db.get(INDEX_HEIGHT_to_HEADER + common::write_varint_sqlite4(height), rb))
+	DB::Value rb;
+	if (!m_db.get(DB::Key(INDEX_HEIGHT_to_HEADER).append_varint(height), rb))
 		return false;
 	seria::from_binary(*header, rb);
 	return true;
@@ -334,13 +334,13 @@ void WalletStateBasic::del_with_undo(const std::string &key, bool mustexist) {
 void WalletStateBasic::save_db_state(Height height, const UndoMap &undo_map) {
 	//	if (undo_map.empty())
 	//		return;
-	const auto key            = INDEX_HEIGHT_to_STATE + common::write_varint_sqlite4(height);
+	const auto key            = DB::Key(INDEX_HEIGHT_to_STATE).append_varint(height);
 	common::BinaryArray value = seria::to_binary(undo_map);
 	m_db.put(key, value, true);
 }
 
 bool WalletStateBasic::undo_db_state(Height height) {
-	const auto key = INDEX_HEIGHT_to_STATE + common::write_varint_sqlite4(height);
+	const auto key = DB::Key(INDEX_HEIGHT_to_STATE).append_varint(height);
 	common::BinaryArray value;
 	if (!m_db.get(key, value))
 		return false;
@@ -725,7 +725,7 @@ std::vector<api::Output> WalletStateBasic::api_get_locked_or_unconfirmed_unspent
 
 api::Balance WalletStateBasic::get_balance(const std::string &address, Height confirmed_height) const {
 	auto bakey = INDEX_ADDRESS_to_BALANCE + address;
-	BinaryArray ba;
+	DB::Value ba;
 	api::Balance balance;
 	if (m_db.get(bakey, ba))
 		seria::from_binary(balance, ba);
@@ -772,7 +772,7 @@ api::Balance WalletStateBasic::get_balance(const std::string &address, Height co
 }
 
 bool WalletStateBasic::has_transaction(Hash tid) const {
-	auto cur = m_db.begin(INDEX_TID_to_TRANSACTIONS + DB::to_binary_key(tid.data, sizeof(tid.data)));
+	auto cur = m_db.begin(DB::Key(INDEX_TID_to_TRANSACTIONS).append(tid.data, sizeof(tid.data)));
 	return !cur.end();
 	//	TODO - remove cursor after upgrade of WalletState db
 	//	auto trkey = INDEX_TID_to_TRANSACTIONS + DB::to_binary_key(tid.data, sizeof(tid.data));
@@ -786,7 +786,7 @@ bool WalletStateBasic::get_transaction(Hash tid, TransactionPrefix *tx, api::Tra
 	//	if (!m_db.get(trkey, data))
 	//		return false;
 	//	TODO - remove cursor after upgrade of WalletState db
-	auto cur = m_db.begin(INDEX_TID_to_TRANSACTIONS + DB::to_binary_key(tid.data, sizeof(tid.data)));
+	auto cur = m_db.begin(DB::Key(INDEX_TID_to_TRANSACTIONS).append(tid.data, sizeof(tid.data)));
 	if (cur.end())
 		return false;
 	TransactionIndexValue pa;
@@ -855,7 +855,7 @@ std::vector<api::Transfer> WalletStateBasic::api_get_unlocked_transfers_legacy(
 void WalletStateBasic::modify_balance(const api::Output &output, int locked_op, int spendable_op) {
 	auto bakey  = INDEX_ADDRESS_to_BALANCE + output.address;
 	auto bakey2 = INDEX_ADDRESS_to_BALANCE;
-	BinaryArray ba;
+	DB::Value ba;
 	api::Balance balance;
 	api::Balance balance2;
 	if (m_db.get(bakey, ba))
@@ -944,7 +944,7 @@ void WalletStateBasic::unlock(Height now_height, Timestamp now) {
 bool WalletStateBasic::read_from_unspent_index(const HeightGi &value, api::Output *output) const {
 	auto keyun = INDEX_HE_GI_to_OUTPUT + common::write_varint_sqlite4(value.height) +
 	             common::write_varint_sqlite4(value.global_index);
-	BinaryArray ba;
+	DB::Value ba;
 	if (!m_db.get(keyun, ba))
 		return false;
 	seria::from_binary(*output, ba);
@@ -1006,7 +1006,7 @@ void WalletStateBasic::remove_from_unspent_index(const api::Output &output) {
 
 bool WalletStateBasic::read_by_keyimage(const KeyImage &ki, HeightGi *value) const {
 	auto keyun = INDEX_KEYIMAGE_to_HE_GI + DB::to_binary_key(ki.data, sizeof(ki.data));
-	BinaryArray ba;
+	DB::Value ba;
 	if (!m_db.get(keyun, ba))
 		return false;
 	seria::from_binary(*value, ba);
@@ -5,6 +5,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 //#include <cstring>
 //#include <initializer_list>
@@ -121,6 +122,9 @@ private:
 typedef std::vector<uint8_t> BinaryArray;
 // typedef BinaryArrayImpl BinaryArray; - Safety over performance
 
+// Immutable data referenced from several places, for example the same message in send queues of many peers
+typedef std::shared_ptr<const BinaryArray> SharedBinaryArray;
+
 template<class It>
 inline BinaryArray::iterator append(BinaryArray &ba, It be, It en) {
 	return ba.insert(ba.end(), be, en);
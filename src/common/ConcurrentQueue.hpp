@@ -0,0 +1,115 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace common {
+
+inline size_t round_up_to_power_of_2(size_t value) {
+	size_t result = 1;
+	while (result < value)
+		result *= 2;
+	return result;
+}
+
+// Bounded lock-free queue for any number of producers and consumers (D. Vyukov's algorithm).
+// Each cell has sequence number telling whether it is ready for push or pop in current lap.
+// Capacity is rounded up to power of 2. Value is moved from only if try_push succeeds.
+template<typename T>
+class BoundedQueue {
+	struct Cell {
+		std::atomic<size_t> sequence{0};
+		T value;
+	};
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	char m_pad0[64];  // push and pop positions are modified by different threads
+	std::atomic<size_t> m_push_pos{0};
+	char m_pad1[64];
+	std::atomic<size_t> m_pop_pos{0};
+	char m_pad2[64];
+
+public:
+	explicit BoundedQueue(size_t capacity)
+	    : m_cells(new Cell[round_up_to_power_of_2(capacity)]), m_mask(round_up_to_power_of_2(capacity) - 1) {
+		for (size_t i = 0; i <= m_mask; ++i)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	size_t capacity() const { return m_mask + 1; }
+	bool try_push(T &&value) {
+		size_t pos = m_push_pos.load(std::memory_order_relaxed);
+		while (true) {
+			Cell &cell       = m_cells[pos & m_mask];
+			const size_t seq = cell.sequence.load(std::memory_order_acquire);
+			if (seq == pos) {
+				if (m_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = std::move(value);
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (seq < pos)
+				return false;  // full
+			else
+				pos = m_push_pos.load(std::memory_order_relaxed);
+		}
+	}
+	bool try_pop(T *value) {
+		size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+		while (true) {
+			Cell &cell       = m_cells[pos & m_mask];
+			const size_t seq = cell.sequence.load(std::memory_order_acquire);
+			if (seq == pos + 1) {
+				if (m_pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					*value     = std::move(cell.value);
+					cell.value = T{};  // Do not keep resources of popped value
+					cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (seq < pos + 1)
+				return false;  // empty
+			else
+				pos = m_pop_pos.load(std::memory_order_relaxed);
+		}
+	}
+};
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread
+template<typename T>
+class SpscRing {
+	std::unique_ptr<T[]> m_cells;
+	size_t m_mask;
+	char m_pad0[64];
+	std::atomic<size_t> m_push_pos{0};  // written by producer only
+	char m_pad1[64];
+	std::atomic<size_t> m_pop_pos{0};  // written by consumer only
+	char m_pad2[64];
+
+public:
+	explicit SpscRing(size_t capacity)
+	    : m_cells(new T[round_up_to_power_of_2(capacity)]), m_mask(round_up_to_power_of_2(capacity) - 1) {}
+	size_t capacity() const { return m_mask + 1; }
+	bool try_push(T &&value) {
+		const size_t pos = m_push_pos.load(std::memory_order_relaxed);
+		if (pos - m_pop_pos.load(std::memory_order_acquire) > m_mask)
+			return false;  // full
+		m_cells[pos & m_mask] = std::move(value);
+		m_push_pos.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	bool try_pop(T *value) {
+		const size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+		if (pos == m_push_pos.load(std::memory_order_acquire))
+			return false;  // empty
+		*value                = std::move(m_cells[pos & m_mask]);
+		m_cells[pos & m_mask] = T{};
+		m_pop_pos.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+}  // namespace common
@@ -0,0 +1,85 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace common {
+
+// Map with least-recently-used eviction. Each entry has cost set by caller,
+// so max_cost can be either count of entries or approximate size in bytes.
+// Pointers returned by find/insert stay valid until entry is evicted or erased.
+template<typename K, typename V, typename H = std::hash<K>>
+class LruCache {
+	struct Item {
+		K key;
+		V value;
+		size_t cost;
+	};
+	typedef std::list<Item> Items;
+	Items m_items;  // most recently used in front
+	std::unordered_map<K, typename Items::iterator, H> m_index;
+	size_t m_max_cost   = 0;
+	size_t m_total_cost = 0;
+
+	size_t m_hits      = 0;
+	size_t m_misses    = 0;
+	size_t m_evictions = 0;
+
+public:
+	explicit LruCache(size_t max_cost) : m_max_cost(max_cost) {}
+
+	V *find(const K &key) {
+		auto iit = m_index.find(key);
+		if (iit == m_index.end()) {
+			m_misses += 1;
+			return nullptr;
+		}
+		m_hits += 1;
+		m_items.splice(m_items.begin(), m_items, iit->second);
+		return &iit->second->value;
+	}
+	// Replaces existing value. Evicts least recently used entries, but never just inserted one
+	V *insert(const K &key, V &&value, size_t cost) {
+		erase(key);
+		m_items.push_front(Item{key, std::move(value), cost});
+		m_index.insert(std::make_pair(key, m_items.begin()));
+		m_total_cost += cost;
+		while (m_total_cost > m_max_cost && m_items.size() > 1) {
+			m_total_cost -= m_items.back().cost;
+			m_index.erase(m_items.back().key);
+			m_items.pop_back();
+			m_evictions += 1;
+		}
+		return &m_items.front().value;
+	}
+	bool erase(const K &key) {
+		auto iit = m_index.find(key);
+		if (iit == m_index.end())
+			return false;
+		m_total_cost -= iit->second->cost;
+		m_items.erase(iit->second);
+		m_index.erase(iit);
+		return true;
+	}
+	void clear() {
+		m_index.clear();
+		m_items.clear();
+		m_total_cost = 0;
+	}
+	void set_max_cost(size_t max_cost) { m_max_cost = max_cost; }
+
+	size_t size() const { return m_items.size(); }
+	size_t get_total_cost() const { return m_total_cost; }
+	size_t get_max_cost() const { return m_max_cost; }
+	size_t get_hits() const { return m_hits; }
+	size_t get_misses() const { return m_misses; }
+	size_t get_evictions() const { return m_evictions; }
+};
+
+}  // namespace common
@@ -76,6 +76,7 @@ inline uint64_t read_varint_sqlite4(const char *&begin, const char *end) {
 
 uint64_t read_varint_sqlite4(const std::string &str);
 std::string write_varint_sqlite4(uint64_t val);
+size_t write_varint_sqlite4(unsigned char *buf, uint64_t val);  // buf must fit 9 bytes, returns bytes written
 
 template<class T>
 T uint_be_from_bytes(const unsigned char *buf, size_t si) {
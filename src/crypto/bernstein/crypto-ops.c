@@ -117,11 +117,16 @@ static void ge_p3_0(ge_p3 *h) {
 }
 
 void ge_double_scalarmult_base_vartime3(ge_p3 *rr, const struct cryptoEllipticCurveScalar *aa, const ge_p3 *A, const struct cryptoEllipticCurveScalar *bb) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+  ge_dsm_precomp(&Ai, A);
+  ge_double_scalarmult_base_precomp_vartime3(rr, aa, &Ai, bb);
+}
+
+void ge_double_scalarmult_base_precomp_vartime3(ge_p3 *rr, const struct cryptoEllipticCurveScalar *aa, const ge_dsmp *Ai, const struct cryptoEllipticCurveScalar *bb) {
 	const unsigned char * a = aa->data;
 	const unsigned char * b = bb->data;
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
@@ -129,7 +134,6 @@ void ge_double_scalarmult_base_vartime3(ge_p3 *rr, const struct cryptoEllipticCu
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(&Ai, A);
 
   ge_p2_0(&r);
   ge_p3_0(rr); // We will not enter "for" below for some inputs
@@ -143,10 +147,10 @@ void ge_double_scalarmult_base_vartime3(ge_p3 *rr, const struct cryptoEllipticCu
 
     if (aslide[i] > 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_add(&t, &u, &Ai.ca[aslide[i]/2]);
+      ge_add(&t, &u, &Ai->ca[aslide[i]/2]);
     } else if (aslide[i] < 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_sub(&t, &u, &Ai.ca[(-aslide[i])/2]);
+      ge_sub(&t, &u, &Ai->ca[(-aslide[i])/2]);
     }
 
     if (bslide[i] > 0) {
@@ -883,11 +887,16 @@ void ge_scalarmult3(ge_p3 *rr, const struct cryptoEllipticCurveScalar *a, const
 }
 
 void ge_double_scalarmult_precomp_vartime3(ge_p3 *rr, const struct cryptoEllipticCurveScalar *aa, const ge_p3 *A, const struct cryptoEllipticCurveScalar *bb, const ge_dsmp *Bi) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+  ge_dsm_precomp(&Ai, A);
+  ge_double_scalarmult_precomp2_vartime3(rr, aa, &Ai, bb, Bi);
+}
+
+void ge_double_scalarmult_precomp2_vartime3(ge_p3 *rr, const struct cryptoEllipticCurveScalar *aa, const ge_dsmp *Ai, const struct cryptoEllipticCurveScalar *bb, const ge_dsmp *Bi) {
 	const unsigned char * a = aa->data;
 	const unsigned char * b = bb->data;
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
@@ -895,7 +904,6 @@ void ge_double_scalarmult_precomp_vartime3(ge_p3 *rr, const struct cryptoEllipti
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(&Ai, A);
 
   ge_p2_0(&r);
   ge_p3_0(rr); // We will not enter "for" below for some inputs
@@ -909,10 +917,10 @@ void ge_double_scalarmult_precomp_vartime3(ge_p3 *rr, const struct cryptoEllipti
 
     if (aslide[i] > 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_add(&t, &u, &Ai.ca[aslide[i]/2]);
+      ge_add(&t, &u, &Ai->ca[aslide[i]/2]);
     } else if (aslide[i] < 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_sub(&t, &u, &Ai.ca[(-aslide[i])/2]);
+      ge_sub(&t, &u, &Ai->ca[(-aslide[i])/2]);
     }
 
     if (bslide[i] > 0) {
@@ -56,6 +56,7 @@ typedef struct {
 void ge_dsm_precomp(ge_dsmp * r, const ge_p3 *s);
 //void ge_double_scalarmult_base_vartime(ge_p2 *, const struct cryptoEllipticCurveScalar *, const ge_p3 *, const struct cryptoEllipticCurveScalar *);
 void ge_double_scalarmult_base_vartime3(ge_p3 *, const struct cryptoEllipticCurveScalar *, const ge_p3 *, const struct cryptoEllipticCurveScalar *);
+void ge_double_scalarmult_base_precomp_vartime3(ge_p3 *, const struct cryptoEllipticCurveScalar *, const ge_dsmp *, const struct cryptoEllipticCurveScalar *);
 
 /* From ge_frombytes.c, modified */
 
@@ -108,6 +109,7 @@ void ge_scalarmult3(ge_p3 *, const struct cryptoEllipticCurveScalar *, const ge_
 
 //void ge_double_scalarmult_precomp_vartime(ge_p2 *, const struct cryptoEllipticCurveScalar *, const ge_p3 *, const struct cryptoEllipticCurveScalar *, const ge_dsmp *);
 void ge_double_scalarmult_precomp_vartime3(ge_p3 *r, const struct cryptoEllipticCurveScalar *aa, const ge_p3 *A, const struct cryptoEllipticCurveScalar *bb, const ge_dsmp *Bi);
+void ge_double_scalarmult_precomp2_vartime3(ge_p3 *r, const struct cryptoEllipticCurveScalar *aa, const ge_dsmp *Ai, const struct cryptoEllipticCurveScalar *bb, const ge_dsmp *Bi);
 
 int ge_check_subgroup_precomp_vartime(const ge_dsmp *);
 void ge_mul8_p2(ge_p1p1 *, const ge_p2 *);
@@ -259,32 +259,120 @@ RingSignature generate_ring_signature(const Hash &prefix_hash, const KeyImage &i
 	return sig;
 }
 
-bool check_ring_signature(
-    const Hash &prefix_hash, const KeyImage &image, const std::vector<PublicKey> &pubs, const RingSignature &sig) {
+PreparedOutputKey::PreparedOutputKey(const PublicKey &key)
+    : key(key), point(key), hash_point(hash_to_good_point_p3(key)) {
+	ge_dsm_precomp(&point_dsm, &point.p3);
+	ge_dsm_precomp(&hash_point_dsm, &hash_point.p3);
+}
+
+// Ring members are either prepared by caller (usually cached) or prepared here one at a time when needed,
+// so that errors are found in the same order whichever is used
+class RingKeys {
+	const std::vector<PublicKey> *m_pubs                     = nullptr;
+	const std::vector<const PreparedOutputKey *> *m_prepared = nullptr;
+	std::unique_ptr<PreparedOutputKey> m_tmp;
+
+public:
+	explicit RingKeys(const std::vector<PublicKey> &pubs) : m_pubs(&pubs) {}
+	explicit RingKeys(const std::vector<const PreparedOutputKey *> &prepared) : m_prepared(&prepared) {}
+	size_t size() const { return m_pubs ? m_pubs->size() : m_prepared->size(); }
+	const PublicKey &key(size_t i) const { return m_pubs ? m_pubs->at(i) : m_prepared->at(i)->key; }
+	const PreparedOutputKey &prepare(size_t i) {  // valid until next call
+		if (m_prepared)
+			return *m_prepared->at(i);
+		m_tmp = std::make_unique<PreparedOutputKey>(m_pubs->at(i));
+		return *m_tmp;
+	}
+};
+
+// Each ring member adds points L = c * P + r * G and R = r * Hp(P) + c * I, key image table is computed once per ring
+static bool append_ring_points(const KeyImage &image, RingKeys &&pubs, const RingSignature &sig, std::vector<P3> *points) {
 	if (sig.size() != pubs.size())
 		return false;
 	P3 image_p3;
 	if (!image_p3.frombytes_vartime(image))
 		return false;  // key_image is considered part of signature, we do not throw
 		               // if it is invalid
-	KeccakStream buf;
-	EllipticCurveScalar sum;
-	sc_0(&sum);
-	buf << prefix_hash;
+	ge_dsmp image_dsm;
+	ge_dsm_precomp(&image_dsm, &image_p3.p3);
 	for (size_t i = 0; i < pubs.size(); i++) {
 		if (!sc_isvalid_vartime(&sig[i].c) || !sc_isvalid_vartime(&sig[i].r))
 			return false;
-		const P3 pubs_i_p3(pubs[i]);
-		const P3 hash_pubs_i_p3 = hash_to_good_point_p3(pubs[i]);
+		const PreparedOutputKey &pub = pubs.prepare(i);
+		P3 l_p3, r_p3;
+		ge_double_scalarmult_base_precomp_vartime3(&l_p3.p3, &sig[i].c, &pub.point_dsm, &sig[i].r);
+		ge_double_scalarmult_precomp2_vartime3(&r_p3.p3, &sig[i].r, &pub.hash_point_dsm, &sig[i].c, &image_dsm);
+		points->push_back(l_p3);
+		points->push_back(r_p3);
+	}
+	return true;
+}
 
-		buf << to_bytes(vartime_add(sig[i].c * pubs_i_p3, sig[i].r * G));
-		buf << to_bytes(vartime_add(sig[i].r * hash_pubs_i_p3, sig[i].c * image_p3));
+static bool check_ring_hash(const Hash &prefix_hash, const RingSignature &sig, const PublicKey *encoded_points) {
+	KeccakStream buf;
+	EllipticCurveScalar sum;
+	sc_0(&sum);
+	buf << prefix_hash;
+	for (size_t i = 0; i < sig.size(); i++) {
+		buf << encoded_points[2 * i] << encoded_points[2 * i + 1];
 		sum += sig[i].c;
 	}
 	EllipticCurveScalar h = buf.hash_to_scalar() - sum;
 	return sc_iszero(&h) != 0;
 }
 
+bool check_ring_signature(
+    const Hash &prefix_hash, const KeyImage &image, const std::vector<PublicKey> &pubs, const RingSignature &sig) {
+	std::vector<P3> points;
+	points.reserve(2 * pubs.size());
+	if (!append_ring_points(image, RingKeys(pubs), sig, &points))
+		return false;
+	std::vector<PublicKey> encoded_points(points.size());
+	batch_to_bytes(points.data(), points.size(), encoded_points.data());
+	return check_ring_hash(prefix_hash, sig, encoded_points.data());
+}
+
+// Equations are hashed point by point (Fiat-Shamir over L, R), so unlike (R, s) signatures they cannot be
+// combined with random weights into one multi-scalar multiplication. Instead all points of all rings are
+// computed first, then encoded with single field inversion, the most expensive part shared between rings.
+template<typename Rings>
+static bool check_ring_signatures_impl(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const Rings &pubs, const std::vector<RingSignature> &sigs, size_t *bad_index) {
+	if (images.size() != pubs.size() || images.size() != sigs.size())
+		throw Error("inconsistent images/pubs/sigs size in check_ring_signatures");
+	size_t total_size = 0;
+	for (const auto &sig : sigs)
+		total_size += 2 * sig.size();
+	std::vector<P3> points;
+	points.reserve(total_size);
+	for (size_t i = 0; i != images.size(); ++i)
+		if (!append_ring_points(images[i], RingKeys(pubs[i]), sigs[i], &points)) {
+			if (bad_index)
+				*bad_index = i;
+			return false;
+		}
+	std::vector<PublicKey> encoded_points(points.size());
+	batch_to_bytes(points.data(), points.size(), encoded_points.data());
+	const PublicKey *ring_points = encoded_points.data();
+	for (size_t i = 0; i != sigs.size(); ring_points += 2 * sigs[i].size(), ++i)
+		if (!check_ring_hash(prefix_hash, sigs[i], ring_points)) {
+			if (bad_index)
+				*bad_index = i;
+			return false;
+		}
+	return true;
+}
+
+bool check_ring_signatures(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const std::vector<std::vector<PublicKey>> &pubs, const std::vector<RingSignature> &sigs, size_t *bad_index) {
+	return check_ring_signatures_impl(prefix_hash, images, pubs, sigs, bad_index);
+}
+
+bool check_ring_signatures(const Hash &prefix_hash, const std::vector<KeyImage> &images, const PreparedRings &pubs,
+    const std::vector<RingSignature> &sigs, size_t *bad_index) {
+	return check_ring_signatures_impl(prefix_hash, images, pubs, sigs, bad_index);
+}
+
 static SecretKey generate_sign_secret(
     size_t i, const Hash &random_seed1, const SecretKey &random_seed2, const char secret_name[2]) {
 	KeccakStream k_buf;
@@ -460,10 +548,11 @@ RingSignatureAmethyst generate_ring_signature_amethyst(const Hash &prefix_hash,
 	return sig;
 }
 
-bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<KeyImage> &images,
-    const std::vector<std::vector<PublicKey>> &pubs, const RingSignatureAmethyst &sig) {
+template<typename Rings>
+static bool check_ring_signature_amethyst_impl(
+    const Hash &prefix_hash, const std::vector<KeyImage> &images, const Rings &rings, const RingSignatureAmethyst &sig) {
 	// sanity checks
-	if (images.empty() || images.size() != pubs.size() || images.size() != sig.pp.size() ||
+	if (images.empty() || images.size() != rings.size() || images.size() != sig.pp.size() ||
 	    images.size() != sig.rr.size() || images.size() != sig.rs.size() || images.size() != sig.ra.size())
 		throw Error("inconsistent images/pubs/sigs size in check_ring_signature_amethyst");
 	if (!sc_isvalid_vartime(&sig.c0))
@@ -474,7 +563,8 @@ bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<Ke
 	KeccakStream buf;
 	buf << prefix_hash;
 	for (size_t i = 0; i != images.size(); ++i) {
-		if (pubs[i].empty() || pubs[i].size() != sig.rr[i].size())
+		RingKeys pubs(rings[i]);
+		if (pubs.size() == 0 || pubs.size() != sig.rr[i].size())
 			throw Error("inconsistent pubs/sigs size in check_ring_signature_amethyst");
 		DEBUG_PRINT(std::cout << "image[" << i << "]=" << images[i] << std::endl);
 		const P3 b_coin_p3(hash_to_good_point_p3(images[i]));
@@ -495,25 +585,33 @@ bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<Ke
 		buf << x;
 
 		const P3 image_p3(images[i]);
+		ge_dsmp image_dsm, G_plus_B_dsm;  // same for all ring members
+		ge_dsm_precomp(&image_dsm, &image_p3.p3);
+		ge_dsm_precomp(&G_plus_B_dsm, &G_plus_B_p3.p3);
 
 		auto next_c = sig.c0;
-		for (size_t j = 0; j != pubs[i].size(); ++j) {
-			DEBUG_PRINT(std::cout << "pk[" << i << ", " << j << "]=" << pubs[i][j] << std::endl);
+		for (size_t j = 0; j != pubs.size(); ++j) {
+			DEBUG_PRINT(std::cout << "pk[" << i << ", " << j << "]=" << pubs.key(j) << std::endl);
 			DEBUG_PRINT(std::cout << "c[" << i << ", " << j << "]=" << next_c << std::endl);
 
-			const P3 pubs_i_p3(pubs[i][j]);
-			const P3 hash_pubs_i_p3(hash_to_good_point_p3(pubs[i][j]));
+			const PreparedOutputKey &pub  = pubs.prepare(j);
 			const EllipticCurveScalar &rr = sig.rr[i][j];
 			if (!sc_isvalid_vartime(&rr))
 				return false;
 			DEBUG_PRINT(std::cout << "rr[" << i << ", " << j << "]=" << rr << std::endl);
 
-			const auto y = to_bytes(vartime_add(next_c * (pubs_i_p3 - p_p3), rr * G_plus_B_p3));
-			const auto z = to_bytes(vartime_add(next_c * image_p3, rr * hash_pubs_i_p3));
+			const P3 pub_minus_p_p3 = pub.point - p_p3;
+			P3 yz_p3[2];
+			ge_double_scalarmult_precomp_vartime3(&yz_p3[0].p3, &next_c, &pub_minus_p_p3.p3, &rr, &G_plus_B_dsm);
+			ge_double_scalarmult_precomp2_vartime3(&yz_p3[1].p3, &rr, &pub.hash_point_dsm, &next_c, &image_dsm);
+			PublicKey yz[2];
+			batch_to_bytes(yz_p3, 2, yz);
+			const auto &y = yz[0];
+			const auto &z = yz[1];
 			DEBUG_PRINT(std::cout << "y[" << i << ", " << j << "]=" << y << std::endl);
 			DEBUG_PRINT(std::cout << "z[" << i << ", " << j << "]=" << z << std::endl);
 
-			if (j == pubs[i].size() - 1) {
+			if (j == pubs.size() - 1) {
 				buf << y << z;
 			} else {
 				KeccakStream c_buf;
@@ -522,13 +620,23 @@ bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<Ke
 				DEBUG_PRINT(std::cout << "c[" << i << ", " << j << "]=" << next_c << std::endl);
 			}
 		}
-		for (size_t j = 0; j != pubs[i].size(); ++j)
-			buf << pubs[i][j];
+		for (size_t j = 0; j != pubs.size(); ++j)
+			buf << pubs.key(j);
 	}
 	const auto c = buf.hash_to_scalar() - sig.c0;
 	return sc_iszero(&c) != 0;
 }
 
+bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const std::vector<std::vector<PublicKey>> &pubs, const RingSignatureAmethyst &sig) {
+	return check_ring_signature_amethyst_impl(prefix_hash, images, pubs, sig);
+}
+
+bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const PreparedRings &pubs, const RingSignatureAmethyst &sig) {
+	return check_ring_signature_amethyst_impl(prefix_hash, images, pubs, sig);
+}
+
 KeyDerivation generate_key_derivation(const PublicKey &tx_public_key, const SecretKey &view_secret_key) {
 	check_scalar(view_secret_key);
 	// tx public key is not checked by node, so can be invalid
@@ -838,6 +946,33 @@ P3 operator+(const P3 &a, const P3 &b) {
 	return result;
 }
 
+void batch_to_bytes(const P3 *points, size_t count, PublicKey *result) {
+	if (count == 0)
+		return;
+	struct FieldElement {
+		fe value;
+	};
+	std::vector<FieldElement> z_products(count);  // z_products[i] = Z[0] * ... * Z[i]
+	fe_copy(z_products[0].value, points[0].p3.Z);
+	for (size_t i = 1; i != count; ++i)
+		fe_mul(z_products[i].value, z_products[i - 1].value, points[i].p3.Z);
+	fe inv;  // 1 / (Z[0] * ... * Z[i]) during the loop below
+	fe_invert(inv, z_products[count - 1].value);
+	for (size_t i = count; i-- > 0;) {
+		fe recip, x, y;
+		if (i == 0)
+			fe_copy(recip, inv);
+		else {
+			fe_mul(recip, inv, z_products[i - 1].value);
+			fe_mul(inv, inv, points[i].p3.Z);
+		}
+		fe_mul(x, points[i].p3.X, recip);
+		fe_mul(y, points[i].p3.Y, recip);
+		fe_tobytes(result[i].data, y);
+		result[i].data[31] ^= fe_isnegative(x) << 7;
+	}
+}
+
 P3 bytes_to_good_point_p3(const Hash &h) {
 	ge_p2 point_p2;
 	ge_fromfe_frombytes_vartime(&point_p2, h.data);
@@ -125,6 +125,10 @@ RingSignature generate_ring_signature(const Hash &prefix_hash, const KeyImage &i
 
 bool check_ring_signature(
     const Hash &prefix_hash, const KeyImage &image, const std::vector<PublicKey> &pubs, const RingSignature &sig);
+// Same as check_ring_signature for each input, but faster for many inputs. bad_index is set to first bad input
+bool check_ring_signatures(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const std::vector<std::vector<PublicKey>> &pubs, const std::vector<RingSignature> &sigs,
+    size_t *bad_index = nullptr);
 
 RingSignatureAmethyst generate_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<KeyImage> &images,
     const std::vector<std::vector<PublicKey>> &pubs, const std::vector<SecretKey> &secs_spend,
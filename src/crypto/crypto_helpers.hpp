@@ -52,6 +52,9 @@ T to_bytes(const P3 &other) {
 	return result;
 }
 
+// Same as to_bytes for each point, but with single field inversion (Montgomery's trick)
+void batch_to_bytes(const P3 *points, size_t count, PublicKey *result);
+
 #if crypto_CRYPTO128
 constexpr G3_type G{};
 constexpr P3 I{ge_p3{{0}, {1, 0}, {1, 0}, {0}}};
@@ -189,6 +192,24 @@ inline P3 hash_to_good_point_p3(const EllipticCurvePoint &key) {
 	return hash_to_good_point_p3(key.data, sizeof(key.data));
 }
 
+// Output public key with everything ring checks compute from it, so that caller can cache popular ring members
+struct PreparedOutputKey {
+	PublicKey key;
+	P3 point;
+	P3 hash_point;  // hash_to_good_point_p3(key)
+	ge_dsmp point_dsm;
+	ge_dsmp hash_point_dsm;
+
+	explicit PreparedOutputKey(const PublicKey &key);  // throws Error if key is invalid
+};
+typedef std::vector<std::vector<const PreparedOutputKey *>> PreparedRings;
+
+// Same as versions with public keys in crypto.hpp
+bool check_ring_signatures(const Hash &prefix_hash, const std::vector<KeyImage> &images, const PreparedRings &pubs,
+    const std::vector<RingSignature> &sigs, size_t *bad_index = nullptr);
+bool check_ring_signature_amethyst(const Hash &prefix_hash, const std::vector<KeyImage> &images,
+    const PreparedRings &pubs, const RingSignatureAmethyst &sig);
+
 void generate_ring_signature_amethyst_loop1(size_t i, const P3 &image_p3, const P3 &p_p3, const P3 &G_plus_B_p3,
     size_t sec_index, const std::vector<PublicKey> &pubs, std::vector<EllipticCurveScalar> *rr, EllipticCurvePoint *y,
     EllipticCurvePoint *z, const Hash *random_seed = nullptr);
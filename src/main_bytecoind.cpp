@@ -26,6 +26,8 @@ Usage:
 Options:
   --p2p-bind-address=<ip:port>           IP and port for P2P network protocol [default: 0.0.0.0:8080].
   --p2p-external-port=<port>             External port for P2P network protocol, if port forwarding used with NAT [default: 8080].
+  --p2p-upload-limit=<KiB/s>             Total P2P upload bandwidth, 0 for unlimited [default: 0].
+  --p2p-peer-upload-limit=<KiB/s>        P2P upload bandwidth for each peer, 0 for unlimited [default: 0].
   --bytecoind-bind-address=<ip:port>     IP and port for bytecoind RPC API [default: 127.0.0.1:8081].
   --seed-node-address=<ip:port>          Specify node (one or more) to start connecting to.
   --priority-node-address=<ip:port>      Specify node (one or more) to connect to and attempt to keep the connection open.
@@ -38,7 +40,9 @@ Options:
   --import-blocks=<folder-path>          Perform import of blockchain from specified folder as blocks.bin and blockindexes.bin, then exit.
   --export-blocks=<folder-path>          Perform hot export of blockchain into specified folder as blocks.bin and blockindexes.bin, then exit. This overwrites existing files.
   --archive                              Work as an archive node [default: off].
-  --paranoid-checks                      Perform consensus checks for blocks in checkpoints range (very slow sync))";
+  --paranoid-checks                      Perform consensus checks for blocks in checkpoints range (very slow sync).
+  --worker-threads=<count>               Number of threads preparing downloaded blocks [default: 3/4 of CPU threads].
+  --worker-threads-affinity              Pin each of those threads to its own CPU [default: off].)";
 
 int main(int argc, const char *argv[]) try {
 	common::console::UnicodeConsoleSetup console_setup;
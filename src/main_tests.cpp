@@ -21,8 +21,15 @@
 #include "../tests/crypto/test_crypto.hpp"
 #include "../tests/hash/test_hash.hpp"
 #include "../tests/json/test_json.hpp"
+#include "../tests/p2p/test_compact_block.hpp"
+#include "../tests/p2p/test_known_hashes.hpp"
+#include "../tests/p2p/test_token_bucket.hpp"
+#include "../tests/p2p/test_upload_scheduler.hpp"
 
 #ifndef __EMSCRIPTEN__
+#include "../tests/blockchain/benchmark_outputs.hpp"
+#include "../tests/blockchain/benchmark_template.hpp"
+#include "../tests/blockchain/test_deferred_signatures.hpp"
 #include "../tests/blockchain/test_blockchain.hpp"
 #include "../tests/wallet_file/test_wallet_file.hpp"
 #include "../tests/wallet_state/test_wallet_state.hpp"
@@ -95,16 +102,25 @@ int main(int argc, const char *argv[]) {
 #endif
 
 	std::vector<std::string> crypto_function_tests{};
-	all["--crypto"]    = std::bind(test_crypto, "../tests/crypto", crypto_function_tests, "", false);
-	all["--bip32"]     = test_bip32;
-	all["--benchmark"] = std::bind(benchmark_crypto_ops, 10000, std::ref(std::cout));
-	all["--hash"]      = std::bind(test_hashes, test_folder + "/hash");
+	all["--crypto"]          = std::bind(test_crypto, "../tests/crypto", crypto_function_tests, "", false);
+	all["--bip32"]           = test_bip32;
+	all["--benchmark"]       = std::bind(benchmark_crypto_ops, 10000, std::ref(std::cout));
+	all["--benchmark-rings"] = std::bind(benchmark_ring_signatures, 4, 50, std::ref(std::cout));
+	all["--hash"]            = std::bind(test_hashes, test_folder + "/hash");
 #ifndef __EMSCRIPTEN__
-	all["--blockchain"]   = std::bind(test_blockchain, std::ref(cmd));
-	all["--db"]           = platform::DB::run_tests;
-	all["--json"]         = std::bind(test_json, test_folder + "/json");
-	all["--wallet"]       = std::bind(test_wallet_file, test_folder + "/wallet_file");
-	all["--wallet-state"] = std::bind(test_wallet_state, std::ref(cmd));
+	all["--blockchain"]          = std::bind(test_blockchain, std::ref(cmd));
+	all["--random-outputs"]      = std::bind(test_random_outputs, std::ref(cmd), 200);
+	all["--deferred-signatures"] = std::bind(test_deferred_signatures, std::ref(cmd));
+	all["--benchmark-outputs"]   = std::bind(benchmark_random_outputs, std::ref(cmd), 400, 10000, std::ref(std::cout));
+	all["--benchmark-template"]  = std::bind(benchmark_block_template, 200, 2000, std::ref(std::cout));
+	all["--db"]                  = platform::DB::run_tests;
+	all["--json"]                = std::bind(test_json, test_folder + "/json");
+	all["--token-bucket"]        = test_token_bucket;
+	all["--compact-block"]       = test_compact_block;
+	all["--known-hashes"]        = test_known_hashes;
+	all["--upload-scheduler"]    = test_upload_scheduler;
+	all["--wallet"]              = std::bind(test_wallet_file, test_folder + "/wallet_file");
+	all["--wallet-state"]        = std::bind(test_wallet_state, std::ref(cmd));
 #endif
 	for (const auto &t : all)
 		USAGE += "    " + t.first + "\n";
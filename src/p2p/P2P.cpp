@@ -14,17 +14,81 @@
 
 using namespace cn;
 
+void TokenBucket::refill(std::chrono::steady_clock::time_point now, size_t rate) {
+	if (rate == 0)
+		return;
+	const double seconds = std::chrono::duration<double>(now - m_refill_time).count();
+	m_refill_time        = now;
+	m_tokens             = std::min<double>(rate, m_tokens + seconds * rate);
+}
+
+float TokenBucket::seconds_until_allowed(size_t rate) const {
+	if (allows(rate))
+		return 0;
+	return static_cast<float>(-m_tokens / rate) + 0.001f;  // tokens must become positive
+}
+
+common::SharedBinaryArray UploadScheduler::pop(
+    Queues *queues, Priority priority, bool socket_ready, std::chrono::steady_clock::time_point now) {
+	auto &queue = queues->messages[priority];
+	if (queue.empty() || (priority == PRIORITY_BULK && !bulk_allowed(*queues)))
+		return common::SharedBinaryArray{};
+	const bool tokens_allow = m_bucket.allows(m_upload_limit);
+	if (priority == PRIORITY_HIGH)
+		set_waiting_tokens(queues, socket_ready && !tokens_allow);
+	if (!socket_ready || !tokens_allow)
+		return common::SharedBinaryArray{};
+	queues->bucket.refill(now, m_peer_upload_limit);
+	if (!queues->bucket.allows(m_peer_upload_limit))
+		return common::SharedBinaryArray{};
+	common::SharedBinaryArray body = std::move(queue.front());
+	queue.pop_front();
+	m_bucket.consume(m_upload_limit, body->size());
+	queues->bucket.consume(m_peer_upload_limit, body->size());
+	queues->size -= body->size();
+	return body;
+}
+
+float UploadScheduler::seconds_until_allowed(const Queues &queues) const {
+	return std::max(
+	    m_bucket.seconds_until_allowed(m_upload_limit), queues.bucket.seconds_until_allowed(m_peer_upload_limit));
+}
+
+void UploadScheduler::clear(Queues *queues) {
+	set_waiting_tokens(queues, false);
+	for (auto &queue : queues->messages)
+		queue.clear();
+	queues->size = 0;
+}
+
+void UploadScheduler::set_waiting_tokens(Queues *queues, bool waiting) {
+	if (queues->waiting_tokens == waiting)
+		return;
+	queues->waiting_tokens = waiting;
+	if (waiting)
+		m_tokens_waiting += 1;
+	else
+		m_tokens_waiting -= 1;
+}
+
 void P2PProtocol::on_disconnect(const std::string &ban_reason) { m_client = nullptr; }
 
 const NetworkAddress &P2PProtocol::get_address() const { return m_client->get_address(); }
 bool P2PProtocol::is_incoming() const { return m_client->is_incoming(); }
 void P2PProtocol::send(BinaryArray &&body) { return m_client->send(std::move(body)); }
+void P2PProtocol::send_shared(const common::SharedBinaryArray &body) {
+	return m_client->send_shared(body, UploadScheduler::PRIORITY_HIGH);
+}
+void P2PProtocol::send_bulk(BinaryArray &&body) {
+	return m_client->send_shared(std::make_shared<const BinaryArray>(std::move(body)), UploadScheduler::PRIORITY_BULK);
+}
 void P2PProtocol::send_shutdown() { return m_client->send_shutdown(); }
 void P2PProtocol::disconnect(const std::string &ban_reason) { return m_client->disconnect(ban_reason); }
 void P2PProtocol::update_my_port(uint16_t port) { return m_client->update_my_port(port); }
 
-P2PClient::P2PClient(bool incoming, D_handler &&d_handler)
-    : sock([this](bool canread, bool canwrite) { advance_state(true); },
+P2PClient::P2PClient(P2P *owner, bool incoming, D_handler &&d_handler)
+    : owner(owner)
+    , sock([this](bool canread, bool canwrite) { advance_state(true); },
           std::bind(&P2PClient::on_socket_disconnect, this))
     , incoming(incoming)
     , d_handler(std::move(d_handler))
@@ -43,14 +107,18 @@ void P2PClient::set_protocol(std::unique_ptr<P2PProtocol> &&protocol) {
 }
 
 void P2PClient::write() {
-	while (!responses.empty()) {
-		responses.front().copy_to(sock);
-		if (!responses.front().empty())
-			break;
-		responses.pop_front();
+	if (owner)
+		owner->upload(this);
+	else {
+		for (auto &queue : upload.messages)
+			for (; !queue.empty(); queue.pop_front()) {
+				uploaded_bytes += queue.front()->size();
+				sock.write_shared(queue.front());
+			}
+		upload.size = 0;
 	}
-	if (responses.empty() && waiting_shutdown)
-		sock.shutdown_both();
+	if (waiting_shutdown && upload.size == 0)
+		sock.shutdown_both();  // Socket sends everything queued before shutting down
 }
 
 void P2PClient::read(bool called_from_runloop) {
@@ -99,8 +167,11 @@ bool P2PClient::read_next_request(BinaryArray &header, BinaryArray &body) {
 }
 
 void P2PClient::send(BinaryArray &&body) {
-	responses.emplace_back(std::move(body));
+	send_shared(std::make_shared<const BinaryArray>(std::move(body)), UploadScheduler::PRIORITY_HIGH);
+}
 
+void P2PClient::send_shared(const common::SharedBinaryArray &body, Priority priority) {
+	upload.push(body, priority);
 	write();
 }
 
@@ -114,9 +185,12 @@ void P2PClient::disconnect(const std::string &ban_reason) {
 	receiving_body        = false;
 	request               = BinaryArray();
 	receiving_body_stream = common::VectorStream();
-	responses.clear();
 
-	sock.close();
+	sock.close();  // Also clears queued responses
+	if (owner)
+		owner->scheduler.clear(&upload);
+	else
+		upload = UploadScheduler::Queues{};
 	if (m_protocol)
 		m_protocol->on_disconnect(ban_reason);
 	m_protocol.reset();
@@ -137,7 +211,10 @@ bool P2PClient::is_connected() const { return sock.is_open(); }
 void P2PClient::advance_state(bool called_from_runloop) {
 	try {
 		write();
-		if (responses.size() > 1)
+		const size_t queued =
+		    sock.get_shared_queue_size() + upload.messages[UploadScheduler::PRIORITY_HIGH].size() +
+		    upload.messages[UploadScheduler::PRIORITY_BULK].size();
+		if (queued > 1)
 			return;  // keep outward queue busy with (one) response
 		// TODO - keep track of total number of bytes to send, read new data when that number is low enough
 		read(called_from_runloop);
@@ -172,7 +249,7 @@ void P2P::accept_all() {
 	while (clients[incoming].size() < m_config.p2p_max_incoming_connections) {
 		if (!next_client[incoming]) {
 			next_client[incoming] =
-			    std::make_unique<P2PClient>(incoming, [](std::string ban_reason) {});  // We do not know Client * yet
+			    std::make_unique<P2PClient>(this, incoming, [](std::string ban_reason) {});  // Client * unknown yet
 			next_client[incoming]->d_handler =
 			    std::bind(&P2P::on_client_disconnected, this, next_client[incoming].get(), _1);
 		}
@@ -204,7 +281,7 @@ bool P2P::connect_one(const NetworkAddress &address) {
 	const bool incoming = false;
 	if (!next_client[incoming]) {
 		next_client[incoming] =
-		    std::make_unique<P2PClient>(incoming, [](std::string ban_reason) {});  // We do not know Client * yet
+		    std::make_unique<P2PClient>(this, incoming, [](std::string ban_reason) {});  // Client * unknown yet
 		next_client[incoming]->d_handler =
 		    std::bind(&P2P::on_client_disconnected, this, next_client[incoming].get(), _1);
 	}
@@ -267,6 +344,8 @@ P2P::P2P(logging::ILogger &log, const Config &config, PeerDB &peers, client_fact
     , m_log_banned_timestamp(std::chrono::steady_clock::now())
     , reconnect_timer(std::bind(&P2P::connect_all_nodelay, this))
     , free_disconnected_timer([&]() { disconnected_clients.clear(); })
+    , scheduler(config.p2p_upload_limit, config.p2p_peer_upload_limit)
+    , upload_timer(std::bind(&P2P::upload_all, this))
     , c_factory(std::move(c_factory))
     , unique_number(crypto::rand<uint64_t>()) {
 	try {
@@ -284,3 +363,78 @@ P2P::P2P(logging::ILogger &log, const Config &config, PeerDB &peers, client_fact
 }
 
 Timestamp P2P::get_local_time() const { return platform::now_unix_timestamp(); }
+
+size_t P2P::get_upload_queue_size() const {
+	size_t result = 0;
+	for (auto &&cl : clients)
+		for (auto &&cit : cl)
+			result += cit.first->upload.size;
+	return result;
+}
+
+bool P2P::upload_one(P2PClient *who, UploadScheduler::Priority priority, std::chrono::steady_clock::time_point now) {
+	const bool socket_ready = who->sock.get_shared_queue_size() < P2PClient::MAX_SOCKET_QUEUE;
+	const common::SharedBinaryArray body = scheduler.pop(&who->upload, priority, socket_ready, now);
+	if (!body)
+		return false;
+	who->uploaded_bytes += body->size();
+	uploaded_bytes += body->size();
+	who->sock.write_shared(body);
+	return true;
+}
+
+void P2P::upload(P2PClient *who) {
+	const auto now = std::chrono::steady_clock::now();
+	scheduler.refill(now);
+	while (upload_one(who, UploadScheduler::PRIORITY_HIGH, now)) {
+	}
+	while (upload_one(who, UploadScheduler::PRIORITY_BULK, now)) {
+	}
+	// If socket queue is full, we continue when it shrinks, otherwise upload_all continues when tokens allow
+	if (who->upload.size != 0 && who->sock.get_shared_queue_size() < P2PClient::MAX_SOCKET_QUEUE)
+		set_upload_timer(now, scheduler.seconds_until_allowed(who->upload));
+}
+
+void P2P::upload_all() {
+	const auto now = std::chrono::steady_clock::now();
+	scheduler.refill(now);
+	std::vector<P2PClient *> waiting;
+	for (auto &&cl : clients)
+		for (auto &&cit : cl)
+			if (cit.first->upload.size != 0)
+				waiting.push_back(cit.first);
+	if (waiting.empty())
+		return;
+	// Tokens go to all PRIORITY_HIGH messages first, one message from each client per round
+	upload_round += 1;
+	std::rotate(waiting.begin(), waiting.begin() + upload_round % waiting.size(), waiting.end());
+	for (auto priority : {UploadScheduler::PRIORITY_HIGH, UploadScheduler::PRIORITY_BULK})
+		for (bool sent = true; sent;) {
+			sent = false;
+			for (auto who : waiting)
+				if (upload_one(who, priority, now))
+					sent = true;
+		}
+	bool throttled = false;
+	float wait     = 0;
+	for (auto who : waiting) {
+		if (who->waiting_shutdown && who->upload.size == 0)
+			who->sock.shutdown_both();
+		if (who->upload.size == 0 || who->sock.get_shared_queue_size() >= P2PClient::MAX_SOCKET_QUEUE)
+			continue;
+		const float who_wait = scheduler.seconds_until_allowed(who->upload);
+		wait                 = throttled ? std::min(wait, who_wait) : who_wait;
+		throttled            = true;
+	}
+	if (throttled)
+		set_upload_timer(now, wait);
+}
+
+void P2P::set_upload_timer(std::chrono::steady_clock::time_point now, float after_seconds) {
+	const auto deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	                                std::chrono::duration<float>(after_seconds));
+	if (upload_timer.is_set() && upload_timer_deadline <= deadline)
+		return;
+	upload_timer_deadline = deadline;
+	upload_timer.once(after_seconds);
+}
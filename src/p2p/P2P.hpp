@@ -21,6 +21,61 @@ class P2P;
 class P2PClient;
 class PeerDB;
 
+// Tokens are bytes, refilled at rate per second up to one second worth. Whole message is sent while there are
+// tokens left, so bucket can go into debt, which is repaid before next message. Rate 0 means no limit
+class TokenBucket {
+public:
+	void refill(std::chrono::steady_clock::time_point now, size_t rate);
+	bool allows(size_t rate) const { return rate == 0 || m_tokens > 0; }
+	void consume(size_t rate, size_t amount) {
+		if (rate != 0)
+			m_tokens -= amount;
+	}
+	float seconds_until_allowed(size_t rate) const;  // 0 if allows
+
+private:
+	double m_tokens = 0;
+	std::chrono::steady_clock::time_point m_refill_time;
+};
+
+// Decides which queued messages get upload tokens, P2P writes them to sockets. Shared upload_limit is used by all
+// clients, peer_upload_limit applies to each
+class UploadScheduler {
+public:
+	// Handshakes, pings and relays go before blocks, chains and pool contents served to syncing peers
+	enum Priority { PRIORITY_HIGH, PRIORITY_BULK, PRIORITY_COUNT };
+	struct Queues {  // of one client
+		std::deque<common::SharedBinaryArray> messages[PRIORITY_COUNT];
+		size_t size = 0;  // bytes
+		TokenBucket bucket;
+		bool waiting_tokens = false;  // PRIORITY_HIGH message waits for shared tokens
+		void push(const common::SharedBinaryArray &body, Priority priority) {
+			messages[priority].push_back(body);
+			size += body->size();
+		}
+	};
+	explicit UploadScheduler(size_t upload_limit, size_t peer_upload_limit)
+	    : m_upload_limit(upload_limit), m_peer_upload_limit(peer_upload_limit) {}
+	void refill(std::chrono::steady_clock::time_point now) { m_bucket.refill(now, m_upload_limit); }
+	// Next message if tokens allow, nullptr otherwise. Client with full socket does not count as waiting for tokens
+	common::SharedBinaryArray pop(
+	    Queues *queues, Priority priority, bool socket_ready, std::chrono::steady_clock::time_point now);
+	// Bulk must not take shared tokens from PRIORITY_HIGH messages of clients waiting for them
+	bool bulk_allowed(const Queues &queues) const {
+		return m_tokens_waiting == 0 && queues.messages[PRIORITY_HIGH].empty();
+	}
+	float seconds_until_allowed(const Queues &queues) const;
+	void clear(Queues *queues);  // on disconnect
+	size_t get_tokens_waiting() const { return m_tokens_waiting; }
+
+private:
+	const size_t m_upload_limit;
+	const size_t m_peer_upload_limit;
+	TokenBucket m_bucket;
+	size_t m_tokens_waiting = 0;  // Clients with waiting_tokens
+	void set_waiting_tokens(Queues *queues, bool waiting);
+};
+
 class P2PProtocol {
 public:
 	explicit P2PProtocol(P2PClient *client) : m_client(client) {}
@@ -33,6 +88,9 @@ public:
 	const NetworkAddress &get_address() const;
 	bool is_incoming() const;
 	virtual void send(BinaryArray &&body);
+	virtual void send_shared(const common::SharedBinaryArray &body);  // the same body can be sent to many peers
+	// Goes after high priority messages to this peer and to other peers waiting for upload tokens
+	virtual void send_bulk(BinaryArray &&body);
 	void send_shutdown();
 	void disconnect(const std::string &ban_reason);
 	P2PClient *get_client() const { return m_client; }
@@ -47,15 +105,20 @@ private:
 class P2PClient {
 public:
 	static const int RECOMMENDED_BUFFER_SIZE = 8192;
+	// Upload scheduler keeps messages until socket queue is shorter, so that priorities work
+	static const size_t MAX_SOCKET_QUEUE = 2;
+	typedef UploadScheduler::Priority Priority;
 
 	typedef std::function<void(std::string ban_reason)> D_handler;
 
-	explicit P2PClient(bool incoming, D_handler &&d_handler);
+	explicit P2PClient(P2P *owner, bool incoming, D_handler &&d_handler);  // owner is nullptr for single connects
 	void set_protocol(std::unique_ptr<P2PProtocol> &&protocol);
 
 	const NetworkAddress &get_address() const { return address; }
 	bool is_incoming() const { return incoming; }
 	virtual void send(BinaryArray &&body);  // We want to make sure to update stats when calling with a base class
+	// Not copied, socket writes directly from body
+	virtual void send_shared(const common::SharedBinaryArray &body, Priority priority);
 	void send_shutdown();
 	void disconnect(const std::string &ban_reason);  // empty for no ban
 	bool test_connect(const NetworkAddress &addr);   // for single connects without p2p
@@ -63,6 +126,8 @@ public:
 	virtual ~P2PClient() = default;
 	P2PProtocol *get_protocol() const { return m_protocol.get(); }
 	void update_my_port(uint16_t port) { address.port = port; }
+	size_t get_upload_queue_size() const { return upload.size; }  // bytes waiting for upload scheduler
+	uint64_t get_uploaded_bytes() const { return uploaded_bytes; }
 
 private:
 	void advance_state(bool called_from_runloop);
@@ -74,6 +139,7 @@ private:
 	void process_requests();
 
 	friend class P2P;
+	P2P *const owner;
 	std::unique_ptr<P2PProtocol> m_protocol;
 	NetworkAddress address;
 	platform::TCPSocket sock;
@@ -88,8 +154,10 @@ private:
 
 	common::CircularBuffer buffer;
 
-	std::deque<common::VectorStream> responses;
-	bool waiting_shutdown = false;
+	bool waiting_shutdown = false;  // responses are queued in sock as shared buffers
+
+	UploadScheduler::Queues upload;
+	uint64_t uploaded_bytes = 0;  // passed to sock
 };
 
 class P2P {
@@ -102,6 +170,8 @@ public:
 	uint64_t get_unique_number() const { return unique_number; }
 
 	void peers_updated();
+	uint64_t get_uploaded_bytes() const { return uploaded_bytes; }
+	size_t get_upload_queue_size() const;  // bytes waiting in all clients
 
 private:
 	const Config &m_config;
@@ -124,6 +194,17 @@ private:
 	friend class P2PClient;
 	void on_client_disconnected(P2PClient *who, std::string ban_reason);
 
+	// Upload scheduler, p2p_upload_limit is shared by all clients, p2p_peer_upload_limit applies to each
+	UploadScheduler scheduler;
+	uint64_t uploaded_bytes = 0;
+	size_t upload_round     = 0;  // Rotates first client of round robin
+	platform::Timer upload_timer;
+	std::chrono::steady_clock::time_point upload_timer_deadline;
+	bool upload_one(P2PClient *who, UploadScheduler::Priority priority, std::chrono::steady_clock::time_point now);
+	void upload(P2PClient *who);  // When client queues message or its socket queue shrinks
+	void upload_all();            // When tokens are refilled, all clients in round robin, by priority
+	void set_upload_timer(std::chrono::steady_clock::time_point now, float after_seconds);
+
 	void accept_all();
 	void connect_all();
 	void connect_all_nodelay();
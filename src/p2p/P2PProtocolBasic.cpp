@@ -50,7 +50,10 @@ const std::map<std::pair<uint32_t, LevinProtocol::CommandType>,
         levin_pair<p2p::GetChain::Response>(&P2PProtocolBasic::on_msg_notify_request_chain),
         levin_pair<p2p::Checkpoint::Notify>(&P2PProtocolBasic::on_msg_notify_checkpoint),
         levin_pair<p2p::GetObjects::Request>(&P2PProtocolBasic::on_msg_notify_request_objects),
-        levin_pair<p2p::GetObjects::Response>(&P2PProtocolBasic::on_msg_notify_request_objects)};
+        levin_pair<p2p::GetObjects::Response>(&P2PProtocolBasic::on_msg_notify_request_objects),
+        levin_pair<p2p::RelayCompactBlock::Notify>(&P2PProtocolBasic::on_msg_notify_new_compact_block),
+        levin_pair<p2p::GetBlockTransactions::Request>(&P2PProtocolBasic::on_msg_notify_request_block_transactions),
+        levin_pair<p2p::GetBlockTransactions::Response>(&P2PProtocolBasic::on_msg_notify_request_block_transactions)};
 
 P2PProtocolBasic::P2PProtocolBasic(const Config &config, uint64_t my_unique_number, P2PClient *client)
     : P2PProtocol(client)
@@ -74,6 +77,18 @@ void P2PProtocolBasic::send(BinaryArray &&body) {
 	P2PProtocol::send(std::move(body));
 }
 
+void P2PProtocolBasic::send_shared(const common::SharedBinaryArray &body) {
+	no_outgoing_timer.once(float(config.p2p_no_outgoing_message_ping_timeout));
+	on_msg_bytes(0, body->size());
+	P2PProtocol::send_shared(body);
+}
+
+void P2PProtocolBasic::send_bulk(BinaryArray &&body) {
+	no_outgoing_timer.once(float(config.p2p_no_outgoing_message_ping_timeout));
+	on_msg_bytes(0, body.size());
+	P2PProtocol::send_bulk(std::move(body));
+}
+
 Timestamp P2PProtocolBasic::get_local_time() const { return platform::now_unix_timestamp(); }
 
 BasicNodeData P2PProtocolBasic::get_my_node_data() const {
@@ -83,6 +98,7 @@ BasicNodeData P2PProtocolBasic::get_my_node_data() const {
 	node_data.peer_id    = my_unique_number;
 	node_data.my_port    = config.p2p_external_port;
 	node_data.network_id = config.network_id;
+	node_data.features   = P2P_FEATURE_BATCHED_OBJECTS | P2P_FEATURE_COMPACT_BLOCKS;
 	return node_data;
 }
 
@@ -105,6 +121,7 @@ void P2PProtocolBasic::on_disconnect(const std::string &ban_reason) {
 	no_outgoing_timer.cancel();
 	no_incoming_timer.cancel();
 	peer_version                            = P2PProtocolVersion::NO_HANDSHAKE_YET;
+	peer_features                           = 0;
 	first_message_after_handshake_processed = false;
 	set_peer_sync_data(CoreSyncData{});
 	peer_unique_number = 0;
@@ -163,7 +180,8 @@ void P2PProtocolBasic::msg_handshake(p2p::Handshake::Request &&req) {
 
 	BinaryArray raw_msg = LevinProtocol::send(msg);
 	send(std::move(raw_msg));
-	peer_version = req.node_data.version;
+	peer_version  = req.node_data.version;
+	peer_features = req.node_data.features;
 	set_peer_sync_data(req.payload_data);
 	peer_unique_number = req.node_data.peer_id;
 	update_my_port(req.node_data.my_port);  // We set port to unknown on accept
@@ -181,7 +199,8 @@ void P2PProtocolBasic::msg_handshake(p2p::Handshake::Response &&req) {
 	// self-connect, incoming side replies so that outgoing side can add to ban
 	if (req.node_data.peer_id == my_unique_number)
 		return disconnect("203 self-connect");
-	peer_version = req.node_data.version;
+	peer_version  = req.node_data.version;
+	peer_features = req.node_data.features;
 	if (req.local_peerlist.size() > p2p::Handshake::Response::MAX_PEER_COUNT)
 		return disconnect("204 max_local_peer_count");
 	if (req.peerlist.size() > p2p::Handshake::Response::MAX_PEER_COUNT)
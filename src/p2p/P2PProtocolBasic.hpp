@@ -19,6 +19,7 @@ private:
 	platform::Timer no_incoming_timer;
 	platform::Timer no_outgoing_timer;
 	int peer_version                             = 0;  // 0 means no handshake yet
+	uint64_t peer_features                       = 0;
 	bool first_message_after_handshake_processed = false;
 	// we add node to peerdb after first non-handshake message received to avoid adding seed nodes
 	const uint64_t my_unique_number;
@@ -63,6 +64,9 @@ protected:
 	virtual void on_msg_notify_request_objects(p2p::GetObjects::Request &&) {}
 	virtual void on_msg_notify_request_objects(p2p::GetObjects::Response &&) {}
 	virtual void on_msg_notify_checkpoint(p2p::Checkpoint::Notify &&) {}
+	virtual void on_msg_notify_new_compact_block(p2p::RelayCompactBlock::Notify &&) {}
+	virtual void on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Request &&) {}
+	virtual void on_msg_notify_request_block_transactions(p2p::GetBlockTransactions::Response &&) {}
 	virtual CoreSyncData get_my_sync_data() const = 0;
 	virtual std::vector<NetworkAddress> get_peers_to_share() const { return std::vector<NetworkAddress>(); }
 	virtual std::vector<PeerlistEntryLegacy> get_legacy_peers_to_share() const {
@@ -74,8 +78,11 @@ protected:
 public:
 	explicit P2PProtocolBasic(const Config &config, uint64_t my_unique_number, P2PClient *client);
 	int get_peer_version() const { return peer_version; }
+	bool peer_has_feature(P2PProtocolFeatures feature) const { return (peer_features & feature) != 0; }
 	uint64_t get_my_unique_number() const { return my_unique_number; }
 	void send(BinaryArray &&body) override;
+	void send_shared(const common::SharedBinaryArray &body) override;
+	void send_bulk(BinaryArray &&body) override;
 	virtual BasicNodeData get_my_node_data() const;
 	CoreSyncData get_peer_sync_data() const { return peer_sync_data; }
 	uint64_t get_peer_unique_number() const { return peer_unique_number; }
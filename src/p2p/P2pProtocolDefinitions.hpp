@@ -88,12 +88,18 @@ struct RelayTransactions {
 };
 
 struct GetObjects {
+	enum { MAX_BATCH_OBJECTS = 100 };
 	// Request and Response have NOTIFY type for historic purposes
 	struct Request {
-		enum { ID = BC_COMMANDS_POOL_BASE + 3, TYPE = LevinProtocol::NOTIFY, MAX_SIZE = 1024 };
+		enum {
+			ID       = BC_COMMANDS_POOL_BASE + 3,
+			TYPE     = LevinProtocol::NOTIFY,
+			MAX_SIZE = 1024 + MAX_BATCH_OBJECTS * sizeof(Hash)
+		};
 		std::vector<Hash> txs;
 		std::vector<Hash> blocks;
 		// In protocol V4, either txs or blocks must contain exactly 1 hash, otherwise ban
+		// With P2P_FEATURE_BATCHED_OBJECTS, up to MAX_BATCH_OBJECTS hashes in total
 	};
 	struct Response {
 		enum {
@@ -104,6 +110,8 @@ struct GetObjects {
 		};
 		// MAX_SIZE is like this because BlockTemplate contains transaction id per block transaction
 		// In protocol V4, we request only single object, so get exactly 1 object (or missed id) back
+		// With P2P_FEATURE_BATCHED_OBJECTS, objects of request are returned in order, in one or more responses,
+		// each response has 1..MAX_BATCH_OBJECTS objects and is not larger than MAX_SIZE
 		std::vector<BinaryArray> txs;
 		std::vector<RawBlock> blocks;
 		std::vector<Hash> missed_ids;
@@ -161,6 +169,50 @@ struct Checkpoint {
 	};
 };
 
+// Only for peers with P2P_FEATURE_COMPACT_BLOCKS
+struct RelayCompactBlock {
+	struct Notify {
+		enum {
+			ID       = BC_COMMANDS_POOL_BASE + 11,
+			TYPE     = LevinProtocol::NOTIFY,
+			MAX_SIZE = 4096 + parameters::MAX_HEADER_SIZE +
+			           parameters::BLOCK_CAPACITY_VOTE_MAX * sizeof(uint64_t) / MIN_NONCOINBASE_TRANSACTION_SIZE
+		};
+		BinaryArray header;               // BlockTemplate with empty transaction_hashes
+		uint64_t salt = 0;                // Chosen by sender, so that short id collisions are different for each peer
+		std::vector<uint64_t> short_ids;  // Of block transactions, in block order
+		Hash top_id;
+		Height current_blockchain_height = 0;
+
+		Hash get_short_id_key() const;  // Depends on top_id and salt
+		static uint64_t get_short_id(const Hash &key, const Hash &tid);
+	};
+};
+
+// Only for peers with P2P_FEATURE_COMPACT_BLOCKS
+struct GetBlockTransactions {
+	struct Request {
+		enum {
+			ID       = BC_COMMANDS_POOL_BASE + 12,
+			TYPE     = LevinProtocol::NOTIFY,
+			MAX_SIZE = 1024 + parameters::BLOCK_CAPACITY_VOTE_MAX * sizeof(uint32_t) / MIN_NONCOINBASE_TRANSACTION_SIZE
+		};
+		Hash block_id;
+		std::vector<uint32_t> indexes;  // Of transactions in block, ascending
+
+		bool indexes_valid(size_t transaction_count) const;
+	};
+	struct Response {
+		enum {
+			ID       = BC_COMMANDS_POOL_BASE + 13,
+			TYPE     = LevinProtocol::NOTIFY,
+			MAX_SIZE = 4096 + parameters::BLOCK_CAPACITY_VOTE_MAX
+		};
+		Hash block_id;
+		std::vector<BinaryArray> transactions;  // In order of request indexes, empty if block not found
+	};
+};
+
 #if bytecoin_ALLOW_DEBUG_COMMANDS
 // These commands are considered as insecure, and made in debug purposes for a limited lifetime.
 // Anyone who feel unsafe with this commands can disable the bytecoin_ALLOW_DEBUG_COMMANDS macro in CryptoNote.hpp
@@ -203,6 +255,9 @@ void ser_members(cn::p2p::GetChain::Request &v, seria::ISeria &s);
 void ser_members(cn::p2p::GetChain::Response &v, seria::ISeria &s);
 void ser_members(cn::p2p::SyncPool::Request &v, seria::ISeria &s);
 void ser_members(cn::p2p::SyncPool::Response &v, seria::ISeria &s);
+void ser_members(cn::p2p::RelayCompactBlock::Notify &v, seria::ISeria &s);
+void ser_members(cn::p2p::GetBlockTransactions::Request &v, seria::ISeria &s);
+void ser_members(cn::p2p::GetBlockTransactions::Response &v, seria::ISeria &s);
 inline void ser_members(cn::p2p::Checkpoint::Notify &v, seria::ISeria &s) {
 	ser_members(static_cast<cn::SignedCheckpoint &>(v), s);
 }
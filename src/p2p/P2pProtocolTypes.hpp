@@ -19,6 +19,12 @@ typedef uint64_t PeerIdType;
 enum P2PProtocolVersion : uint8_t { NO_HANDSHAKE_YET = 0, LEGACY = 1, AMETHYST = 4 };
 // V4 adds several fields/messages and sets strict rules, violating would be BAN.
 
+enum P2PProtocolFeatures : uint64_t { P2P_FEATURE_BATCHED_OBJECTS = 1, P2P_FEATURE_COMPACT_BLOCKS = 2 };
+// Bits of BasicNodeData::features, feature is used only if both peers advertise it in handshake.
+// P2P_FEATURE_BATCHED_OBJECTS - GetObjects can contain up to MAX_BATCH_OBJECTS objects in request and response
+// P2P_FEATURE_COMPACT_BLOCKS - new blocks are relayed as RelayCompactBlock, missing transactions are requested
+// with GetBlockTransactions. Invalid compact block with valid header is not a ban reason (it can be relayed early)
+
 #pragma pack(push, 1)
 struct UUID {
 	uint8_t data[16]{};
@@ -49,6 +55,7 @@ struct BasicNodeData {
 	Timestamp local_time = 0;
 	uint16_t my_port     = 0;  // p2p external port.
 	PeerIdType peer_id   = 0;
+	uint64_t features    = 0;  // P2PProtocolFeatures, absent in handshake of older versions
 };
 
 struct CoreSyncData {
@@ -85,6 +92,8 @@ struct ConnectionDesc {
 	bool is_incoming    = false;
 	uint8_t p2p_version = 0;
 	TopBlockDesc top_block_desc;
+	uint64_t uploaded_bytes  = 0;
+	size_t upload_queue_size = 0;  // bytes waiting for bandwidth or socket
 };
 
 struct CoreStatistics {
@@ -107,6 +116,35 @@ struct CoreStatistics {
 	Height upgrade_decided_height               = 0;
 	Height upgrade_votes_in_top_block           = 0;
 	uint64_t node_database_size                 = 0;
+	size_t header_cache_count                   = 0;
+	size_t header_cache_size                    = 0;  // approximate, in bytes
+	size_t header_cache_hits                    = 0;
+	size_t header_cache_misses                  = 0;
+	size_t header_cache_evictions               = 0;
+	size_t keyimage_filter_count                = 0;
+	size_t keyimage_filter_size                 = 0;  // in bytes
+	size_t keyimage_filter_lookups              = 0;
+	size_t keyimage_filter_skipped              = 0;  // definite misses, DB not read
+	size_t keyimage_filter_false_positives      = 0;
+	size_t reorganization_count                 = 0;
+	Height last_reorganization_depth            = 0;  // blocks undone
+	Height max_reorganization_depth             = 0;
+	uint32_t last_reorganization_duration       = 0;  // ms
+	size_t output_key_cache_count               = 0;
+	size_t output_key_cache_size                = 0;  // approximate, in bytes
+	size_t output_key_cache_hits                = 0;
+	size_t output_key_cache_misses              = 0;
+	size_t compact_blocks_received              = 0;
+	size_t compact_blocks_reconstructed         = 0;  // from pool only, without round trip
+	size_t compact_blocks_incomplete            = 0;  // needed GetBlockTransactions round trip
+	size_t compact_blocks_missing_transactions  = 0;  // requested in those round trips
+	size_t compact_blocks_failed                = 0;  // fell back to full download
+	size_t compact_blocks_relayed_early         = 0;  // before transactions were validated
+	uint64_t p2p_uploaded_bytes                 = 0;
+	size_t p2p_upload_queue_size                = 0;  // bytes waiting for bandwidth or sockets
+	size_t transaction_relay_announced          = 0;  // descs sent to peers
+	size_t transaction_relay_suppressed         = 0;  // not sent, because peer knows transaction
+	size_t transaction_relay_messages           = 0;  // RelayTransactions sent
 };
 
 // inline bool operator<(const NetworkAddressLegacy &a, const NetworkAddressLegacy &b) {
@@ -10,6 +10,28 @@
 
 using namespace cn;
 
+Hash p2p::RelayCompactBlock::Notify::get_short_id_key() const {
+	common::VectorStream vs;
+	vs.write(top_id.data, sizeof(top_id.data));
+	vs.write_varint(salt);
+	return crypto::cn_fast_hash(vs.buffer().data(), vs.buffer().size());
+}
+
+uint64_t p2p::RelayCompactBlock::Notify::get_short_id(const Hash &key, const Hash &tid) {
+	unsigned char data[2 * sizeof(Hash)];
+	memcpy(data, key.data, sizeof(key.data));
+	memcpy(data + sizeof(key.data), tid.data, sizeof(tid.data));
+	const Hash hash = crypto::cn_fast_hash(data, sizeof(data));
+	return common::uint_le_from_bytes<uint64_t>(hash.data, 8);
+}
+
+bool p2p::GetBlockTransactions::Request::indexes_valid(size_t transaction_count) const {
+	for (size_t i = 0; i != indexes.size(); ++i)
+		if (indexes[i] >= transaction_count || (i != 0 && indexes[i] <= indexes[i - 1]))
+			return false;
+	return true;
+}
+
 #if bytecoin_ALLOW_DEBUG_COMMANDS
 Hash p2p::ProofOfTrust::get_hash() const {
 	common::VectorStream vs;
@@ -75,6 +97,35 @@ void ser_members(CoreStatistics &v, seria::ISeria &s) {
 	seria_kv("peer_list_gray", v.peer_list_gray, s);
 	seria_kv("connected_peers", v.connected_peers, s);
 	seria_kv("node_database_size", v.node_database_size, s);
+	seria_kv("header_cache_count", v.header_cache_count, s);
+	seria_kv("header_cache_size", v.header_cache_size, s);
+	seria_kv("header_cache_hits", v.header_cache_hits, s);
+	seria_kv("header_cache_misses", v.header_cache_misses, s);
+	seria_kv("header_cache_evictions", v.header_cache_evictions, s);
+	seria_kv("keyimage_filter_count", v.keyimage_filter_count, s);
+	seria_kv("keyimage_filter_size", v.keyimage_filter_size, s);
+	seria_kv("keyimage_filter_lookups", v.keyimage_filter_lookups, s);
+	seria_kv("keyimage_filter_skipped", v.keyimage_filter_skipped, s);
+	seria_kv("keyimage_filter_false_positives", v.keyimage_filter_false_positives, s);
+	seria_kv("reorganization_count", v.reorganization_count, s);
+	seria_kv("last_reorganization_depth", v.last_reorganization_depth, s);
+	seria_kv("max_reorganization_depth", v.max_reorganization_depth, s);
+	seria_kv("last_reorganization_duration", v.last_reorganization_duration, s);
+	seria_kv("output_key_cache_count", v.output_key_cache_count, s);
+	seria_kv("output_key_cache_size", v.output_key_cache_size, s);
+	seria_kv("output_key_cache_hits", v.output_key_cache_hits, s);
+	seria_kv("output_key_cache_misses", v.output_key_cache_misses, s);
+	seria_kv("compact_blocks_received", v.compact_blocks_received, s);
+	seria_kv("compact_blocks_reconstructed", v.compact_blocks_reconstructed, s);
+	seria_kv("compact_blocks_incomplete", v.compact_blocks_incomplete, s);
+	seria_kv("compact_blocks_missing_transactions", v.compact_blocks_missing_transactions, s);
+	seria_kv("compact_blocks_failed", v.compact_blocks_failed, s);
+	seria_kv("compact_blocks_relayed_early", v.compact_blocks_relayed_early, s);
+	seria_kv("p2p_uploaded_bytes", v.p2p_uploaded_bytes, s);
+	seria_kv("p2p_upload_queue_size", v.p2p_upload_queue_size, s);
+	seria_kv("transaction_relay_announced", v.transaction_relay_announced, s);
+	seria_kv("transaction_relay_suppressed", v.transaction_relay_suppressed, s);
+	seria_kv("transaction_relay_messages", v.transaction_relay_messages, s);
 }
 
 void ser_members(BasicNodeData &v, seria::ISeria &s) {
@@ -83,6 +134,7 @@ void ser_members(BasicNodeData &v, seria::ISeria &s) {
 	seria_kv("peer_id", v.peer_id, s);
 	seria_kv("local_time", v.local_time, s);
 	seria_kv("my_port", v.my_port, s);
+	seria_kv_optional("features", v.features, s);
 }
 
 void ser_kv_plus1(common::StringView name, Height &v, seria::ISeria &s) {
@@ -176,6 +228,24 @@ void ser_members(p2p::SyncPool::Response &v, seria::ISeria &s) {
 	seria_kv("transaction_descs", v.transaction_descs, s);
 }
 
+void ser_members(p2p::RelayCompactBlock::Notify &v, seria::ISeria &s) {
+	seria_kv("header", v.header, s);
+	seria_kv("salt", v.salt, s);
+	serialize_as_binary(v.short_ids, "short_ids", s);
+	seria_kv("top_id", v.top_id, s);
+	seria_kv("height", v.current_blockchain_height, s);
+}
+
+void ser_members(p2p::GetBlockTransactions::Request &v, seria::ISeria &s) {
+	seria_kv("block_id", v.block_id, s);
+	serialize_as_binary(v.indexes, "indexes", s);
+}
+
+void ser_members(p2p::GetBlockTransactions::Response &v, seria::ISeria &s) {
+	seria_kv("block_id", v.block_id, s);
+	seria_kv("transactions", v.transactions, s);
+}
+
 bool ser(NetworkAddress &v, seria::ISeria &s) {
 	if (s.is_json()) {
 		if (s.is_input()) {
@@ -207,6 +277,8 @@ void ser_members(ConnectionDesc &v, seria::ISeria &s) {
 	seria_kv("is_incoming", v.is_incoming, s);
 	seria_kv("p2p_version", v.p2p_version, s);
 	seria_kv("top_block_desc", v.top_block_desc, s);
+	seria_kv("uploaded_bytes", v.uploaded_bytes, s);
+	seria_kv("upload_queue_size", v.upload_queue_size, s);
 }
 void ser_members(TopBlockDesc &v, seria::ISeria &s) {
 	seria_kv("hash", v.hash, s);
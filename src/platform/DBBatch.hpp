@@ -0,0 +1,62 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "common/BinaryArray.hpp"
+
+namespace platform {
+
+// Puts and dels collected for DB::write, which applies them sorted by key,
+// so that neighbouring keys are written together instead of random B-tree descents.
+// Sort is stable, several operations on the same key are applied in order of addition.
+class DBBatch {
+public:
+	enum Operation { PUT, PUT_NOOVERWRITE, DEL, DEL_MUSTEXIST };
+	struct Item {
+		std::string key;
+		common::BinaryArray value;
+		Operation operation;
+	};
+	void put(std::string key, common::BinaryArray value, bool nooverwrite) {
+		m_items.push_back(Item{std::move(key), std::move(value), nooverwrite ? PUT_NOOVERWRITE : PUT});
+		m_sorted = false;
+	}
+	void put(std::string key, const std::string &value, bool nooverwrite) {
+		put(std::move(key), common::BinaryArray(value.begin(), value.end()), nooverwrite);
+	}
+	void del(std::string key, bool mustexist) {
+		m_items.push_back(Item{std::move(key), common::BinaryArray{}, mustexist ? DEL_MUSTEXIST : DEL});
+		m_sorted = false;
+	}
+	bool empty() const { return m_items.empty(); }
+	size_t size() const { return m_items.size(); }
+	void clear() {
+		m_items.clear();
+		m_sorted = true;
+	}
+	const std::vector<Item> &sorted_items() {
+		if (!m_sorted)
+			std::stable_sort(
+			    m_items.begin(), m_items.end(), [](const Item &a, const Item &b) { return a.key < b.key; });
+		m_sorted = true;
+		return m_items;
+	}
+	// For multi-get, indexes of keys in the order they should be looked up
+	static std::vector<size_t> sorted_order(const std::vector<std::string> &keys) {
+		std::vector<size_t> order(keys.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+		return order;
+	}
+
+private:
+	std::vector<Item> m_items;
+	bool m_sorted = true;
+};
+
+}  // namespace platform
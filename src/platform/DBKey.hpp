@@ -0,0 +1,53 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include "common/Invariant.hpp"
+#include "common/StringView.hpp"
+#include "common/Varint.hpp"
+
+namespace platform {
+
+// Key built in fixed buffer on stack, DB methods and cursors accept it without conversion to std::string.
+// Prefix + hash + several varints fit, longer keys should stay std::string
+class DBKey {
+public:
+	enum { MAX_SIZE = 64 };
+
+	DBKey() = default;
+	explicit DBKey(common::StringView prefix) { append(prefix); }
+
+	DBKey &append(const void *data, size_t size) {
+		invariant(size <= MAX_SIZE - m_size, "DBKey too long");
+		std::memcpy(m_data + m_size, data, size);
+		m_size += size;
+		return *this;
+	}
+	DBKey &append(common::StringView str) { return append(str.data(), str.size()); }
+	DBKey &append_varint(uint64_t val) {  // sqlite4 varint, keeps lexicographic order
+		unsigned char buf[9];
+		return append(buf, common::write_varint_sqlite4(buf, val));
+	}
+	DBKey &append_ascending(uint32_t val) {  // same as DB::to_ascending_key
+		static const char digits[] = "0123456789ABCDEF";
+		char buf[8];
+		for (size_t i = sizeof(buf); i-- > 0; val >>= 4)
+			buf[i] = digits[val & 0xF];
+		return append(buf, sizeof(buf));
+	}
+
+	const char *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	operator common::StringView() const { return common::StringView(m_data, m_size); }
+	explicit operator std::string() const { return std::string(m_data, m_size); }
+
+private:
+	char m_data[MAX_SIZE];
+	size_t m_size = 0;
+};
+
+}  // namespace platform
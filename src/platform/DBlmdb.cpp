@@ -35,8 +35,9 @@ platform::lmdb::Env::~Env() {
 	handle = nullptr;
 }
 
-platform::lmdb::Txn::Txn(Env &db_env) {
-	lmdb_check(::mdb_txn_begin(db_env.handle, nullptr, db_env.m_read_only ? MDB_RDONLY : 0, &handle), "mdb_txn_begin ");
+platform::lmdb::Txn::Txn(const Env &db_env, bool read_only) {
+	lmdb_check(::mdb_txn_begin(db_env.handle, nullptr, db_env.m_read_only || read_only ? MDB_RDONLY : 0, &handle),
+	    "mdb_txn_begin ");
 }
 
 void platform::lmdb::Txn::commit() {
@@ -86,11 +87,12 @@ DBlmdb::DBlmdb(OpenMode open_mode, const std::string &full_path, uint64_t max_tx
 	               MDB_NOMETASYNC | (open_mode == O_READ_EXISTING ? MDB_RDONLY : 0), 0644),
 	    "Failed to open database " + full_path + " in mdb_env_open ");
 	// MDB_NOMETASYNC - We agree to trade chance of losing 1 last transaction for 2x performance boost
-	resize_and_begin_tx();
+	std::unique_lock<std::mutex> lock(committed_readers_mutex);
+	resize_and_begin_tx(lock);
 	db_dbi = std::make_unique<lmdb::Dbi>(*db_txn);
 }
 
-void DBlmdb::resize_and_begin_tx() {
+void DBlmdb::resize_and_begin_tx(std::unique_lock<std::mutex> &readers_lock) {
 	// VALGRIND is limited to 32GB, modify code appropriately
 
 	MDB_envinfo mei{};
@@ -100,10 +102,15 @@ void DBlmdb::resize_and_begin_tx() {
 	mdb_size_t size_used = sta.ms_psize * mei.me_last_pgno;
 	//	std::cout << "size_used=" << size_used << " mapsize=" << mei.me_mapsize << " max_tx_size=" << max_tx_size <<
 	// std::endl;
+	mdb_size_t new_mapsize = mei.me_mapsize;
 	if (size_used + max_tx_size > mei.me_mapsize) {
-		lmdb_check(::mdb_env_set_mapsize(db_env.handle, mei.me_mapsize + max_tx_size), "mdb_env_set_mapsize");
+		new_mapsize = mei.me_mapsize + max_tx_size;
 	} else if (mei.me_mapsize > size_used + max_tx_size * 10) {
-		lmdb_check(::mdb_env_set_mapsize(db_env.handle, size_used + max_tx_size * 2), "mdb_env_set_mapsize");
+		new_mapsize = size_used + max_tx_size * 2;
+	}
+	if (new_mapsize != mei.me_mapsize) {
+		committed_readers_finished.wait(readers_lock, [&]() { return committed_readers == 0; });
+		lmdb_check(::mdb_env_set_mapsize(db_env.handle, new_mapsize), "mdb_env_set_mapsize");
 	}
 	db_txn = std::make_unique<lmdb::Txn>(db_env);
 }
@@ -121,9 +128,10 @@ size_t DBlmdb::get_approximate_items_count() const {
 }
 
 DBlmdb::Cursor::Cursor(
-    lmdb::Cur &&cur, const std::string &prefix, const std::string &middle, size_t max_key_size, bool forward)
-    : db_cur(std::move(cur)), prefix(prefix), forward(forward) {
-	std::string start = prefix + middle;
+    lmdb::Cur &&cur, common::StringView prefix, common::StringView middle, size_t max_key_size, bool forward)
+    : db_cur(std::move(cur)), prefix(prefix.data(), prefix.size()), forward(forward) {
+	std::string start = this->prefix;
+	start.append(middle.data(), middle.size());
 	lmdb::Val itkey(start);
 	if (forward)
 		is_end = !db_cur.get(itkey, data, start.empty() ? MDB_FIRST : MDB_SET_RANGE);
@@ -171,22 +179,23 @@ common::BinaryArray DBlmdb::Cursor::get_value_array() const {
 	return common::BinaryArray(data.data(), data.data() + data.size());
 }
 
-DBlmdb::Cursor DBlmdb::begin(const std::string &prefix, const std::string &middle, bool forward) const {
+DBlmdb::Cursor DBlmdb::begin(common::StringView prefix, common::StringView middle, bool forward) const {
 	int max_key_size = ::mdb_env_get_maxkeysize(db_env.handle);
 	return Cursor(lmdb::Cur(*db_txn, *db_dbi), prefix, middle, max_key_size, forward);
 }
 
-DBlmdb::Cursor DBlmdb::rbegin(const std::string &prefix, const std::string &middle) const {
+DBlmdb::Cursor DBlmdb::rbegin(common::StringView prefix, common::StringView middle) const {
 	return begin(prefix, middle, false);
 }
 
 void DBlmdb::commit_db_txn() {
+	std::unique_lock<std::mutex> lock(committed_readers_mutex);
 	db_txn->commit();
 	db_txn.reset();
-	resize_and_begin_tx();
+	resize_and_begin_tx(lock);
 }
 
-void DBlmdb::put(const std::string &key, const common::BinaryArray &value, bool nooverwrite) {
+void DBlmdb::put(common::StringView key, const common::BinaryArray &value, bool nooverwrite) {
 	lmdb::Val temp_value(value.data(), value.size());
 	const int rc =
 	    ::mdb_put(db_txn->handle, db_dbi->handle, lmdb::Val(key), temp_value, nooverwrite ? MDB_NOOVERWRITE : 0);
@@ -197,7 +206,7 @@ void DBlmdb::put(const std::string &key, const common::BinaryArray &value, bool
 		    "DBlmdb::put failed or nooverwrite key already exists " + std::string(key.data(), key.size()), rc);
 }
 
-void DBlmdb::put(const std::string &key, const std::string &value, bool nooverwrite) {
+void DBlmdb::put(common::StringView key, const std::string &value, bool nooverwrite) {
 	lmdb::Val temp_value(value.data(), value.size());
 	const int rc =
 	    ::mdb_put(db_txn->handle, db_dbi->handle, lmdb::Val(key), temp_value, nooverwrite ? MDB_NOOVERWRITE : 0);
@@ -208,7 +217,7 @@ void DBlmdb::put(const std::string &key, const std::string &value, bool nooverwr
 		    "DBlmdb::put failed or nooverwrite key already exists " + std::string(key.data(), key.size()), rc);
 }
 
-bool DBlmdb::get(const std::string &key, common::BinaryArray &value) const {
+bool DBlmdb::get(common::StringView key, common::BinaryArray &value) const {
 	lmdb::Val val1;
 	if (!db_dbi->get(*db_txn, lmdb::Val(key), val1))
 		return false;
@@ -216,7 +225,7 @@ bool DBlmdb::get(const std::string &key, common::BinaryArray &value) const {
 	return true;
 }
 
-bool DBlmdb::get(const std::string &key, std::string &value) const {
+bool DBlmdb::get(common::StringView key, std::string &value) const {
 	lmdb::Val val1;
 	if (!db_dbi->get(*db_txn, lmdb::Val(key), val1))
 		return false;
@@ -224,9 +233,15 @@ bool DBlmdb::get(const std::string &key, std::string &value) const {
 	return true;
 }
 
-bool DBlmdb::get(const std::string &key, Value &value) const { return db_dbi->get(*db_txn, lmdb::Val(key), value); }
+bool DBlmdb::get(common::StringView key, Value &value) const {
+	lmdb::Val val1;
+	if (!db_dbi->get(*db_txn, lmdb::Val(key), val1))
+		return false;
+	value = Value(val1.data(), val1.size());
+	return true;
+}
 
-void DBlmdb::del(const std::string &key, bool mustexist) {
+void DBlmdb::del(common::StringView key, bool mustexist) {
 	const int rc = ::mdb_del(db_txn->handle, db_dbi->handle, lmdb::Val(key), nullptr);
 	if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
 		lmdb::Error::do_throw("DBlmdb::del failed " + std::string(key.data(), key.size()), rc);
@@ -235,12 +250,97 @@ void DBlmdb::del(const std::string &key, bool mustexist) {
 		lmdb::Error::do_throw("DBlmdb::del key does not exist " + std::string(key.data(), key.size()), rc);
 }
 
-std::string DBlmdb::to_ascending_key(uint32_t key) {
-	char buf[32] = {};
-	sprintf(buf, "%08X", key);
-	return std::string(buf);
+void DBlmdb::write(DBBatch &batch) {
+	if (batch.empty())
+		return;
+	// Single cursor, so LMDB does not descend from root for keys on the same page.
+	// Keys after the last DB key are appended, this is the case for new DB or new highest prefix
+	lmdb::Cur cur(*db_txn, *db_dbi);
+	lmdb::Val last_key, last_data;
+	bool db_empty = !cur.get(last_key, last_data, MDB_LAST);
+	std::string last(last_key.data(), last_key.size());
+	for (const auto &item : batch.sorted_items()) {
+		lmdb::Val key(item.key);
+		if (item.operation == DBBatch::DEL || item.operation == DBBatch::DEL_MUSTEXIST) {
+			lmdb::Val data;
+			if (cur.get(key, data, MDB_SET))
+				lmdb_check(::mdb_cursor_del(cur.handle, 0), "mdb_cursor_del ");
+			else if (item.operation == DBBatch::DEL_MUSTEXIST)
+				lmdb::Error::do_throw("DBlmdb::write del key does not exist " + item.key, MDB_NOTFOUND);
+			continue;
+		}
+		const bool append = db_empty || last < item.key;
+		lmdb::Val data(item.value.data(), item.value.size());
+		const unsigned flags =
+		    append ? MDB_APPEND : item.operation == DBBatch::PUT_NOOVERWRITE ? MDB_NOOVERWRITE : 0;
+		const int rc = ::mdb_cursor_put(cur.handle, key, data, flags);
+		if (rc == MDB_KEYEXIST)
+			lmdb::Error::do_throw("DBlmdb::write nooverwrite key already exists " + item.key, rc);
+		lmdb_check(rc, "DBlmdb::write failed ");
+		if (append) {
+			last     = item.key;
+			db_empty = false;
+		}
+	}
+	batch.clear();
+}
+
+size_t DBlmdb::get_many(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	values->assign(keys.size(), common::BinaryArray{});
+	found->assign(keys.size(), false);
+	size_t count = 0;
+	lmdb::Cur cur(*db_txn, *db_dbi);
+	for (size_t i : DBBatch::sorted_order(keys)) {
+		lmdb::Val key(keys[i]), data;
+		if (!cur.get(key, data, MDB_SET))
+			continue;
+		values->at(i).assign(data.data(), data.data() + data.size());
+		found->at(i) = true;
+		count += 1;
+	}
+	return count;
+}
+
+bool DBlmdb::get_many_committed(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	values->assign(keys.size(), common::BinaryArray{});
+	found->assign(keys.size(), false);
+	std::unique_ptr<lmdb::Txn> read_txn;
+	{  // Lookups below run without mutex, so workers do not wait for each other or for commit_db_txn
+		std::unique_lock<std::mutex> lock(committed_readers_mutex);
+		if (!db_txn)
+			return false;  // commit_db_txn waits for readers to change mapsize, prefetch is only a hint
+		read_txn = std::make_unique<lmdb::Txn>(db_env, true);  // Sees only committed data
+		committed_readers += 1;
+	}
+	try {
+		lmdb::Cur cur(*read_txn, *db_dbi);
+		for (size_t i : DBBatch::sorted_order(keys)) {
+			lmdb::Val key(keys[i]), data;
+			if (!cur.get(key, data, MDB_SET))
+				continue;
+			values->at(i).assign(data.data(), data.data() + data.size());
+			found->at(i) = true;
+		}
+	} catch (...) {
+		end_committed_read(std::move(read_txn));
+		throw;
+	}
+	end_committed_read(std::move(read_txn));
+	return true;
+}
+
+void DBlmdb::end_committed_read(std::unique_ptr<lmdb::Txn> &&read_txn) const {
+	read_txn.reset();
+	std::unique_lock<std::mutex> lock(committed_readers_mutex);
+	committed_readers -= 1;
+	if (committed_readers == 0)
+		committed_readers_finished.notify_all();
 }
 
+std::string DBlmdb::to_ascending_key(uint32_t key) { return std::string(DBKey().append_ascending(key)); }
+
 uint32_t DBlmdb::from_ascending_key(const std::string &key) {
 	return common::integer_cast<uint32_t>(std::stoull(key, nullptr, 16));
 }
@@ -355,6 +455,39 @@ void DBlmdb::run_tests() {
 		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
 			std::cout << cur.get_suffix() << std::endl;
 		}
+		std::cout << "-- batch --" << std::endl;
+		DBBatch batch;
+		batch.put("zero/zb", std::string("zb"), true);
+		batch.put("history/ha", std::string("uab"), false);
+		batch.del("unspent/ub", false);
+		batch.put("zero/za", std::string("za"), true);
+		batch.del("zero/za", true);  // operations on the same key are applied in order
+		db.write(batch);
+		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
+			std::cout << cur.get_suffix() << " " << cur.get_value_string() << std::endl;
+		}
+		std::vector<common::BinaryArray> values;
+		std::vector<bool> found;
+		const size_t count = db.get_many({"zero/zb", "alpha/a", "history/ha"}, &values, &found);
+		std::cout << "get_many count=" << count << std::endl;
+		for (size_t i = 0; i != values.size(); ++i)
+			std::cout << found.at(i) << " " << std::string(values.at(i).begin(), values.at(i).end()) << std::endl;
+		Value view;
+		const bool view_found = db.get("zero/zb", view);
+		std::cout << "view found=" << view_found << " " << std::string(view) << std::endl;
+		DBKey key("zero/");
+		key.append_varint(300).append_ascending(0xBEEF);
+		db.put(key, std::string("zk"), false);
+		const bool key_found = db.get(key, view);
+		std::cout << "key found=" << key_found << " " << std::string(view) << " ascending=" << to_ascending_key(0xBEEF)
+		          << std::endl;
+		batch.put("zero/zb", std::string("zbb"), true);
+		try {
+			db.write(batch);
+			std::cout << "value erroneously overwritten" << std::endl;
+		} catch (...) {
+		}
+		batch.clear();
 	}
 	delete_db("temp_db");
 }
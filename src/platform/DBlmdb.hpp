@@ -5,11 +5,16 @@
 
 #include <lmdb.h>
 #include <algorithm>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include "DBBatch.hpp"
+#include "DBKey.hpp"
 #include "Files.hpp"  // For OpenMode
 #include "common/BinaryArray.hpp"
 #include "common/Nocopy.hpp"
+#include "common/StringView.hpp"
 
 namespace platform {
 
@@ -19,6 +24,7 @@ struct Val {
 
 	Val() noexcept {}
 	explicit Val(const std::string &data) noexcept : Val{data.data(), data.size()} {}
+	explicit Val(common::StringView data) noexcept : Val{data.data(), data.size()} {}
 	Val(const void *const data, const std::size_t size) noexcept : impl{size, const_cast<void *>(data)} {}
 	operator MDB_val *() noexcept { return &impl; }
 	operator const MDB_val *() const noexcept { return &impl; }
@@ -35,7 +41,7 @@ struct Env : private common::Nocopy {
 };
 struct Txn : private common::Nocopy {
 	MDB_txn *handle = nullptr;
-	explicit Txn(Env &db_env);
+	explicit Txn(const Env &db_env, bool read_only = false);
 	void commit();
 	~Txn();
 };
@@ -65,7 +71,13 @@ class DBlmdb {
 	std::unique_ptr<lmdb::Txn> db_txn;
 
 	uint64_t max_tx_size;
-	void resize_and_begin_tx();
+	// mapsize cannot be changed while read txns are active, so get_many_committed registers them here.
+	// db_txn pointer is only changed under mutex, it is nullptr while commit_db_txn waits for readers
+	mutable std::mutex committed_readers_mutex;
+	mutable std::condition_variable committed_readers_finished;
+	mutable size_t committed_readers = 0;
+	void resize_and_begin_tx(std::unique_lock<std::mutex> &readers_lock);
+	void end_committed_read(std::unique_ptr<lmdb::Txn> &&read_txn) const;
 
 public:
 	explicit DBlmdb(OpenMode open_mode, const std::string &full_path,
@@ -75,16 +87,27 @@ public:
 	size_t test_get_approximate_size() const;
 	size_t get_approximate_items_count() const;
 
-	void put(const std::string &key, const common::BinaryArray &value, bool nooverwrite);
-	void put(const std::string &key, const std::string &value, bool nooverwrite);
+	void put(common::StringView key, const common::BinaryArray &value, bool nooverwrite);
+	void put(common::StringView key, const std::string &value, bool nooverwrite);
 
-	bool get(const std::string &key, common::BinaryArray &value) const;
-	bool get(const std::string &key, std::string &value) const;
+	bool get(common::StringView key, common::BinaryArray &value) const;
+	bool get(common::StringView key, std::string &value) const;
 
-	typedef lmdb::Val Value;
-	bool get(const std::string &key, Value &value) const;
+	// View into DB memory without copy, valid until next get or modification of DB
+	typedef common::StringView Value;
+	bool get(common::StringView key, Value &value) const;
 
-	void del(const std::string &key, bool mustexist);
+	void del(common::StringView key, bool mustexist);
+
+	// Applies batch in key order and clears it
+	void write(DBBatch &batch);
+	// Looks keys up in key order, values and found are resized to keys.size(). Returns number of found keys
+	size_t get_many(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
+	// Same, but reads last committed state and can be called from any thread, for prefetching DB pages
+	// before main thread needs them. Returns false if backend does not support this or commit is resizing DB
+	bool get_many_committed(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
 
 	class Cursor {
 		lmdb::Cur db_cur;
@@ -95,20 +118,22 @@ public:
 		const bool forward;
 		void check_prefix(const lmdb::Val &itkey);
 		friend class DBlmdb;
-		Cursor(lmdb::Cur &&db_cur, const std::string &prefix, const std::string &middle, size_t max_key_size,
+		Cursor(lmdb::Cur &&db_cur, common::StringView prefix, common::StringView middle, size_t max_key_size,
 		    bool forward);
 
 	public:
 		const std::string &get_suffix() const noexcept { return suffix; }
 		std::string get_value_string() const;
 		common::BinaryArray get_value_array() const;
+		Value get_value() const { return Value(data.data(), data.size()); }
 		bool end() const noexcept { return is_end; }
 		void next();
 		void erase();  // moves to the next value
 	};
-	Cursor begin(const std::string &prefix, const std::string &middle = std::string{}, bool forward = true) const;
-	Cursor rbegin(const std::string &prefix, const std::string &middle = std::string{}) const;
+	Cursor begin(common::StringView prefix, common::StringView middle = common::StringView{}, bool forward = true) const;
+	Cursor rbegin(common::StringView prefix, common::StringView middle = common::StringView{}) const;
 
+	typedef DBKey Key;  // Built on stack, for hot paths instead of concatenating strings
 	static std::string to_binary_key(const unsigned char *data, size_t size) {
 		std::string result;
 		result.append(reinterpret_cast<const char *>(data), size);
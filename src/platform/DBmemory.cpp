@@ -16,7 +16,7 @@
 
 using namespace platform;
 
-int DBmemory::CmpByUnsigned::compare(const std::string &a, const std::string &b) const {
+int DBmemory::CmpByUnsigned::compare(common::StringView a, common::StringView b) const {
 	size_t s = std::min(a.size(), b.size());
 	int res  = memcmp(a.data(), b.data(), s);
 	if (res != 0)
@@ -63,9 +63,10 @@ size_t DBmemory::test_get_approximate_size() const { return total_size; }
 
 size_t DBmemory::get_approximate_items_count() const { return storage.size(); }
 
-DBmemory::Cursor::Cursor(DBmemory *db, const std::string &prefix, const std::string &middle, bool forward)
-    : db(db), prefix(prefix), forward(forward) {
-	std::string start  = prefix + middle;
+DBmemory::Cursor::Cursor(DBmemory *db, common::StringView prefix, common::StringView middle, bool forward)
+    : db(db), prefix(prefix.data(), prefix.size()), forward(forward) {
+	std::string start = this->prefix;
+	start.append(middle.data(), middle.size());
 	std::string finish = start;
 	if (finish.size() < db->max_key_size)
 		finish += std::string(db->max_key_size - finish.size(), char(0xff));  // char('~')
@@ -124,11 +125,11 @@ void DBmemory::Cursor::erase() {
 std::string DBmemory::Cursor::get_value_string() const { return common::as_string(it->second); }
 common::BinaryArray DBmemory::Cursor::get_value_array() const { return it->second; }
 
-DBmemory::Cursor DBmemory::begin(const std::string &prefix, const std::string &middle, bool forward) const {
+DBmemory::Cursor DBmemory::begin(common::StringView prefix, common::StringView middle, bool forward) const {
 	return Cursor(const_cast<DBmemory *>(this), prefix, middle, forward);
 }
 
-DBmemory::Cursor DBmemory::rbegin(const std::string &prefix, const std::string &middle) const {
+DBmemory::Cursor DBmemory::rbegin(common::StringView prefix, common::StringView middle) const {
 	return begin(prefix, middle, false);
 }
 
@@ -157,15 +158,15 @@ void DBmemory::commit_db_txn() {
 #endif
 }
 
-void DBmemory::put(const std::string &key, const common::BinaryArray &value, bool nooverwrite) {
-	auto res = storage.emplace(key, value);
+void DBmemory::put(common::StringView key, const common::BinaryArray &value, bool nooverwrite) {
+	auto res = storage.emplace(std::string(key.data(), key.size()), value);
 	if (res.second) {
 		total_size += key.size() + value.size();
 		//		if (key.size() > max_key_size)
 		//			std::cout << "max_key_size=" << key.size() << std::endl;
 		max_key_size = std::max(max_key_size, key.size());
 		if (use_journal)
-			journal.push_back(JournalEntry{key, value, false});
+			journal.push_back(JournalEntry{res.first->first, value, false});
 		return;
 	}
 	if (nooverwrite)
@@ -174,14 +175,14 @@ void DBmemory::put(const std::string &key, const common::BinaryArray &value, boo
 	total_size += value.size();
 	res.first->second = value;
 	if (use_journal)
-		journal.push_back(JournalEntry{key, value, false});
+		journal.push_back(JournalEntry{res.first->first, value, false});
 }
 
-void DBmemory::put(const std::string &key, const std::string &svalue, bool nooverwrite) {
+void DBmemory::put(common::StringView key, const std::string &svalue, bool nooverwrite) {
 	put(key, common::as_binary_array(svalue), nooverwrite);
 }
 
-bool DBmemory::get(const std::string &key, common::BinaryArray &value) const {
+bool DBmemory::get(common::StringView key, common::BinaryArray &value) const {
 	auto it = storage.find(key);
 	if (it == storage.end())
 		return false;
@@ -189,7 +190,7 @@ bool DBmemory::get(const std::string &key, common::BinaryArray &value) const {
 	return true;
 }
 
-bool DBmemory::get(const std::string &key, std::string &value) const {
+bool DBmemory::get(common::StringView key, std::string &value) const {
 	auto it = storage.find(key);
 	if (it == storage.end())
 		return false;
@@ -197,7 +198,15 @@ bool DBmemory::get(const std::string &key, std::string &value) const {
 	return true;
 }
 
-void DBmemory::del(const std::string &key, bool mustexist) {
+bool DBmemory::get(common::StringView key, Value &value) const {
+	auto it = storage.find(key);
+	if (it == storage.end())
+		return false;
+	value = Value(reinterpret_cast<const char *>(it->second.data()), it->second.size());
+	return true;
+}
+
+void DBmemory::del(common::StringView key, bool mustexist) {
 	auto it = storage.find(key);
 	if (it == storage.end()) {
 		if (mustexist)
@@ -207,15 +216,48 @@ void DBmemory::del(const std::string &key, bool mustexist) {
 	total_size -= key.size() + it->second.size();
 	it = storage.erase(it);
 	if (use_journal)
-		journal.push_back(JournalEntry{key, common::BinaryArray{}, true});
+		journal.push_back(JournalEntry{std::string(key.data(), key.size()), common::BinaryArray{}, true});
+}
+
+void DBmemory::write(DBBatch &batch) {
+	for (const auto &item : batch.sorted_items()) {
+		switch (item.operation) {
+		case DBBatch::PUT:
+		case DBBatch::PUT_NOOVERWRITE:
+			put(item.key, item.value, item.operation == DBBatch::PUT_NOOVERWRITE);
+			break;
+		case DBBatch::DEL:
+		case DBBatch::DEL_MUSTEXIST:
+			del(item.key, item.operation == DBBatch::DEL_MUSTEXIST);
+			break;
+		}
+	}
+	batch.clear();
 }
 
-std::string DBmemory::to_ascending_key(uint32_t key) {
-	char buf[32] = {};
-	sprintf(buf, "%08X", key);
-	return std::string(buf);
+size_t DBmemory::get_many(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	values->assign(keys.size(), common::BinaryArray{});
+	found->assign(keys.size(), false);
+	size_t count = 0;
+	for (size_t i : DBBatch::sorted_order(keys)) {
+		auto it = storage.find(keys[i]);
+		if (it == storage.end())
+			continue;
+		values->at(i) = it->second;
+		found->at(i)  = true;
+		count += 1;
+	}
+	return count;
+}
+
+bool DBmemory::get_many_committed(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	return false;  // Storage is modified by main thread without locking
 }
 
+std::string DBmemory::to_ascending_key(uint32_t key) { return std::string(DBKey().append_ascending(key)); }
+
 uint32_t DBmemory::from_ascending_key(const std::string &key) {
 	long long unsigned val = 0;
 	if (sscanf(key.c_str(), "%llx", &val) != 1)
@@ -347,6 +389,39 @@ void DBmemory::run_tests() {
 		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
 			std::cout << cur.get_suffix() << std::endl;
 		}
+		std::cout << "-- batch --" << std::endl;
+		DBBatch batch;
+		batch.put("zero/zb", std::string("zb"), true);
+		batch.put("history/ha", std::string("uab"), false);
+		batch.del("unspent/ub", false);
+		batch.put("zero/za", std::string("za"), true);
+		batch.del("zero/za", true);  // operations on the same key are applied in order
+		db.write(batch);
+		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
+			std::cout << cur.get_suffix() << " " << cur.get_value_string() << std::endl;
+		}
+		std::vector<common::BinaryArray> values;
+		std::vector<bool> found;
+		const size_t count = db.get_many({"zero/zb", "alpha/a", "history/ha"}, &values, &found);
+		std::cout << "get_many count=" << count << std::endl;
+		for (size_t i = 0; i != values.size(); ++i)
+			std::cout << found.at(i) << " " << std::string(values.at(i).begin(), values.at(i).end()) << std::endl;
+		Value view;
+		const bool view_found = db.get("zero/zb", view);
+		std::cout << "view found=" << view_found << " " << std::string(view) << std::endl;
+		DBKey key("zero/");
+		key.append_varint(300).append_ascending(0xBEEF);
+		db.put(key, std::string("zk"), false);
+		const bool key_found = db.get(key, view);
+		std::cout << "key found=" << key_found << " " << std::string(view) << " ascending=" << to_ascending_key(0xBEEF)
+		          << std::endl;
+		batch.put("zero/zb", std::string("zbb"), true);
+		try {
+			db.write(batch);
+			std::cout << "value erroneously overwritten" << std::endl;
+		} catch (...) {
+		}
+		batch.clear();
 	}
 	delete_db("temp_db");
 }
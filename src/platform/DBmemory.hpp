@@ -6,9 +6,12 @@
 #include <functional>
 #include <map>
 #include <string>
+#include "DBBatch.hpp"
+#include "DBKey.hpp"
 #include "Files.hpp"  // For OpenMode
 #include "common/BinaryArray.hpp"
 #include "common/Nocopy.hpp"
+#include "common/StringView.hpp"
 
 namespace platform {
 
@@ -20,10 +23,10 @@ public:
 		common::BinaryArray value;
 		bool is_deleted = false;
 	};
-	typedef common::BinaryArray Value;
 	struct CmpByUnsigned {
-		int compare(const std::string &a, const std::string &b) const;
-		bool operator()(const std::string &a, const std::string &b) const { return compare(a, b) < 0; }
+		typedef void is_transparent;  // find by StringView without constructing std::string
+		int compare(common::StringView a, common::StringView b) const;
+		bool operator()(common::StringView a, common::StringView b) const { return compare(a, b) < 0; }
 	};
 	typedef std::map<std::string, common::BinaryArray, CmpByUnsigned> Storage;
 
@@ -37,13 +40,27 @@ public:
 	size_t test_get_approximate_size() const;
 	size_t get_approximate_items_count() const;
 
-	void put(const std::string &key, const common::BinaryArray &value, bool nooverwrite);
-	void put(const std::string &key, const std::string &value, bool nooverwrite);
+	void put(common::StringView key, const common::BinaryArray &value, bool nooverwrite);
+	void put(common::StringView key, const std::string &value, bool nooverwrite);
 
-	bool get(const std::string &key, common::BinaryArray &value) const;
-	bool get(const std::string &key, std::string &value) const;
+	bool get(common::StringView key, common::BinaryArray &value) const;
+	bool get(common::StringView key, std::string &value) const;
 
-	void del(const std::string &key, bool mustexist);
+	// View into DB memory without copy, valid until next get or modification of DB
+	typedef common::StringView Value;
+	bool get(common::StringView key, Value &value) const;
+
+	void del(common::StringView key, bool mustexist);
+
+	// Applies batch in key order and clears it
+	void write(DBBatch &batch);
+	// Looks keys up in key order, values and found are resized to keys.size(). Returns number of found keys
+	size_t get_many(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
+	// Same, but reads last committed state and can be called from any thread, for prefetching DB pages
+	// before main thread needs them. Returns false if backend does not support this
+	bool get_many_committed(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
 
 	class Cursor {
 		DBmemory *const db;
@@ -53,20 +70,24 @@ public:
 		std::map<std::string, common::BinaryArray>::iterator it;
 		friend class DBmemory;
 		void check_prefix();
-		Cursor(DBmemory *db, const std::string &prefix, const std::string &middle, bool forward);
+		Cursor(DBmemory *db, common::StringView prefix, common::StringView middle, bool forward);
 
 	public:
 		const std::string &get_suffix() const noexcept { return suffix; }
 		std::string get_value_string() const;
 		common::BinaryArray get_value_array() const;
+		Value get_value() const {
+			return Value(reinterpret_cast<const char *>(it->second.data()), it->second.size());
+		}
 		bool end() const noexcept { return it == db->storage.end(); }
 		void next();
 		void erase();  // moves to the next value
 	};
 	friend class Cursor;
-	Cursor begin(const std::string &prefix, const std::string &middle = std::string{}, bool forward = true) const;
-	Cursor rbegin(const std::string &prefix, const std::string &middle = std::string{}) const;
+	Cursor begin(common::StringView prefix, common::StringView middle = common::StringView{}, bool forward = true) const;
+	Cursor rbegin(common::StringView prefix, common::StringView middle = common::StringView{}) const;
 
+	typedef DBKey Key;  // Built on stack, for hot paths instead of concatenating strings
 	static std::string to_binary_key(const unsigned char *data, size_t size) {
 		std::string result;
 		result.append(reinterpret_cast<const char *>(data), size);
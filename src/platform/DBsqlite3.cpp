@@ -125,11 +125,12 @@ static const size_t max_key_size = 255;
 
 DBsqliteKV::Cursor::Cursor(const DBsqliteKV *db,
     const sqlite::Dbi &db_dbi,
-    const std::string &prefix,
-    const std::string &middle,
+    common::StringView prefix,
+    common::StringView middle,
     bool forward)
-    : db(db), prefix(prefix) {
-	std::string start  = prefix + middle;
+    : db(db), prefix(prefix.data(), prefix.size()) {
+	std::string start = this->prefix;
+	start.append(middle.data(), middle.size());
 	std::string finish = start;
 	if (finish.size() < max_key_size)
 		finish += std::string(max_key_size - finish.size(), char(0xff));  // char('~')
@@ -179,11 +180,11 @@ void DBsqliteKV::Cursor::step_and_check() {
 std::string DBsqliteKV::Cursor::get_value_string() const { return std::string(data, size); }
 common::BinaryArray DBsqliteKV::Cursor::get_value_array() const { return common::BinaryArray(data, data + size); }
 
-DBsqliteKV::Cursor DBsqliteKV::begin(const std::string &prefix, const std::string &middle, bool forward) const {
+DBsqliteKV::Cursor DBsqliteKV::begin(common::StringView prefix, common::StringView middle, bool forward) const {
 	return Cursor(this, db_dbi, prefix, middle, forward);
 }
 
-DBsqliteKV::Cursor DBsqliteKV::rbegin(const std::string &prefix, const std::string &middle) const {
+DBsqliteKV::Cursor DBsqliteKV::rbegin(common::StringView prefix, common::StringView middle) const {
 	return begin(prefix, middle, false);
 }
 
@@ -192,7 +193,7 @@ void DBsqliteKV::commit_db_txn() {
 	db_dbi.begin_txn();
 }
 
-static void put(sqlite::Stmt &stmt, const std::string &key, const void *data, size_t size) {
+static void put(sqlite::Stmt &stmt, common::StringView key, const void *data, size_t size) {
 	invariant(data || size == 0, "");
 	sqlite3_reset(stmt.handle);
 	stmt.bind_blob(1, key.data(), key.size());
@@ -200,17 +201,17 @@ static void put(sqlite::Stmt &stmt, const std::string &key, const void *data, si
 	invariant(!stmt.step(), "put returned rows");
 }
 
-void DBsqliteKV::put(const std::string &key, const common::BinaryArray &value, bool nooverwrite) {
+void DBsqliteKV::put(common::StringView key, const common::BinaryArray &value, bool nooverwrite) {
 	sqlite::Stmt &stmt = nooverwrite ? stmt_insert : stmt_update;
 	::put(stmt, key, value.data(), value.size());
 }
 
-void DBsqliteKV::put(const std::string &key, const std::string &value, bool nooverwrite) {
+void DBsqliteKV::put(common::StringView key, const std::string &value, bool nooverwrite) {
 	sqlite::Stmt &stmt = nooverwrite ? stmt_insert : stmt_update;
 	::put(stmt, key, value.data(), value.size());
 }
 
-static std::pair<const unsigned char *, size_t> get(const sqlite::Stmt &stmt, const std::string &key) {
+static std::pair<const unsigned char *, size_t> get(const sqlite::Stmt &stmt, common::StringView key) {
 	sqlite3_reset(stmt.handle);
 	stmt.bind_blob(1, key.data(), key.size());
 	if (!stmt.step())
@@ -220,7 +221,7 @@ static std::pair<const unsigned char *, size_t> get(const sqlite::Stmt &stmt, co
 	return std::make_pair(da, si);
 }
 
-bool DBsqliteKV::get(const std::string &key, common::BinaryArray &value) const {
+bool DBsqliteKV::get(common::StringView key, common::BinaryArray &value) const {
 	auto result = ::get(stmt_get, key);
 	if (!result.first)
 		return false;
@@ -228,7 +229,7 @@ bool DBsqliteKV::get(const std::string &key, common::BinaryArray &value) const {
 	return true;
 }
 
-bool DBsqliteKV::get(const std::string &key, std::string &value) const {
+bool DBsqliteKV::get(common::StringView key, std::string &value) const {
 	auto result = ::get(stmt_get, key);
 	if (!result.first)
 		return false;
@@ -236,7 +237,15 @@ bool DBsqliteKV::get(const std::string &key, std::string &value) const {
 	return true;
 }
 
-void DBsqliteKV::del(const std::string &key, bool mustexist) {
+bool DBsqliteKV::get(common::StringView key, Value &value) const {
+	auto result = ::get(stmt_get, key);  // Points into statement row until next reset
+	if (!result.first)
+		return false;
+	value = Value(reinterpret_cast<const char *>(result.first), result.second);
+	return true;
+}
+
+void DBsqliteKV::del(common::StringView key, bool mustexist) {
 	sqlite3_reset(stmt_del.handle);
 	stmt_del.bind_blob(1, key.data(), key.size());
 	invariant(!stmt_del.step(), "sqlite del returned rows");
@@ -245,12 +254,45 @@ void DBsqliteKV::del(const std::string &key, bool mustexist) {
 		throw platform::sqlite::Error("DB::del row does not exits");
 }
 
-std::string DBsqliteKV::to_ascending_key(uint32_t key) {
-	char buf[32] = {};
-	sprintf(buf, "%08X", key);
-	return std::string(buf);
+void DBsqliteKV::write(DBBatch &batch) {
+	for (const auto &item : batch.sorted_items()) {  // Neighbouring keys are on the same B-tree pages
+		switch (item.operation) {
+		case DBBatch::PUT:
+		case DBBatch::PUT_NOOVERWRITE:
+			put(item.key, item.value, item.operation == DBBatch::PUT_NOOVERWRITE);
+			break;
+		case DBBatch::DEL:
+		case DBBatch::DEL_MUSTEXIST:
+			del(item.key, item.operation == DBBatch::DEL_MUSTEXIST);
+			break;
+		}
+	}
+	batch.clear();
+}
+
+size_t DBsqliteKV::get_many(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	values->assign(keys.size(), common::BinaryArray{});
+	found->assign(keys.size(), false);
+	size_t count = 0;
+	for (size_t i : DBBatch::sorted_order(keys)) {
+		auto result = ::get(stmt_get, keys[i]);
+		if (!result.first)
+			continue;
+		values->at(i).assign(result.first, result.first + result.second);
+		found->at(i) = true;
+		count += 1;
+	}
+	return count;
 }
 
+bool DBsqliteKV::get_many_committed(
+    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const {
+	return false;  // Connection is used by main thread only
+}
+
+std::string DBsqliteKV::to_ascending_key(uint32_t key) { return std::string(DBKey().append_ascending(key)); }
+
 uint32_t DBsqliteKV::from_ascending_key(const std::string &key) {
 	long long unsigned val = 0;
 	if (sscanf(key.c_str(), "%llx", &val) != 1)
@@ -404,6 +446,39 @@ void DBsqliteKV::run_tests() {
 		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
 			std::cout << cur.get_suffix() << std::endl;
 		}
+		std::cout << "-- batch --" << std::endl;
+		DBBatch batch;
+		batch.put("zero/zb", std::string("zb"), true);
+		batch.put("history/ha", std::string("uab"), false);
+		batch.del("unspent/ub", false);
+		batch.put("zero/za", std::string("za"), true);
+		batch.del("zero/za", true);  // operations on the same key are applied in order
+		db.write(batch);
+		for (auto cur = db.begin(std::string{}); !cur.end(); cur.next()) {
+			std::cout << cur.get_suffix() << " " << cur.get_value_string() << std::endl;
+		}
+		std::vector<common::BinaryArray> values;
+		std::vector<bool> found;
+		const size_t count = db.get_many({"zero/zb", "alpha/a", "history/ha"}, &values, &found);
+		std::cout << "get_many count=" << count << std::endl;
+		for (size_t i = 0; i != values.size(); ++i)
+			std::cout << found.at(i) << " " << std::string(values.at(i).begin(), values.at(i).end()) << std::endl;
+		Value view;
+		const bool view_found = db.get("zero/zb", view);
+		std::cout << "view found=" << view_found << " " << std::string(view) << std::endl;
+		DBKey key("zero/");
+		key.append_varint(300).append_ascending(0xBEEF);
+		db.put(key, std::string("zk"), false);
+		const bool key_found = db.get(key, view);
+		std::cout << "key found=" << key_found << " " << std::string(view) << " ascending=" << to_ascending_key(0xBEEF)
+		          << std::endl;
+		batch.put("zero/zb", std::string("zbb"), true);
+		try {
+			db.write(batch);
+			std::cout << "value erroneously overwritten" << std::endl;
+		} catch (...) {
+		}
+		batch.clear();
 	}
 	delete_db("temp_db");
 }
@@ -6,9 +6,12 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include "DBBatch.hpp"
+#include "DBKey.hpp"
 #include "Files.hpp"  // For OpenMode
 #include "common/BinaryArray.hpp"
 #include "common/Nocopy.hpp"
+#include "common/StringView.hpp"
 #include "sqlite/sqlite3.h"
 
 namespace platform {
@@ -61,16 +64,27 @@ public:
 	size_t test_get_approximate_size() const;
 	size_t get_approximate_items_count() const;
 
-	void put(const std::string &key, const common::BinaryArray &value, bool nooverwrite);
-	void put(const std::string &key, const std::string &value, bool nooverwrite);
+	void put(common::StringView key, const common::BinaryArray &value, bool nooverwrite);
+	void put(common::StringView key, const std::string &value, bool nooverwrite);
 
-	bool get(const std::string &key, common::BinaryArray &value) const;
-	bool get(const std::string &key, std::string &value) const;
+	bool get(common::StringView key, common::BinaryArray &value) const;
+	bool get(common::StringView key, std::string &value) const;
 
-	typedef std::string Value;
-	//	bool get(const std::string &key, lmdb::Val &value) const;
+	// View into DB memory without copy, valid until next get or modification of DB
+	typedef common::StringView Value;
+	bool get(common::StringView key, Value &value) const;
 
-	void del(const std::string &key, bool mustexist);
+	void del(common::StringView key, bool mustexist);
+
+	// Applies batch in key order and clears it
+	void write(DBBatch &batch);
+	// Looks keys up in key order, values and found are resized to keys.size(). Returns number of found keys
+	size_t get_many(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
+	// Same, but reads last committed state and can be called from any thread, for prefetching DB pages
+	// before main thread needs them. Returns false if backend does not support this
+	bool get_many_committed(
+	    const std::vector<std::string> &keys, std::vector<common::BinaryArray> *values, std::vector<bool> *found) const;
 
 	class Cursor {
 		const DBsqliteKV *const db;
@@ -82,20 +96,22 @@ public:
 		const std::string prefix;
 		void step_and_check();
 		friend class DBsqliteKV;
-		Cursor(const DBsqliteKV *db, const sqlite::Dbi &db_dbi, const std::string &prefix, const std::string &middle,
+		Cursor(const DBsqliteKV *db, const sqlite::Dbi &db_dbi, common::StringView prefix, common::StringView middle,
 		    bool forward);
 
 	public:
 		const std::string &get_suffix() const noexcept { return suffix; }
 		std::string get_value_string() const;
 		common::BinaryArray get_value_array() const;
+		Value get_value() const { return Value(data, size); }
 		bool end() const noexcept { return is_end; }
 		void next();
 		void erase();  // moves to the next value
 	};
-	Cursor begin(const std::string &prefix, const std::string &middle = std::string{}, bool forward = true) const;
-	Cursor rbegin(const std::string &prefix, const std::string &middle = std::string{}) const;
+	Cursor begin(common::StringView prefix, common::StringView middle = common::StringView{}, bool forward = true) const;
+	Cursor rbegin(common::StringView prefix, common::StringView middle = common::StringView{}) const;
 
+	typedef DBKey Key;  // Built on stack, for hot paths instead of concatenating strings
 	static std::string to_binary_key(const unsigned char *data, size_t size) {
 		std::string result;
 		result.append(reinterpret_cast<const char *>(data), size);
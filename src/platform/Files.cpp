@@ -13,6 +13,7 @@
 #else
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 
@@ -171,3 +172,70 @@ std::string FileStream::utf16_to_utf8(const std::wstring &str) {
 }
 
 #endif
+
+MappedFile::MappedFile(const std::string &filename, OpenMode mode)
+    : m_file(filename, mode), m_read_only(mode == O_READ_EXISTING) {
+	m_size = m_file.seek(0, SEEK_END);
+	map();
+}
+
+MappedFile::~MappedFile() { unmap(); }
+
+void MappedFile::resize(uint64_t size) {
+	if (size == m_size)
+		return;
+	unmap();
+	m_file.truncate(size);
+	m_size = size;
+	map();
+}
+
+void MappedFile::map() {
+	if (m_size == 0)
+		return;  // Empty files cannot be mapped
+	const size_t si = common::integer_cast<size_t>(m_size);
+#ifdef _WIN32
+	mapping = CreateFileMappingW(m_file.handle, nullptr, m_read_only ? PAGE_READONLY : PAGE_READWRITE, 0, 0, nullptr);
+	if (!mapping)
+		throw common::StreamError("Error mapping file, GetLastError()=" + common::to_string(GetLastError()));
+	m_data = reinterpret_cast<unsigned char *>(
+	    MapViewOfFile(mapping, m_read_only ? FILE_MAP_READ : FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, si));
+	if (!m_data) {
+		auto err = GetLastError();
+		CloseHandle(mapping);
+		mapping = nullptr;
+		throw common::StreamError("Error mapping file view, GetLastError()=" + common::to_string(err));
+	}
+#else
+	void *result = mmap(nullptr, si, m_read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, m_file.fd, 0);
+	if (result == MAP_FAILED)
+		throw common::StreamError("Error mapping file, errno=" + common::to_string(errno));
+	m_data = reinterpret_cast<unsigned char *>(result);
+#endif
+}
+
+void MappedFile::unmap() {
+	if (!m_data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle(mapping);
+	mapping = nullptr;
+#else
+	munmap(m_data, common::integer_cast<size_t>(m_size));
+#endif
+	m_data = nullptr;
+}
+
+void MappedFile::flush_front(uint64_t size) {
+	if (!m_data)
+		return;
+#ifdef _WIN32
+	if (!FlushViewOfFile(m_data, common::integer_cast<size_t>(std::min(size, m_size))))
+		throw common::StreamError("Error flushing mapped file, GetLastError()=" + common::to_string(GetLastError()));
+#else
+	if (msync(m_data, common::integer_cast<size_t>(std::min(size, m_size)), MS_SYNC) == -1)
+		throw common::StreamError("Error flushing mapped file, errno=" + common::to_string(errno));
+#endif
+	m_file.fsync();
+}
@@ -39,10 +39,35 @@ private:
 	// We want those funs to use FileStream without exceptions (greatly hinders debugging)
 	friend bool load_file(const std::string &filepath, std::string &buf);
 	friend bool load_file(const std::string &filepath, common::BinaryArray &buf);
+	friend class MappedFile;
 #ifdef _WIN32
 	void *handle;  // HANDLE, cannot initialize hre because do not want to guess what is INVALID_HANDLE_VALUE
 #else
 	int fd = -1;
 #endif
 };
+
+// Whole file is mapped into memory, resize() remaps and invalidates data()
+class MappedFile : private common::Nocopy {
+public:
+	explicit MappedFile(const std::string &filename, OpenMode mode);
+	~MappedFile();
+	uint64_t size() const { return m_size; }
+	const unsigned char *data() const { return m_data; }
+	unsigned char *data() { return m_data; }
+	void resize(uint64_t size);
+	void flush() { flush_front(m_size); }  // writes modified pages to disk
+	void flush_front(uint64_t size);       // writes modified pages among first size bytes to disk
+
+private:
+	FileStream m_file;
+	bool m_read_only = false;
+	unsigned char *m_data = nullptr;
+	uint64_t m_size       = 0;
+#ifdef _WIN32
+	void *mapping = nullptr;
+#endif
+	void map();
+	void unmap();
+};
 }  // namespace platform
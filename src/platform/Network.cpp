@@ -152,6 +152,7 @@ void TCPSocket::close() {
 		impl.release();
 	}
 	ready = false;
+	outgoing_shared.clear();
 }
 
 bool TCPSocket::is_open() const { return impl && impl->state() != QAbstractSocket::UnconnectedState; }
@@ -174,6 +175,7 @@ bool TCPSocket::connect(const std::string &addr, uint16_t port) {
 		    });
 		QObject::connect(s.get(), &QSslSocket::encrypted, [this]() {
 			this->ready = true;
+			this->flush_shared();
 			this->rw_handler(true, true);
 		});
 		QObject::connect(
@@ -198,6 +200,7 @@ bool TCPSocket::connect(const std::string &addr, uint16_t port) {
 		    impl.get(), &QAbstractSocket::bytesWritten, [this](qint64 bytes) { this->rw_handler(true, true); });
 		QObject::connect(impl.get(), &QAbstractSocket::connected, [this]() {
 			this->ready = true;
+			this->flush_shared();
 			this->rw_handler(true, true);
 		});
 		QObject::connect(impl.get(), &QAbstractSocket::readyRead, [this]() { this->rw_handler(true, true); });
@@ -223,9 +226,30 @@ size_t TCPSocket::read_some(void *val, size_t count) {
 	return res;
 }
 
-size_t TCPSocket::write_some(const void *val, size_t count) {
+size_t TCPSocket::write_impl(const void *val, size_t count) {
 	qint64 res = (impl && ready) ? impl->write(reinterpret_cast<const char *>(val), count) : 0;
-	return res;
+	return res > 0 ? static_cast<size_t>(res) : 0;
+}
+
+size_t TCPSocket::write_some(const void *val, size_t count) {
+	flush_shared();
+	return outgoing_shared.empty() ? write_impl(val, count) : 0;
+}
+
+void TCPSocket::write_shared(const common::SharedBinaryArray &data) {
+	common::append(outgoing_shared, *data);
+	flush_shared();
+}
+
+void TCPSocket::flush_shared() {
+	size_t offset = 0;
+	while (offset != outgoing_shared.size()) {
+		const size_t wc = write_impl(outgoing_shared.data() + offset, outgoing_shared.size() - offset);
+		if (wc == 0)
+			break;
+		offset += wc;
+	}
+	outgoing_shared.erase(outgoing_shared.begin(), outgoing_shared.begin() + offset);
 }
 
 void TCPSocket::shutdown_both() {
@@ -273,6 +297,7 @@ void TCPSocket::close() {
 		CFRelease(write_stream);
 		write_stream = nullptr;
 	}
+	outgoing_shared.clear();
 }
 
 void TCPSocket::close_and_call() {
@@ -338,6 +363,27 @@ size_t TCPSocket::read_some(void *val, size_t count) {
 }
 
 size_t TCPSocket::write_some(const void *val, size_t count) {
+	flush_shared();
+	return outgoing_shared.empty() ? write_impl(val, count) : 0;
+}
+
+void TCPSocket::write_shared(const common::SharedBinaryArray &data) {
+	common::append(outgoing_shared, *data);
+	flush_shared();
+}
+
+void TCPSocket::flush_shared() {
+	size_t offset = 0;
+	while (offset != outgoing_shared.size()) {
+		const size_t wc = write_impl(outgoing_shared.data() + offset, outgoing_shared.size() - offset);
+		if (wc == 0)
+			break;
+		offset += wc;
+	}
+	outgoing_shared.erase(outgoing_shared.begin(), outgoing_shared.begin() + offset);
+}
+
+size_t TCPSocket::write_impl(const void *val, size_t count) {
 	if (!write_stream || !CFWriteStreamCanAcceptBytes(write_stream))
 		return 0;
 	CFIndex bytes_written = CFWriteStreamWrite(write_stream, reinterpret_cast<unsigned char *>(val), count);
@@ -383,6 +429,7 @@ void TCPSocket::write_callback(CFWriteStreamRef stream, CFStreamEventType event,
 	TCPSocket *s = reinterpret_cast<TCPSocket *>(my_ptr);
 	switch (event) {
 	case kCFStreamEventCanAcceptBytes:
+		s->flush_shared();
 		s->rw_handler(true, true);
 		break;
 	case kCFStreamEventErrorOccurred:
@@ -401,6 +448,7 @@ void TCPSocket::write_callback(CFWriteStreamRef stream, CFStreamEventType event,
 #include <algorithm>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <deque>
 #include <iostream>
 
 using namespace std::placeholders;  // We enjoy standard bindings
@@ -649,6 +697,9 @@ public:
 #endif
 	common::CircularBuffer incoming_buffer;
 	common::CircularBuffer outgoing_buffer;
+	std::deque<common::SharedBinaryArray> outgoing_shared;  // sent after outgoing_buffer
+	size_t outgoing_shared_offset = 0;                      // in outgoing_shared.front()
+	enum { MAX_WRITE_BUFFERS = 16 };                        // per scatter-gather write
 
 	void close(bool called_from_run_loop) {
 #if platform_USE_SSL
@@ -674,6 +725,8 @@ public:
 			pending_write   = false;
 			incoming_buffer.clear();
 			outgoing_buffer.clear();
+			outgoing_shared.clear();
+			outgoing_shared_offset = 0;
 #if platform_USE_SSL
 			ssl_socket.reset();
 			ssl_context.reset();
@@ -766,15 +819,21 @@ public:
 	void start_write() {
 		if (pending_write || !connected || !owner)
 			return;
-		if (outgoing_buffer.empty()) {
+		if (outgoing_buffer.empty() && outgoing_shared.empty()) {
 			if (asked_shutdown)
 				start_shutdown();
 			return;
 		}
 		pending_write = true;
-		boost::array<boost::asio::const_buffer, 2> bufs{
-		    {boost::asio::buffer(outgoing_buffer.read_ptr(), outgoing_buffer.read_count()),
-		        boost::asio::buffer(outgoing_buffer.read_ptr2(), outgoing_buffer.read_count2())}};
+		std::vector<boost::asio::const_buffer> bufs;
+		if (outgoing_buffer.read_count() != 0)
+			bufs.push_back(boost::asio::buffer(outgoing_buffer.read_ptr(), outgoing_buffer.read_count()));
+		if (outgoing_buffer.read_count2() != 0)
+			bufs.push_back(boost::asio::buffer(outgoing_buffer.read_ptr2(), outgoing_buffer.read_count2()));
+		size_t offset = outgoing_shared_offset;
+		for (auto sit = outgoing_shared.begin(); sit != outgoing_shared.end() && bufs.size() < MAX_WRITE_BUFFERS;
+		     ++sit, offset = 0)
+			bufs.push_back(boost::asio::buffer((*sit)->data() + offset, (*sit)->size() - offset));
 #if platform_USE_SSL
 		if (ssl_socket)
 			ssl_socket->async_write_some(bufs, std::bind(&Impl::handle_write, owner->impl, _1, _2));
@@ -786,7 +845,19 @@ public:
 	void handle_write(const boost::system::error_code &e, std::size_t bytes_transferred) {
 		pending_write = false;
 		if (!e) {
-			outgoing_buffer.did_read(bytes_transferred);
+			const size_t from_buffer = std::min(bytes_transferred, outgoing_buffer.size());
+			outgoing_buffer.did_read(from_buffer);
+			bytes_transferred -= from_buffer;
+			while (bytes_transferred != 0) {
+				const size_t left  = outgoing_shared.front()->size() - outgoing_shared_offset;
+				const size_t count = std::min(bytes_transferred, left);
+				outgoing_shared_offset += count;
+				bytes_transferred -= count;
+				if (outgoing_shared_offset == outgoing_shared.front()->size()) {
+					outgoing_shared.pop_front();
+					outgoing_shared_offset = 0;
+				}
+			}
 			start_write();
 			if (owner)
 				owner->rw_handler(true, true);
@@ -881,13 +952,22 @@ size_t TCPSocket::read_some(void *data, size_t size) {
 }
 
 size_t TCPSocket::write_some(const void *data, size_t size) {
-	if (impl->asked_shutdown)
+	if (impl->asked_shutdown || !impl->outgoing_shared.empty())
 		return 0;
 	size_t wc = impl->outgoing_buffer.write_some(data, size);
 	impl->start_write();
 	return wc;
 }
 
+void TCPSocket::write_shared(const common::SharedBinaryArray &data) {
+	if (impl->asked_shutdown || data->empty())
+		return;
+	impl->outgoing_shared.push_back(data);
+	impl->start_write();
+}
+
+size_t TCPSocket::get_shared_queue_size() const { return impl->outgoing_shared.size(); }
+
 void TCPSocket::shutdown_both() {
 	if (impl->asked_shutdown)
 		return;
@@ -6,6 +6,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include "common/BinaryArray.hpp"
 #include "common/Nocopy.hpp"
 #include "common/Streams.hpp"
 
@@ -112,11 +113,16 @@ public:
 	// reads 0..count-1, if returns 0 (incoming buffer empty) would fire rw_handler or d_handler in future
 	virtual size_t write_some(const void *val, size_t count) override;
 	// writes 0..count-1, if returns 0 (outgoing buffer full) will fire rw_handler or d_handler in future
+	void write_shared(const common::SharedBinaryArray &data);  // copied, sent before data of later write_some
+	size_t get_shared_queue_size() const { return 0; }
 	void shutdown_both();  // will fire d_handler only after all sent data is acknowledged or disconnect happens
 private:
 	friend class TCPAcceptor;
 	RW_handler rw_handler;
 	D_handler d_handler;
+	common::BinaryArray outgoing_shared;  // not yet accepted by impl
+	size_t write_impl(const void *val, size_t count);
+	void flush_shared();
 	std::unique_ptr<QAbstractSocket> impl;
 	bool ready = false;
 };
@@ -185,11 +191,16 @@ public:
 	// reads 0..count-1, if returns 0 (incoming buffer empty) would fire rw_handler or d_handler in future
 	virtual size_t write_some(const void *val, size_t count) override;
 	// writes 0..count-1, if returns 0 (outgoing buffer full) will fire rw_handler or d_handler in future
+	void write_shared(const common::SharedBinaryArray &data);  // copied, sent before data of later write_some
+	size_t get_shared_queue_size() const { return 0; }
 	void shutdown_both();  // will fire d_handler only after all sent data is acknowledged or disconnect happens
 private:
 	friend class TCPAcceptor;
 	RW_handler rw_handler;
 	D_handler d_handler;
+	common::BinaryArray outgoing_shared;  // not yet accepted by impl
+	size_t write_impl(const void *val, size_t count);
+	void flush_shared();
 	CFReadStreamRef read_stream   = nullptr;
 	CFWriteStreamRef write_stream = nullptr;
 	void close_and_call();
@@ -299,6 +310,10 @@ public:
 	// reads 0..count-1, if returns 0 (incoming buffer empty) would fire rw_handler or d_handler in future
 	virtual size_t write_some(const void *val, size_t count) override;
 	// writes 0..count-1, if returns 0 (outgoing buffer full) will fire rw_handler or d_handler in future
+	void write_shared(const common::SharedBinaryArray &data);
+	// data is queued without copying and written with scatter-gather I/O after previously written data.
+	// write_some returns 0 until shared queue is sent, so order is always kept
+	size_t get_shared_queue_size() const;  // number of shared buffers not completely sent yet
 	void shutdown_both();  // will fire d_handler only after all sent data is acknowledged or disconnect happens
 private:
 	class Impl;
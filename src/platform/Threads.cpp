@@ -0,0 +1,44 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#include "Threads.hpp"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include "platform/Windows.hpp"
+#elif defined(__linux__) && !defined(__ANDROID__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+size_t platform::get_worker_thread_count(size_t configured) {
+	if (configured != 0)
+		return configured;
+	// we use more energy but have the same speed when using hyperthreading
+	return std::max<size_t>(2, 3 * std::thread::hardware_concurrency() / 4);
+}
+
+#if defined(_WIN32)
+
+bool platform::set_thread_affinity(std::thread &th, size_t cpu) {
+	if (cpu >= sizeof(DWORD_PTR) * 8)
+		return false;
+	return SetThreadAffinityMask(th.native_handle(), DWORD_PTR(1) << cpu) != 0;
+}
+
+#elif defined(__linux__) && !defined(__ANDROID__)
+
+bool platform::set_thread_affinity(std::thread &th, size_t cpu) {
+	if (cpu >= CPU_SETSIZE)
+		return false;
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	return pthread_setaffinity_np(th.native_handle(), sizeof(cpu_set_t), &cpuset) == 0;
+}
+
+#else
+
+bool platform::set_thread_affinity(std::thread &, size_t) { return false; }  // Mac OS X has only affinity hints
+
+#endif
@@ -0,0 +1,13 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for details.
+
+#pragma once
+
+#include <cstddef>
+#include <thread>
+
+namespace platform {
+
+size_t get_worker_thread_count(size_t configured);  // 0 means 3/4 of hardware threads, but at least 2
+bool set_thread_affinity(std::thread &th, size_t cpu);  // false if not supported on this platform
+}  // namespace platform
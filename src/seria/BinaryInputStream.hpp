@@ -60,4 +60,9 @@ void from_binary(T &obj, const std::string &blob, Context... context) {
 	common::MemoryInputStream stream(blob.data(), blob.size());
 	from_binary(obj, stream, context...);
 }
+template<typename T, typename... Context>
+void from_binary(T &obj, common::StringView blob, Context... context) {  // For DB::Value, no copy
+	common::MemoryInputStream stream(blob.data(), blob.size());
+	from_binary(obj, stream, context...);
+}
 }  // namespace seria
@@ -0,0 +1,142 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "benchmark_outputs.hpp"
+#include "benchmark_timer.hpp"
+#include "test_miner.hpp"
+
+#include <chrono>
+#include <map>
+#include "Core/AmountOutputsIndex.hpp"
+#include "Core/Config.hpp"
+#include "logging/ConsoleLogger.hpp"
+
+using namespace cn;
+
+static const size_t MIXIN = 10;
+
+class OutputsChain {
+public:
+	logging::ConsoleLogger logger{logging::WARNING};
+	Config config;
+	std::unique_ptr<Currency> currency;
+	std::unique_ptr<BlockChainState> block_chain;
+	std::unique_ptr<TestMiner> test_miner;
+	std::map<Amount, size_t> counts;
+	Amount amount = 0;  // with most coinbase outputs
+
+	OutputsChain(common::CommandLine &cmd, size_t block_count) : config(cmd) {
+		config.data_folder = "../tests/scratchpad";
+		config.net         = "test";
+		BlockChain::DB::delete_db(config.data_folder + "/blockchain");
+		currency    = std::make_unique<Currency>(config);
+		block_chain = std::make_unique<BlockChainState>(logger, config, *currency, false);
+		test_miner  = std::make_unique<TestMiner>(*block_chain, *currency,
+		    "RRRbuwso2hAh8SMQrFd7CfV2TvjbE52ZffcKzTUki8YHViZ2x6zcQh5VUCTbWGPPZRTNaimFQsSLJfWhsMhZ1Gxz15W247JHh");
+		grow(block_count);
+		size_t best = 0;
+		for (const auto &c : counts)
+			if (c.second > best) {
+				best   = c.second;
+				amount = c.first;
+			}
+	}
+	void grow(size_t block_count) {
+		Hash bid = block_chain->get_tip_bid();
+		for (size_t i = 0; i != block_count; ++i) {
+			auto desc = test_miner->mine_block(bid);
+			test_miner->add_mined_block(desc, false);
+			for (const auto &output : desc.block_template.base_transaction.outputs)
+				counts[boost::get<OutputKey>(output).amount] += 1;
+			bid = desc.hash;
+		}
+	}
+	std::vector<api::Output> get_random_outputs(bool use_outputs_index, Height confirmed_height) {
+		config.use_outputs_index = use_outputs_index;
+		const auto tip           = block_chain->get_tip();
+		return block_chain->get_random_outputs(
+		    tip.major_version, amount, MIXIN, confirmed_height, tip.timestamp, tip.timestamp_median);
+	}
+};
+
+// Partially loaded amount must ignore changes above loaded prefix, they are read by next chunks
+static void test_partial_index() {
+	AmountOutputsIndex index;
+	AmountOutputsIndex::Items items(3);
+	for (size_t i = 0; i != items.size(); ++i)
+		items[i].global_index = i * 10;
+	index.load_chunk(1, items, false);
+	invariant(!index.find(1) && index.get_loaded_count(1) == 3, "");
+	index.set_spent(1, 10, 1);
+	index.set_spent(1, 40, 1);  // not loaded yet
+	AmountOutputsIndex::Item item;
+	item.global_index = 50;
+	index.push(1, item);
+	index.pop(1, 50);
+	invariant(index.get_loaded_count(1) == 3, "");
+	index.pop(1, 20);  // loaded prefix was whole amount
+	invariant(index.get_loaded_count(1) == 2, "");
+	index.load_chunk(1, AmountOutputsIndex::Items{}, true);
+	invariant(index.find(1) && index.find(1)->size() == 2 && index.find(1)->at(1).spent == 1, "");
+	index.push(1, item);
+	index.set_spent(1, 50, 1);
+	invariant(index.find(1)->size() == 3 && index.find(1)->back().spent == 1 && index.get_item_count() == 3, "");
+}
+
+// Same random sequence must give same outputs, both after index is loaded and after blocks are added to it
+void test_random_outputs(common::CommandLine &cmd, size_t block_count) {
+	test_partial_index();
+	OutputsChain chain(cmd, block_count);
+	invariant(chain.counts[chain.amount] > MIXIN, "Test chain too short");
+	auto check = [&](Height confirmed_height) {
+		crypto_initialize_random_for_tests();
+		const auto from_db = chain.get_random_outputs(false, confirmed_height);
+		crypto_initialize_random_for_tests();
+		const auto from_index = chain.get_random_outputs(true, confirmed_height);
+		invariant(from_db.size() == from_index.size(), "");
+		for (size_t i = 0; i != from_db.size(); ++i) {
+			invariant(from_db[i].stack_index == from_index[i].stack_index, "");
+			invariant(from_db[i].global_index == from_index[i].global_index, "");
+			invariant(from_db[i].public_key == from_index[i].public_key, "");
+			invariant(from_db[i].height == from_index[i].height, "");
+			invariant(from_db[i].unlock_block_or_timestamp == from_index[i].unlock_block_or_timestamp, "");
+		}
+		return from_db.size();
+	};
+	const Height tip_height = chain.block_chain->get_tip_height();
+	for (size_t r = 0; r != 20; ++r)
+		invariant(check(tip_height) == MIXIN, "");
+	check(tip_height / 2);
+	check(0);
+	chain.grow(block_count / 4);
+	for (size_t r = 0; r != 20; ++r)
+		invariant(check(chain.block_chain->get_tip_height()) == MIXIN, "");
+	std::cout << "amount=" << chain.amount
+	          << " outputs=" << chain.counts[chain.amount] << std::endl;
+}
+
+void benchmark_random_outputs(common::CommandLine &cmd, size_t block_count, size_t request_count, std::ostream &out) {
+	OutputsChain chain(cmd, block_count);
+	const Height tip_height = chain.block_chain->get_tip_height();
+	chain.get_random_outputs(true, tip_height);  // first requests load index
+	size_t found_db = 0, found_index = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r != request_count; ++r)
+		found_db += chain.get_random_outputs(false, tip_height).size();
+	const long db_time = microseconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r != request_count; ++r)
+		found_index += chain.get_random_outputs(true, tip_height).size();
+	const long index_time = microseconds_since(start);
+
+	out << "blocks=" << block_count << " amount=" << chain.amount
+	    << " outputs=" << chain.counts[chain.amount] << " requests=" << request_count
+	    << " mixin=" << MIXIN << std::endl;
+	out << "DB amount map: " << db_time << " us, " << double(db_time) / request_count << " us/request, found "
+	    << found_db << std::endl;
+	out << "memory index:  " << index_time << " us, " << double(index_time) / request_count
+	    << " us/request, found " << found_index << std::endl;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#pragma once
+
+#include <ostream>
+#include "common/CommandLine.hpp"
+
+// Both mine small test chain and call BlockChainState::get_random_outputs with Config::use_outputs_index off and on
+void test_random_outputs(common::CommandLine &cmd, size_t block_count);
+void benchmark_random_outputs(common::CommandLine &cmd, size_t block_count, size_t request_count, std::ostream &out);
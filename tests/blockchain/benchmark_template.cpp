@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "benchmark_template.hpp"
+#include "benchmark_timer.hpp"
+
+#include <chrono>
+#include <random>
+#include "Core/TransactionPool.hpp"
+#include "common/Varint.hpp"
+
+using namespace cn;
+
+static const size_t MAX_TXS_SIZE = 100000 - 600;  // Minimum size median minus miner tx reserve
+
+// Mostly small transactions, some large ones paying more per byte, like exchange and pool payouts
+static void fill_pool(TransactionPool &pool, size_t transaction_count, std::mt19937_64 &rng) {
+	std::uniform_int_distribution<size_t> small_size(300, 3000);
+	std::uniform_int_distribution<size_t> large_size(10000, 40000);
+	std::uniform_int_distribution<Amount> fee_per_byte(10, 1000);
+	for (size_t i = 0; i != transaction_count; ++i) {
+		const bool large   = rng() % 8 == 0;
+		const size_t size  = large ? large_size(rng) : small_size(rng);
+		const Amount fee   = (fee_per_byte(rng) + (large ? 500 : 0)) * size;
+		const uint64_t seq = rng();
+		InputKey input;
+		common::uint_le_to_bytes<uint64_t>(input.key_image.data, 8, seq);
+		Transaction tx;
+		tx.inputs.push_back(input);
+		Hash tid;
+		common::uint_le_to_bytes<uint64_t>(tid.data, 8, seq);
+		pool.insert(tid, tx, BinaryArray(size, 0), fee, 0, Hash{});
+	}
+}
+
+void benchmark_block_template(size_t pool_count, size_t transaction_count, std::ostream &out) {
+	std::mt19937_64 rng(12345);
+	Amount greedy_fee = 0, knapsack_fee = 0;
+	size_t greedy_size = 0, knapsack_size = 0, improved = 0;
+	long greedy_time = 0, knapsack_time = 0;
+	for (size_t p = 0; p != pool_count; ++p) {
+		TransactionPool pool(true);
+		fill_pool(pool, transaction_count, rng);
+
+		auto start                              = std::chrono::steady_clock::now();
+		const TransactionPool::Selection greedy = pool.select_greedy(MAX_TXS_SIZE);
+		greedy_time += microseconds_since(start);
+
+		start                                     = std::chrono::steady_clock::now();
+		const TransactionPool::Selection knapsack = pool.select_knapsack(MAX_TXS_SIZE);
+		knapsack_time += microseconds_since(start);
+
+		invariant(knapsack.size <= MAX_TXS_SIZE && knapsack.fee >= greedy.fee, "");
+		greedy_fee += greedy.fee;
+		greedy_size += greedy.size;
+		knapsack_fee += knapsack.fee;
+		knapsack_size += knapsack.size;
+		improved += knapsack.fee > greedy.fee ? 1 : 0;
+	}
+	out << "pools=" << pool_count << " transactions=" << transaction_count << " max_txs_size=" << MAX_TXS_SIZE
+	    << std::endl;
+	out << "greedy:   " << double(greedy_time) / pool_count << " us/template, fee " << greedy_fee << ", fill "
+	    << double(greedy_size) / pool_count / MAX_TXS_SIZE << std::endl;
+	out << "knapsack: " << double(knapsack_time) / pool_count << " us/template, fee " << knapsack_fee << ", fill "
+	    << double(knapsack_size) / pool_count / MAX_TXS_SIZE << ", better in " << improved << " pools" << std::endl;
+}
@@ -0,0 +1,10 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#pragma once
+
+#include <ostream>
+
+// Compares fee captured and build time of greedy and knapsack block template selection on synthetic pools
+void benchmark_block_template(size_t pool_count, size_t transaction_count, std::ostream &out);
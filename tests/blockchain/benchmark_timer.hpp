@@ -0,0 +1,16 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#pragma once
+
+#include <chrono>
+
+namespace cn {
+
+inline long microseconds_since(std::chrono::steady_clock::time_point start) {
+	return static_cast<long>(
+	    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+}  // namespace cn
@@ -3,6 +3,7 @@
 // details.
 
 #include "test_blockchain.hpp"
+#include "test_miner.hpp"
 
 #include <fstream>
 #include <vector>
@@ -23,101 +24,6 @@
 
 using namespace cn;
 
-struct MinedBlockDesc {
-	BlockTemplate block_template;
-	BinaryArray binary_block_template;
-	Hash hash;
-	Height height = 0;
-};
-
-class TestMiner {
-public:
-	BlockChainState &block_chain;
-	const Currency &currency;
-	AccountAddress address;
-	crypto::CryptoNightContext cryptoContext;
-	std::vector<KeyPair> checkpoint_keypairs;
-
-	TestMiner(BlockChainState &block_chain, const Currency &currency) : block_chain(block_chain), currency(currency) {
-		invariant(currency.parse_account_address_string("21mQ7KPdmLbjfpg3Coayi4hZzAEgjeL87QXGeDTHahKeJsvKHc6DoprAJmqU"
-		                                                "cLhWTUXtxCL6rQFSwEUe6NZdEoqZNpSq1iC",
-		              &address),
-		    "");
-		std::vector<std::string> skeys{"dacb828348483011f63ebb538401b3f3d52e8ce1916278f9b189f820d1ec730e",
-		    "3ab19160e48f77b41a9b7f87322542b1e977577f30886db3dce3076806709d0d",
-		    "16d4d146d8ba2bbff13a4bb174b4c5d73d3ca22817a6585956a697337be26a09"};
-		for (auto &&sk : skeys) {
-			checkpoint_keypairs.push_back(KeyPair{});
-			invariant(common::pod_from_hex(sk, &checkpoint_keypairs.back().secret_key), "");
-			invariant(crypto::secret_key_to_public_key(
-			              checkpoint_keypairs.back().secret_key, &checkpoint_keypairs.back().public_key),
-			    "");
-		}
-	}
-	MinedBlockDesc mine_block(Hash bid) {
-		api::BlockHeader parent;
-		invariant(block_chain.get_header(bid, &parent), "");
-
-		BlockTemplate block;
-		Difficulty difficulty      = 0;
-		Height height              = 0;
-		size_t reserve_back_offset = 0;
-		block_chain.create_mining_block_template(
-		    bid, address, BinaryArray{}, Hash{}, &block, &difficulty, &height, &reserve_back_offset);
-		set_root_extra_to_solo_mining_tag(block);
-		block.root_block.timestamp = parent.timestamp + currency.difficulty_target;
-		block.timestamp            = block.root_block.timestamp;
-		//		block.root_block.nonce.resize(4);
-		uint32_t nonce = crypto::rand<uint32_t>();
-		//		block.nonce.resize(4);
-		auto body_proxy = get_body_proxy_from_template(block);
-		while (true) {
-			common::uint_le_to_bytes(block.root_block.nonce, 4, nonce);
-			//			block.nonce    = block.root_block.nonce;
-			BinaryArray ba = currency.get_block_pow_hashing_data(block, body_proxy);
-			Hash hash      = cryptoContext.cn_slow_hash(ba.data(), ba.size());
-			if (check_hash(hash, difficulty))
-				break;
-			nonce += 1;
-		}
-		RawBlock rb;
-		MinedBlockDesc desc{block, seria::to_binary(block), get_block_hash(block, body_proxy), parent.height + 1};
-		return desc;
-	}
-	void add_mined_block(const MinedBlockDesc &desc, bool log = true) {
-		RawBlock rb;
-		api::BlockHeader info;
-		block_chain.add_mined_block(desc.binary_block_template, &rb, &info);
-		if (log)
-			std::cout << "---- After add_mined_block tip=" << block_chain.get_tip_height() << " : "
-			          << block_chain.get_tip_bid() << std::endl;
-	}
-	MinedBlockDesc test_grow_chain(Hash bid, Height length) {
-		MinedBlockDesc desc;
-		for (Height i = 0; i != length; ++i) {
-			desc = mine_block(bid);
-			add_mined_block(desc, false);
-			bid = desc.hash;
-		}
-		std::cout << "---- After test_grow_chain tip=" << block_chain.get_tip_height() << " : "
-		          << block_chain.get_tip_bid() << std::endl;
-		return desc;
-	}
-	void add_checkpoint(size_t key_id, uint64_t counter, Hash hash, Height height) {
-		SignedCheckpoint small_checkpoint;
-		small_checkpoint.height    = height;
-		small_checkpoint.hash      = hash;
-		small_checkpoint.key_id    = key_id;
-		small_checkpoint.counter   = counter;
-		small_checkpoint.signature = crypto::generate_signature(small_checkpoint.get_message_hash(),
-		    checkpoint_keypairs.at(key_id).public_key,
-		    checkpoint_keypairs.at(key_id).secret_key);
-		invariant(block_chain.add_checkpoint(small_checkpoint, ""), "");
-		std::cout << "---- After add_checkpoint tip=" << block_chain.get_tip_height() << " : "
-		          << block_chain.get_tip_bid() << std::endl;
-	}
-};
-
 void test_blockchain(common::CommandLine &cmd) {
 	logging::ConsoleLogger logger;
 	Config config(cmd);
@@ -132,7 +38,8 @@ void test_blockchain(common::CommandLine &cmd) {
 	BlockChainState block_chain(logger, config, currency, false);
 
 	std::cout << "Point 3" << std::endl;
-	TestMiner test_miner(block_chain, currency);
+	TestMiner test_miner(block_chain, currency,
+	    "21mQ7KPdmLbjfpg3Coayi4hZzAEgjeL87QXGeDTHahKeJsvKHc6DoprAJmqUcLhWTUXtxCL6rQFSwEUe6NZdEoqZNpSq1iC");
 
 	std::cout << "Point 4" << std::endl;
 	auto middle_desc = test_miner.test_grow_chain(block_chain.get_tip().hash, 25);
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "test_deferred_signatures.hpp"
+#include "test_miner.hpp"
+
+#include "Core/Config.hpp"
+#include "logging/ConsoleLogger.hpp"
+
+using namespace cn;
+
+// Spends first output of amount, with ring signature which does not check
+static Transaction make_bad_signature_transaction(Amount amount) {
+	const KeyPair spend = crypto::random_keypair();
+	InputKey input;
+	input.amount         = amount;
+	input.output_indexes = {0};
+	input.key_image      = crypto::generate_key_image(spend.public_key, spend.secret_key);
+	OutputKey output;
+	output.amount     = amount;
+	output.public_key = crypto::random_keypair().public_key;
+	Transaction tx;
+	tx.version = 1;
+	tx.inputs.push_back(input);
+	tx.outputs.push_back(output);
+	tx.signatures = RingSignatures{{RingSignature{crypto::Signature{}}}};
+	return tx;
+}
+
+static bool add_deferred(
+    BlockChainState &block_chain, const Currency &currency, TestMiner &miner, const Transaction &tx) {
+	const BinaryArray binary_tx = seria::to_binary(tx);
+	const auto desc             = miner.mine_block(block_chain.get_tip_bid(), {get_transaction_hash(tx)});
+	RawBlock raw_block;
+	raw_block.block        = desc.binary_block_template;
+	raw_block.transactions = {binary_tx};
+	PreparedBlock pb(std::move(raw_block), currency, nullptr);
+	api::BlockHeader info;
+	return block_chain.add_block(pb, &info, false, "test", true);
+}
+
+void test_deferred_signatures(common::CommandLine &cmd) {
+	logging::ConsoleLogger logger{logging::WARNING};
+	Config config(cmd);
+	config.data_folder              = "../tests/scratchpad";
+	config.net                      = "test";
+	config.signature_check_window   = 100;  // so that bad block is still pending after add_block
+	config.db_commit_every_n_blocks = 1000;
+	BlockChain::DB::delete_db(config.data_folder + "/blockchain");
+	Currency currency(config);
+	BlockChainState block_chain(logger, config, currency, false);
+	TestMiner miner(block_chain, currency,
+	    "RRRbuwso2hAh8SMQrFd7CfV2TvjbE52ZffcKzTUki8YHViZ2x6zcQh5VUCTbWGPPZRTNaimFQsSLJfWhsMhZ1Gxz15W247JHh");
+	const auto tip       = miner.test_grow_chain(block_chain.get_tip_bid(), 30);  // unlock mined outputs
+	const Amount amount  = boost::get<OutputKey>(tip.block_template.base_transaction.outputs.at(0)).amount;
+	const Transaction tx = make_bad_signature_transaction(amount);
+	const Height height  = block_chain.get_tip_height() + 1;
+
+	// Without commit, bad block is added and rolled back when pending checks are drained
+	invariant(add_deferred(block_chain, currency, miner, tx), "Block must pass all checks except signature");
+	invariant(block_chain.get_tip_height() == height, "");
+	invariant(!block_chain.check_pending_signatures(), "Bad signature not found");
+	invariant(block_chain.get_tip_height() == height - 1, "");
+
+	// Commit is due right after bad block, add_block must throw instead of rolling back silently
+	config.db_commit_every_n_blocks = height + 1;
+	bool thrown                     = false;
+	try {
+		add_deferred(block_chain, currency, miner, tx);
+	} catch (const ConsensusError &) {
+		thrown = true;
+	}
+	invariant(thrown, "Bad signature drained by DB commit was not reported");
+	invariant(block_chain.get_tip_height() == height - 1, "");
+	invariant(block_chain.check_pending_signatures(), "");
+
+	// Good blocks are committed as usual
+	invariant(miner.test_grow_chain(block_chain.get_tip_bid(), 2).height == height + 1, "");
+	std::cout << "bad block height=" << height << " rolled back and reported" << std::endl;
+}
@@ -0,0 +1,10 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#pragma once
+
+#include "common/CommandLine.hpp"
+
+// Adds blocks with deferred signature checks, bad signature must be reported by add_block when DB is committed
+void test_deferred_signatures(common::CommandLine &cmd);
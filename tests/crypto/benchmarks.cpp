@@ -347,3 +347,80 @@ void benchmark_crypto_ops(size_t count, std::ostream &out) {
 
 	pprint_benchmarks(out, benchmark_results);
 }
+
+// check_ring_signature as it was before points of ring were encoded together, for comparison
+static bool check_ring_signature_per_member(
+    const Hash &prefix_hash, const KeyImage &image, const std::vector<PublicKey> &pubs, const RingSignature &sig) {
+	if (sig.size() != pubs.size())
+		return false;
+	P3 image_p3;
+	if (!image_p3.frombytes_vartime(image))
+		return false;
+	KeccakStream buf;
+	EllipticCurveScalar sum;
+	sc_0(&sum);
+	buf << prefix_hash;
+	for (size_t i = 0; i < pubs.size(); i++) {
+		if (!sc_isvalid_vartime(&sig[i].c) || !sc_isvalid_vartime(&sig[i].r))
+			return false;
+		const P3 pubs_i_p3(pubs[i]);
+		const P3 hash_pubs_i_p3 = hash_to_good_point_p3(pubs[i]);
+
+		buf << to_bytes(vartime_add(sig[i].c * pubs_i_p3, sig[i].r * G));
+		buf << to_bytes(vartime_add(sig[i].r * hash_pubs_i_p3, sig[i].c * image_p3));
+		sum += sig[i].c;
+	}
+	EllipticCurveScalar h = buf.hash_to_scalar() - sum;
+	return sc_iszero(&h) != 0;
+}
+
+void benchmark_ring_signatures(size_t inputs, size_t count, std::ostream &out) {
+	const Hash prefix_hash = cn_fast_hash("benchmark_ring_signatures", 25);
+	for (size_t ring_size : {1, 2, 4, 8, 16, 32, 64}) {
+		std::vector<KeyImage> images(inputs);
+		std::vector<std::vector<PublicKey>> pubs(inputs);
+		std::vector<RingSignature> sigs(inputs);
+		for (size_t i = 0; i != inputs; ++i) {
+			KeyPair real = random_keypair();
+			pubs[i].push_back(real.public_key);
+			for (size_t j = 1; j != ring_size; ++j)
+				pubs[i].push_back(random_keypair().public_key);
+			images[i] = generate_key_image(real.public_key, real.secret_key);
+			sigs[i]   = generate_ring_signature(prefix_hash, images[i], pubs[i].data(), ring_size, real.secret_key, 0);
+		}
+		size_t good_per_member = 0, good_batch = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t c = 0; c != count; ++c)
+			for (size_t i = 0; i != inputs; ++i)
+				good_per_member += check_ring_signature_per_member(prefix_hash, images[i], pubs[i], sigs[i]);
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (size_t c = 0; c != count; ++c)
+			good_batch += inputs * check_ring_signatures(prefix_hash, images, pubs, sigs);
+		auto finish = std::chrono::high_resolution_clock::now();
+		// All ring members found in output key cache, as with popular decoys
+		std::vector<std::unique_ptr<PreparedOutputKey>> prepared_keys;
+		PreparedRings prepared_rings(inputs);
+		for (size_t i = 0; i != inputs; ++i)
+			for (const auto &pub : pubs[i]) {
+				prepared_keys.push_back(std::make_unique<PreparedOutputKey>(pub));
+				prepared_rings[i].push_back(prepared_keys.back().get());
+			}
+		size_t good_cached = 0;
+		auto cached_start  = std::chrono::high_resolution_clock::now();
+		for (size_t c = 0; c != count; ++c)
+			good_cached += inputs * check_ring_signatures(prefix_hash, images, prepared_rings, sigs);
+		auto cached_finish = std::chrono::high_resolution_clock::now();
+		if (good_per_member != count * inputs || good_batch != count * inputs || good_cached != count * inputs)
+			throw std::runtime_error("benchmark_ring_signatures signatures do not check");
+		const auto per_member_us = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count();
+		const auto batch_us      = std::chrono::duration_cast<std::chrono::microseconds>(finish - middle).count();
+		const auto cached_us =
+		    std::chrono::duration_cast<std::chrono::microseconds>(cached_finish - cached_start).count();
+		out << "ring size " << setw(2) << ring_size << "  per member " << setw(8) << std::fixed << setprecision(1)
+		    << double(per_member_us) / (count * inputs) << " us/ring  batch " << setw(8)
+		    << double(batch_us) / (count * inputs) << " us/ring  speedup " << setprecision(3)
+		    << double(per_member_us) / std::max(1.0, double(batch_us)) << "  cached keys " << setw(8)
+		    << setprecision(1) << double(cached_us) / (count * inputs) << " us/ring  speedup " << setprecision(3)
+		    << double(per_member_us) / std::max(1.0, double(cached_us)) << endl;
+	}
+}
@@ -10,5 +10,8 @@
 #include <ostream>
 
 void benchmark_crypto_ops(size_t count, std::ostream &out);
+// Transactions with that many inputs, compares check_ring_signatures with checking ring members one by one,
+// and with all ring members already prepared (found in output key cache)
+void benchmark_ring_signatures(size_t inputs, size_t count, std::ostream &out);
 
 #endif  // BYTECOIN_BENCHMARKS_HPP
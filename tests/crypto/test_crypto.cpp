@@ -625,7 +625,10 @@ bool test_check_ring_signature(std::istream &input) {
 	input >> mixins >> image >> signature;
 	getvalue(input, expected);
 	const bool actual = check_ring_signature(prefix_hash, image, mixins, signature);
-	return expected == actual;
+	const bool actual_batch =
+	    check_ring_signatures(prefix_hash, std::vector<KeyImage>(2, image),
+	        std::vector<std::vector<PublicKey>>(2, mixins), std::vector<RingSignature>(2, signature));
+	return expected == actual && expected == actual_batch;
 }
 
 size_t max_length(const std::vector<std::string> &strings) {
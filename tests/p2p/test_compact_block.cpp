@@ -0,0 +1,111 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "test_compact_block.hpp"
+
+#include "Core/CompactBlock.hpp"
+#include "Core/CryptoNoteTools.hpp"
+#include "common/Invariant.hpp"
+#include "common/Varint.hpp"
+#include "seria/BinaryInputStream.hpp"
+#include "seria/BinaryOutputStream.hpp"
+
+using namespace cn;
+
+static BinaryArray make_transaction(uint64_t seq, Hash *tid) {
+	InputKey input;
+	input.amount = 1000 + seq;
+	common::uint_le_to_bytes<uint64_t>(input.key_image.data, 8, seq);
+	Transaction tx;
+	tx.version = 1;
+	tx.inputs.push_back(input);
+	tx.signatures = RingSignatures{{std::vector<crypto::Signature>{}}};  // no output indexes, so no signatures
+	*tid = get_transaction_hash(tx);
+	return seria::to_binary(tx);
+}
+
+// Sender side and receiver side of compact block relay, receiver has block transactions in pool except missing
+static CompactBlockReconstruction receive(const BlockTemplate &block, const TransactionPool &pool) {
+	const BinaryArray binary_block = seria::to_binary(block);
+	CompactBlockReconstruction cb;
+	cb.msg = make_compact_block(binary_block, Hash{}, 1);
+	seria::from_binary(cb.header, cb.msg.header);
+	invariant(cb.header.transaction_hashes.empty() && cb.msg.short_ids.size() == block.transaction_hashes.size(), "");
+	cb.fill(ShortIdMap(pool, cb.msg.get_short_id_key()));
+	return cb;
+}
+
+static void check_block(CompactBlockReconstruction &cb, const BlockTemplate &block,
+    const std::vector<BinaryArray> &binary_transactions) {
+	invariant(cb.missing.empty(), "");
+	const RawBlock rb = cb.move_raw_block();
+	invariant(rb.block == seria::to_binary(block), "Reconstructed header differs");
+	invariant(rb.transactions == binary_transactions, "Reconstructed transactions differ");
+}
+
+void test_compact_block() {
+	TransactionPool pool(false);
+	BlockTemplate block;
+	block.major_version            = 1;
+	block.base_transaction.version = 1;
+	block.base_transaction.inputs  = {InputCoinbase{1}};
+	std::vector<BinaryArray> binary_transactions;
+	for (uint64_t seq = 0; seq != 20; ++seq) {
+		Hash tid;
+		BinaryArray binary_tx = make_transaction(seq, &tid);
+		Transaction tx;
+		seria::from_binary(tx, binary_tx);
+		pool.insert(tid, tx, binary_tx, 1000, 0, Hash{});
+		if (seq % 2 == 0) {  // Other pool transactions are not in block
+			block.transaction_hashes.push_back(tid);
+			binary_transactions.push_back(binary_tx);
+		}
+	}
+	// Full match
+	auto cb = receive(block, pool);
+	check_block(cb, block, binary_transactions);
+
+	// Missing transactions are requested by index and checked against short ids
+	TransactionPool partial_pool(false);
+	for (size_t i = 0; i != block.transaction_hashes.size(); ++i)
+		if (i % 3 != 0) {
+			const auto &record = pool.at(block.transaction_hashes[i]);
+			partial_pool.insert(record.tid, record.get_tx(), record.binary_tx, 1000, 0, Hash{});
+		}
+	cb = receive(block, partial_pool);
+	invariant((cb.missing == std::vector<uint32_t>{0, 3, 6, 9}), "");
+	for (auto index : cb.missing)
+		invariant(cb.header.transaction_hashes.at(index) == Hash{} && cb.transactions.at(index).empty(), "");
+	auto wrong = cb;
+	std::vector<BinaryArray> response;
+	for (auto index : cb.missing)
+		response.push_back(binary_transactions.at(index));
+	std::vector<BinaryArray> wrong_response = response;
+	std::swap(wrong_response.at(1), wrong_response.at(2));
+	invariant(!wrong.add_missing(std::move(wrong_response)), "Wrong transaction must not match short id");
+	invariant(cb.add_missing(std::move(response)), "");
+	check_block(cb, block, binary_transactions);
+
+	// Two pool transactions with the same short id are ambiguous, so transaction is requested like missing
+	cb     = CompactBlockReconstruction{};
+	cb.msg = make_compact_block(seria::to_binary(block), Hash{}, 1);
+	seria::from_binary(cb.header, cb.msg.header);
+	ShortIdMap pool_by_short_id(pool, cb.msg.get_short_id_key());
+	pool_by_short_id.insert(cb.msg.short_ids.at(4), &pool.at(block.transaction_hashes.at(5)));
+	invariant(!pool_by_short_id.find(cb.msg.short_ids.at(4)), "");
+	cb.fill(pool_by_short_id);
+	invariant((cb.missing == std::vector<uint32_t>{4}), "");
+	invariant(cb.add_missing(std::vector<BinaryArray>{binary_transactions.at(4)}), "");
+	check_block(cb, block, binary_transactions);
+
+	// Indexes of GetBlockTransactions must be ascending and inside block
+	p2p::GetBlockTransactions::Request req;
+	invariant(req.indexes_valid(0), "");
+	req.indexes = {0, 3, 6, 9};
+	invariant(req.indexes_valid(10) && !req.indexes_valid(9), "");
+	req.indexes = {0, 3, 3};
+	invariant(!req.indexes_valid(10), "Duplicate index");
+	req.indexes = {3, 0};
+	invariant(!req.indexes_valid(10), "Descending indexes");
+}
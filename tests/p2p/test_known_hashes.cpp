@@ -0,0 +1,53 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "test_known_hashes.hpp"
+
+#include <iostream>
+#include "Core/KnownHashes.hpp"
+#include "common/Invariant.hpp"
+#include "crypto/crypto.hpp"
+#include "crypto/random.h"
+
+using namespace cn;
+
+static const size_t MAX_COUNT = 1000;
+
+void test_known_hashes() {
+	crypto_initialize_random_for_tests();
+	KnownHashes known(MAX_COUNT);
+	std::vector<Hash> inserted;
+	for (size_t i = 0; i != 10 * MAX_COUNT; ++i) {
+		inserted.push_back(crypto::rand<Hash>());
+		known.insert(inserted.back());  // false positive is not counted, but is still contained
+		if (i % 97 != 0)
+			continue;
+		const size_t latest = std::min(inserted.size(), MAX_COUNT / 2);
+		for (size_t j = inserted.size() - latest; j != inserted.size(); ++j)
+			invariant(known.contains(inserted[j]), "Rotation forgot one of max_count / 2 latest hashes");
+	}
+	invariant(!known.insert(inserted.back()), "");
+
+	// Filters of different peers must select different bits, so that false positives cannot be ground for all
+	KnownHashes other(MAX_COUNT);
+	for (size_t j = inserted.size() - MAX_COUNT / 2; j != inserted.size(); ++j)
+		other.insert(inserted[j]);
+	size_t false_positives = 0, false_positives_in_both = 0;
+	for (size_t i = 0; i != 100 * MAX_COUNT; ++i) {
+		const Hash hash = crypto::rand<Hash>();
+		if (!known.contains(hash))
+			continue;
+		false_positives += 1;
+		false_positives_in_both += other.contains(hash) ? 1 : 0;
+	}
+	invariant(false_positives < MAX_COUNT, "False positive rate must be below 1%");
+	invariant(false_positives_in_both * 4 <= false_positives, "Bits must depend on per-filter salt");
+
+	known.clear();
+	for (const auto &hash : inserted)
+		invariant(!known.contains(hash), "clear must forget everything");
+	invariant(known.insert(inserted.back()) && known.contains(inserted.back()), "");
+	std::cout << "false positives " << false_positives << " of " << 100 * MAX_COUNT << ", in both filters "
+	          << false_positives_in_both << std::endl;
+}
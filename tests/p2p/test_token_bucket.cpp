@@ -0,0 +1,46 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "test_token_bucket.hpp"
+
+#include <cmath>
+#include "common/Invariant.hpp"
+#include "p2p/P2P.hpp"
+
+using namespace cn;
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+static bool about(float a, float b) { return std::fabs(a - b) < 0.01f; }
+
+static TimePoint after(TimePoint start, double seconds) {
+	return start +
+	       std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+void test_token_bucket() {
+	const TimePoint start = std::chrono::steady_clock::now();
+	TokenBucket unlimited;
+	unlimited.consume(0, 1000000);
+	invariant(unlimited.allows(0) && unlimited.seconds_until_allowed(0) == 0, "Rate 0 must mean no limit");
+
+	const size_t rate = 1000;
+	TokenBucket bucket;
+	bucket.refill(after(start, 0), rate);  // first refill fills bucket, but only to one second worth
+	invariant(bucket.allows(rate) && bucket.seconds_until_allowed(rate) == 0, "");
+	bucket.consume(rate, 3000);  // whole message goes, bucket is in debt
+	invariant(!bucket.allows(rate) && about(bucket.seconds_until_allowed(rate), 2), "");
+	bucket.refill(after(start, 1), rate);
+	invariant(!bucket.allows(rate) && about(bucket.seconds_until_allowed(rate), 1), "Debt must be repaid");
+	bucket.refill(after(start, 2.5), rate);
+	invariant(bucket.allows(rate), "");
+	bucket.consume(rate, 500);  // exactly 0 tokens does not allow
+	invariant(!bucket.allows(rate) && bucket.seconds_until_allowed(rate) > 0, "");
+	bucket.refill(after(start, 100), rate);
+	bucket.consume(rate, 1000);  // refill is capped at rate
+	invariant(!bucket.allows(rate) && about(bucket.seconds_until_allowed(rate), 0), "Refill must be capped");
+	bucket.refill(after(start, 100.5), rate);
+	bucket.consume(rate, 499);
+	invariant(bucket.allows(rate), "");
+}
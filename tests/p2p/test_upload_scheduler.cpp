@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2018, The CryptoNote developers, The Bytecoin developers.
+// Licensed under the GNU Lesser General Public License. See LICENSE for
+// details.
+
+#include "test_upload_scheduler.hpp"
+
+#include "common/Invariant.hpp"
+#include "p2p/P2P.hpp"
+
+using namespace cn;
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+static common::SharedBinaryArray message(size_t size) { return std::make_shared<const BinaryArray>(size); }
+
+static TimePoint after(TimePoint start, double seconds) {
+	return start +
+	       std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+// Large message of another client puts shared bucket into debt
+static void exhaust_shared(UploadScheduler *scheduler, TimePoint now) {
+	UploadScheduler::Queues c;
+	c.push(message(3000), UploadScheduler::PRIORITY_HIGH);
+	invariant(scheduler->pop(&c, UploadScheduler::PRIORITY_HIGH, true, now), "");
+}
+
+// Client b has PRIORITY_HIGH message, client a has bulk, shared and per-client buckets block b in turn
+void test_upload_scheduler() {
+	const TimePoint start = std::chrono::steady_clock::now();
+	const size_t rate     = 1000;
+	UploadScheduler scheduler(rate, rate);
+	scheduler.refill(start);
+	UploadScheduler::Queues a, b;
+	a.push(message(100), UploadScheduler::PRIORITY_BULK);
+	a.push(message(100), UploadScheduler::PRIORITY_BULK);
+	a.push(message(100), UploadScheduler::PRIORITY_BULK);
+	invariant(a.size == 300, "");
+
+	// b is held by its own bucket, shared tokens are free, so a's bulk must not wait for b
+	b.bucket.refill(start, rate);
+	b.bucket.consume(rate, 5000);
+	b.push(message(100), UploadScheduler::PRIORITY_HIGH);
+	invariant(!scheduler.pop(&b, UploadScheduler::PRIORITY_HIGH, true, start), "Own bucket must hold b");
+	invariant(scheduler.get_tokens_waiting() == 0 && !b.waiting_tokens, "Own bucket is not waiting for shared tokens");
+	invariant(scheduler.pop(&a, UploadScheduler::PRIORITY_BULK, true, start), "Bulk must go while shared tokens free");
+
+	// b's socket is full, likewise must not block bulk of others
+	invariant(!scheduler.pop(&b, UploadScheduler::PRIORITY_HIGH, false, start), "Full socket must hold b");
+	invariant(scheduler.get_tokens_waiting() == 0 && scheduler.bulk_allowed(a), "Full socket is not waiting");
+
+	// shared bucket goes into debt, now b waits for shared tokens and a's bulk must yield to it
+	exhaust_shared(&scheduler, start);
+	invariant(!scheduler.pop(&b, UploadScheduler::PRIORITY_HIGH, true, start), "");
+	invariant(scheduler.get_tokens_waiting() == 1 && b.waiting_tokens, "Shared bucket must count b as waiting");
+	invariant(!scheduler.bulk_allowed(a), "Bulk must wait for high priority messages waiting for shared tokens");
+	scheduler.refill(after(start, 10));
+	invariant(!scheduler.pop(&a, UploadScheduler::PRIORITY_BULK, true, after(start, 10)), "Bulk must not go before b");
+
+	// after refill b goes first, then a's bulk follows
+	invariant(scheduler.pop(&b, UploadScheduler::PRIORITY_HIGH, true, after(start, 10)), "");
+	invariant(scheduler.get_tokens_waiting() == 0 && !b.waiting_tokens && b.size == 0, "");
+	invariant(scheduler.pop(&a, UploadScheduler::PRIORITY_BULK, true, after(start, 10)), "");
+	invariant(a.size == 100, "");
+
+	// client disconnecting while waiting must not block bulk forever
+	exhaust_shared(&scheduler, after(start, 10));
+	b.push(message(100), UploadScheduler::PRIORITY_HIGH);
+	invariant(!scheduler.pop(&b, UploadScheduler::PRIORITY_HIGH, true, after(start, 10)), "");
+	invariant(scheduler.get_tokens_waiting() == 1, "");
+	scheduler.clear(&b);
+	invariant(scheduler.get_tokens_waiting() == 0 && b.size == 0 && scheduler.bulk_allowed(a), "");
+}